@@ -0,0 +1,65 @@
+/*
+  Calls a short handler many times, whose temporaries all die when it
+  returns, with the objects of every call allocated on the heap and then in
+  the context's arena. This file is built once per primitive layout, see
+  bench/CMakeLists.txt.
+*/
+#include <compiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vm/chapman.h>
+
+#define CALLS 20000
+
+static const char *SOURCE =
+    "val handled = 0;"
+    "#wrap(value) { #get() { return value; } return get; }"
+    "#handle() {"
+    "  val i = 50;"
+    "  while (i) { val f = wrap(i); val s = \"re\" + \"quest\"; i--; }"
+    "  handled = handled + 1;"
+    "  return handled;"
+    "}";
+
+static double now_ms(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+static void run_mode(const char *name, bool use_arena) {
+  ch_program program;
+  if (!ch_compile((const uint8_t *)SOURCE, strlen(SOURCE), &program)) {
+    fprintf(stderr, "Failed to compile benchmark\n");
+    exit(1);
+  }
+
+  ch_context context = ch_newvm(program);
+  ch_gc_setarena(&context, use_arena);
+
+  double start = now_ms();
+  for (int i = 0; i < CALLS; i++) {
+    ch_runfunction(&context, "handle");
+  }
+  double elapsed = now_ms() - start;
+
+  // The interpreter reports every halt on stdout
+  ch_gc_stats stats = ch_gc_getstats(&context);
+  fprintf(stderr,
+          "%-6s total %8.2f ms, %8.2f us/call, %4llu cycles, p99 pause %8.1f "
+          "us\n",
+          name, elapsed, elapsed * 1000.0 / CALLS,
+          (unsigned long long)stats.cycles, stats.p99_pause / 1000.0);
+
+  ch_freevm(&context);
+  free(program.start);
+}
+
+int main(void) {
+  run_mode("heap", false);
+  run_mode("arena", true);
+
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+  Inserts keys into a table and reports the time per insertion when their
+  hashes are random, when they only differ in the bits that do not pick a slot
+  or a control byte, and when they are all equal. The last two are what keys
+  crafted against a leaked seed would hash to, they are forged here instead.
+  This file is built once per primitive layout, see bench/CMakeLists.txt.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vm/object.h>
+#include <vm/table.h>
+
+static double now_ms(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+static uint32_t random_hash(uint32_t i) { return (uint32_t)rand() ^ (i << 16); }
+
+// Starts every key at the same group of tables of up to 2^21 slots, the
+// control bits and the bits above the group differ. Distinct below 2^18 keys.
+static uint32_t same_slot_hash(uint32_t i) {
+  return ((i >> 7) << 21) | (i & 0x7F);
+}
+
+static uint32_t equal_hash(uint32_t i) { return 42; }
+
+static double measure(uint32_t (*hash)(uint32_t), ch_string *keys,
+                      uint32_t count, bool *salted) {
+  for (uint32_t i = 0; i < count; i++) {
+    keys[i].hash = hash(i);
+  }
+
+  ch_table table;
+  ch_table_create(&table, NULL);
+  double start = now_ms();
+  for (uint32_t i = 0; i < count; i++) {
+    ch_table_set(&table, &keys[i], MAKE_NUMBER(i));
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    ch_table_get(&table, &keys[i]);
+  }
+
+  double elapsed = now_ms() - start;
+  *salted = table.salt != 0;
+  ch_table_free(&table);
+  return elapsed * 1000000.0 / count;
+}
+
+int main(void) {
+  static const uint32_t counts[] = {1000, 10000, 100000, 200000};
+  // Equal hashes stay quadratic, larger counts would take minutes
+  static const uint32_t max_equal = 20000;
+  uint32_t max_count = counts[sizeof(counts) / sizeof(counts[0]) - 1];
+
+  // Keys are compared by address, their contents never matter
+  ch_string *keys = calloc(max_count, sizeof(ch_string));
+
+  fprintf(stderr, "%8s %14s %14s %14s\n", "keys", "random ns", "same slot ns",
+          "equal ns");
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    bool salted;
+    double random = measure(random_hash, keys, counts[i], &salted);
+    double same_slot = measure(same_slot_hash, keys, counts[i], &salted);
+    fprintf(stderr, "%8u %14.1f %11.1f %s", counts[i], random, same_slot,
+            salted ? "(s)" : "   ");
+    if (counts[i] <= max_equal) {
+      double equal = measure(equal_hash, keys, counts[i], &salted);
+      fprintf(stderr, " %14.1f\n", equal);
+    } else {
+      fprintf(stderr, " %14s\n", "-");
+    }
+  }
+  fprintf(stderr, "(s): the table was salted\n");
+
+  free(keys);
+  return 0;
+}
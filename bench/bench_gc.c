@@ -0,0 +1,62 @@
+/*
+  Keeps a large chain of closures alive while churning through short lived
+  strings, then reports the collector's pauses in stop-the-world and in
+  incremental mode. This file is built once per primitive layout, see
+  bench/CMakeLists.txt.
+*/
+#include <compiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vm/chapman.h>
+
+static const char *SOURCE =
+    "val chain = null;"
+    "#wrap(previous) { #link() { return previous; } return link; }"
+    "#main() {"
+    "  val i = 100000;"
+    "  while (i) { chain = wrap(chain); i--; }"
+    "  val j = 300000;"
+    "  while (j) { val s = \"garbage\" + \"string\"; j--; }"
+    "  return 0;"
+    "}";
+
+static double now_ms(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+static void run_mode(const char *name, size_t work_budget) {
+  ch_program program;
+  if (!ch_compile((const uint8_t *)SOURCE, strlen(SOURCE), &program)) {
+    fprintf(stderr, "Failed to compile benchmark\n");
+    exit(1);
+  }
+
+  ch_context context = ch_newvm(program);
+  ch_gc_setincremental(&context, work_budget);
+
+  double start = now_ms();
+  ch_runfunction(&context, "main");
+  double elapsed = now_ms() - start;
+
+  ch_gc_stats stats = ch_gc_getstats(&context);
+  printf("%-16s total %8.2f ms, %4llu cycles, %7llu pauses, p99 %8.1f us, "
+         "max %8.1f us\n",
+         name, elapsed, (unsigned long long)stats.cycles,
+         (unsigned long long)stats.pauses, stats.p99_pause / 1000.0,
+         stats.max_pause / 1000.0);
+
+  ch_freevm(&context);
+  free(program.start);
+}
+
+int main(void) {
+  run_mode("stop-the-world", 0);
+  run_mode("incremental 100", 100);
+  run_mode("incremental 1000", 1000);
+
+  return 0;
+}
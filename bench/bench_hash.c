@@ -0,0 +1,64 @@
+/*
+  Hashes strings of increasing length with ch_hash_string and with the
+  byte at a time FNV-1a it replaced, and reports the throughput of both. This
+  file is built once per primitive layout, see bench/CMakeLists.txt, the hash
+  does not depend on it.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vm/hash.h>
+
+#define BYTES_PER_LENGTH (64 * 1024 * 1024)
+
+static double now_ms(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+static uint32_t fnv1a(const char *string, size_t n) {
+  uint32_t hash = 0x811C9DC5;
+  while (n--) {
+    hash = (*string ^ hash) * 0x01000193;
+    string++;
+  }
+
+  return hash;
+}
+
+// Hashes a sliding window of the buffer, so that every call sees new bytes.
+// The window starts in the first half, which is larger than any length.
+static double measure(uint32_t (*hash)(const char *, size_t),
+                      const char *buffer, size_t size, size_t length,
+                      uint32_t *sink) {
+  size_t calls = BYTES_PER_LENGTH / length;
+  double start = now_ms();
+  for (size_t i = 0; i < calls; i++) {
+    *sink += hash(&buffer[(i * 7) & (size / 2 - 1)], length);
+  }
+
+  double elapsed = now_ms() - start;
+  return (double)calls * length / (elapsed / 1000.0) / (1024 * 1024 * 1024);
+}
+
+int main(void) {
+  static const size_t lengths[] = {4, 8, 16, 32, 64, 128, 256, 1024, 4096};
+  size_t size = 1 << 16;
+  char *buffer = malloc(size);
+  for (size_t i = 0; i < size; i++) {
+    buffer[i] = (char)rand();
+  }
+
+  uint32_t sink = 0;
+  fprintf(stderr, "%8s %14s %14s\n", "length", "ch_hash GB/s", "fnv1a GB/s");
+  for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+    double fast = measure(ch_hash_string, buffer, size, lengths[i], &sink);
+    double fnv = measure(fnv1a, buffer, size, lengths[i], &sink);
+    fprintf(stderr, "%8zu %14.2f %14.2f\n", lengths[i], fast, fnv);
+  }
+
+  free(buffer);
+  return sink == 42;
+}
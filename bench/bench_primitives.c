@@ -0,0 +1,101 @@
+/*
+  Runs programs that mostly move primitives around (the value stack, locals,
+  globals and upvalues) and reports how long each of them takes. This file is
+  built once per primitive layout, see bench/CMakeLists.txt.
+*/
+#include <compiler.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vm/chapman.h>
+
+typedef struct {
+  const char *name;
+  const char *source;
+} ch_benchmark;
+
+static const ch_benchmark BENCHMARKS[] = {
+    {"locals", "#main() {"
+               "  val i = 3000000; val acc = 0;"
+               "  while (i) { acc = acc + i * 2 + 1; i--; }"
+               "  return acc;"
+               "}"},
+    {"globals", "val acc = 0;"
+                "#main() {"
+                "  val i = 2000000;"
+                "  while (i) { acc = acc + i; i--; }"
+                "  return acc;"
+                "}"},
+    {"calls", "#add(a, b) { return a + b; }"
+              "#main() {"
+              "  val i = 1000000; val acc = 0;"
+              "  while (i) { acc = add(acc, i); i--; }"
+              "  return acc;"
+              "}"},
+    {"upvalues", "#counter() {"
+                 "  val c = 0;"
+                 "  #inc() { c = c + 1; return c; }"
+                 "  return inc;"
+                 "}"
+                 "#main() {"
+                 "  val inc = counter(); val i = 1000000; val last = 0;"
+                 "  while (i) { last = inc(); i--; }"
+                 "  return last;"
+                 "}"},
+};
+
+static double now_ms(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+static double run_benchmark(const ch_benchmark *benchmark) {
+  ch_program program;
+  if (!ch_compile((const uint8_t *)benchmark->source, strlen(benchmark->source),
+                  &program)) {
+    fprintf(stderr, "Failed to compile benchmark %s\n", benchmark->name);
+    exit(1);
+  }
+
+  ch_context context = ch_newvm(program);
+  double start = now_ms();
+  ch_runfunction(&context, "main");
+  double elapsed = now_ms() - start;
+
+  if (context.exit != EXIT_OK) {
+    fprintf(stderr, "Benchmark %s exited with %d\n", benchmark->name,
+            context.exit);
+    exit(1);
+  }
+
+  ch_freevm(&context);
+  free(program.start);
+  return elapsed;
+}
+
+int main(int argc, char **argv) {
+  int repetitions = argc > 1 ? atoi(argv[1]) : 5;
+  const char *layout = CH_NAN_BOXING ? "nan-boxed" : "tagged";
+  size_t benchmark_count = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+  double results[sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0])];
+
+  for (size_t i = 0; i < benchmark_count; i++) {
+    // Keep the best run, the others mostly measure noise
+    results[i] = run_benchmark(&BENCHMARKS[i]);
+    for (int j = 1; j < repetitions; j++) {
+      double elapsed = run_benchmark(&BENCHMARKS[i]);
+      if (elapsed < results[i])
+        results[i] = elapsed;
+    }
+  }
+
+  printf("layout: %s, sizeof(ch_primitive): %zu\n", layout,
+         sizeof(ch_primitive));
+  for (size_t i = 0; i < benchmark_count; i++) {
+    printf("%-10s %8.2f ms\n", BENCHMARKS[i].name, results[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,108 @@
+/*
+  Times the numeric array kernels at every vector level the CPU supports, then
+  the sum of a numeric array computed by a script loop against the sum native.
+  This file is built once per primitive layout, see bench/CMakeLists.txt, only
+  the script loop depends on it.
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <compiler.h>
+#include <vm/chapman.h>
+#include <vm/vector.h>
+
+#define COUNT 4096
+#define ROUNDS 20000
+#define SCRIPT_ROUNDS 200
+
+static double now_ms(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+static const char *level_names[] = {"scalar", "sse2", "avx2"};
+
+// Nanoseconds per element of each kernel
+static void measure_kernels(double *values, double *other, double *sink) {
+  double start = now_ms();
+  for (int i = 0; i < ROUNDS; i++) {
+    *sink += ch_vector_sum(values, COUNT);
+  }
+  double sum = now_ms() - start;
+
+  start = now_ms();
+  for (int i = 0; i < ROUNDS; i++) {
+    *sink += ch_vector_dot(values, other, COUNT);
+  }
+  double dot = now_ms() - start;
+
+  start = now_ms();
+  for (int i = 0; i < ROUNDS; i++) {
+    *sink += ch_vector_max(values, COUNT);
+  }
+  double max = now_ms() - start;
+
+  start = now_ms();
+  for (int i = 0; i < ROUNDS; i++) {
+    memcpy(other, values, COUNT * sizeof(double));
+    ch_vector_prefix_sum(other, COUNT);
+  }
+  double prefix_sum = now_ms() - start;
+  *sink += other[COUNT - 1];
+
+  double scale = 1000000.0 / ((double)ROUNDS * COUNT);
+  fprintf(stderr, "%8.3f %8.3f %8.3f %11.3f\n", sum * scale, dot * scale,
+          max * scale, prefix_sum * scale);
+}
+
+static double measure_script(ch_context *vm, const char *function) {
+  double start = now_ms();
+  for (int i = 0; i < SCRIPT_ROUNDS; i++) {
+    ch_runfunction(vm, function);
+  }
+  return (now_ms() - start) * 1000000.0 / ((double)SCRIPT_ROUNDS * COUNT);
+}
+
+int main(void) {
+  double *values = malloc(COUNT * sizeof(double));
+  double *other = malloc(COUNT * sizeof(double));
+  for (int i = 0; i < COUNT; i++) {
+    values[i] = rand() / (double)RAND_MAX;
+    other[i] = rand() / (double)RAND_MAX;
+  }
+
+  double sink = 0;
+  fprintf(stderr, "ns per element over %d numbers\n", COUNT);
+  fprintf(stderr, "%8s %8s %8s %8s %11s\n", "level", "sum", "dot", "max",
+          "prefix sum");
+  for (int level = CH_VECTOR_SCALAR; level <= (int)ch_vector_supported(); level++) {
+    ch_vector_limit(level);
+    fprintf(stderr, "%8s ", level_names[level]);
+    measure_kernels(values, other, &sink);
+  }
+  ch_vector_limit(CH_VECTOR_AVX2);
+
+  char program[] =
+      "val data = null;"
+      "#setup() { data = numbers(0); val i = 4096; while (i) { data[] = i; i--; } return 0; }"
+      "#interpreted() { val total = 0; val i = size(data); while (i) { i--; total = total + data[i]; } return total; }"
+      "#kernel() { return sum(data); }";
+  ch_program compiled_program;
+  if (!ch_compile((uint8_t *)program, strlen(program), &compiled_program))
+    return 1;
+
+  ch_context vm = ch_newvm(compiled_program);
+  ch_runfunction(&vm, "setup");
+  double interpreted = measure_script(&vm, "interpreted");
+  double native = measure_script(&vm, "kernel");
+  fprintf(stderr, "script sum: loop %.3f ns, sum() %.3f ns per element\n",
+          interpreted, native);
+  ch_freevm(&vm);
+
+  free(values);
+  free(other);
+  return sink == 42;
+}
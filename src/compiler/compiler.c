@@ -1,5 +1,9 @@
 #include "compiler.h"
 #include "error.h"
+#include "ir.h"
+#include "peephole.h"
+#include "propagate.h"
+#include "infer.h"
 #include "token.h"
 #include "util.h"
 #include <inttypes.h>
@@ -45,8 +49,11 @@ static void synchronize_outside_function(ch_compilation *comp);
 static void synchronize_in_function(ch_compilation *comp);
 
 static void free_compiler(ch_compilation *comp);
+static void optimize_scope(ch_compilation *comp, ch_argcount argcount);
 static ch_dataptr emit_string(ch_compilation *comp, const char *value,
                               size_t size);
+static uint32_t global_slot(ch_compilation *comp, ch_lexeme name);
+static ch_dataptr emit_globals_directory(ch_compilation *comp);
 static ch_jmpptr emit_jump(ch_compilation *comp, ch_op jump_instruction);
 static void patch_jump(ch_compilation *comp, ch_jmpptr patch_address);
 
@@ -68,6 +75,7 @@ static void statement_identifier(ch_compilation *comp);
 static void expression_identifier(ch_compilation *comp);
 static void prefix_identifier(ch_compilation *comp);
 static void postfix_identifier(ch_compilation* comp, ch_token name);
+static void subscript_identifier(ch_compilation* comp, ch_token name, bool is_statement);
 static void identifier(ch_compilation *comp, bool must_have_invocation);
 
 static void declaration(ch_compilation *comp);
@@ -109,6 +117,10 @@ static void string(ch_compilation* comp);
 static void boolean(ch_compilation* comp);
 static void expression_char(ch_compilation* comp);
 static void expression_null(ch_compilation* comp);
+static void array(ch_compilation* comp);
+static void subscript(ch_compilation* comp);
+static void map(ch_compilation* comp);
+static void member(ch_compilation* comp);
 static void and(ch_compilation* comp);
 static void or(ch_compilation* comp);
 
@@ -129,12 +141,22 @@ ch_parse_rule rules[NUM_TOKENS] = {
     [TK_NULL] = {PREC_NONE, expression_null, NULL},
     [TK_PLUS_PLUS] = {PREC_NONE, prefix_identifier, NULL},
     [TK_MINUS_MINUS] = {PREC_NONE, prefix_identifier, NULL},
+    [TK_BOPEN] = {PREC_CALL, array, subscript},
+    [TK_COPEN] = {PREC_NONE, map, NULL},
+    [TK_DOT] = {PREC_CALL, NULL, member},
 };
 
 const ch_parse_rule *get_rule(ch_token_kind kind);
 
 bool ch_compile(const uint8_t *program, size_t program_size,
                 ch_program *output) {
+  return ch_compile_with_allocator(program, program_size, output,
+                                   ch_default_allocator());
+}
+
+bool ch_compile_with_allocator(const uint8_t *program, size_t program_size,
+                               ch_program *output, ch_allocator allocator) {
+  ch_memory *memory = ch_memory_create(allocator);
   ch_emit_scope global_emit_scope;
   ch_scope global_scope = new_localscope();
   ch_compilation comp = {
@@ -142,8 +164,13 @@ bool ch_compile(const uint8_t *program, size_t program_size,
       .scope = &global_scope,
       .is_panic = false,
       .has_errors = false,
-      .emit = ch_emit_create(&global_emit_scope),
+      .emit = ch_emit_create(&global_emit_scope, memory),
+      .globals_count = 0,
+      .memory = memory,
   };
+  ch_table_create(&comp.strings, memory);
+  ch_table_create(&comp.numbers, memory);
+  ch_table_create(&comp.globals, memory);
 
   advance(&comp);
   while (comp.current.kind != TK_EOF) {
@@ -158,11 +185,17 @@ bool ch_compile(const uint8_t *program, size_t program_size,
 
   EMIT_OP(GET_EMIT(&comp), OP_BEGIN);
 
+  optimize_scope(&comp, 0);
   ch_dataptr program_start_ptr = ch_emit_commit_scope(&comp.emit);
 
+  ch_dataptr globals_ptr = emit_globals_directory(&comp);
+
   *output = ch_emit_assemble(GET_EMIT(&comp), program_start_ptr);
+  output->globals_ptr = globals_ptr;
+  output->globals_count = comp.globals_count;
 
   free_compiler(&comp);
+  ch_memory_free(memory);
 
   return !comp.has_errors;
 }
@@ -260,20 +293,33 @@ void synchronize_in_function(ch_compilation *comp) {
   }
 }
 
-void free_compiler(ch_compilation *comp) {
-  for (uint32_t i = 0; i < comp->strings.size; i++) {
-    ch_table_entry entry = comp->strings.entries[i];
-    if (entry.key != NULL) {
-      // Strings allocated in emit_string
-      free((char*) entry.key->value);
-      free(entry.key);
+static void free_string_keys(ch_table *table) {
+  ch_table_finish_resize(table);
+  for (uint32_t i = 0; i < table->slots.capacity; i++) {
+    if (CH_TABLE_IN_USE(&table->slots, i)) {
+      ch_string *key = table->slots.keys[i];
+      // Strings allocated by copy_string
+      ch_memory_release(table->memory, (char*) key->value, key->size + 1);
+      ch_memory_release(table->memory, key, sizeof(ch_string));
     }
   }
+
+  ch_table_free(table);
 }
 
-ch_string *new_string(const char *value, size_t size) {
-  ch_string *string = (ch_string *)malloc(sizeof(ch_string));
-  ch_initstring(string, value, size);
+void free_compiler(ch_compilation *comp) {
+  free_string_keys(&comp->strings);
+  free_string_keys(&comp->numbers);
+  free_string_keys(&comp->globals);
+}
+
+static ch_string *copy_string(ch_compilation *comp, const char *value, size_t size) {
+  char* copied_value = (char*) ch_memory_alloc(comp->memory, size + 1);
+  memcpy(copied_value, value, size);
+  copied_value[size] = '\0';
+
+  ch_string *string = (ch_string *)ch_memory_alloc(comp->memory, sizeof(ch_string));
+  ch_initstring(string, copied_value, size);
 
   return string;
 }
@@ -283,22 +329,198 @@ ch_dataptr emit_string(ch_compilation *comp, const char *value, size_t size) {
 
   if (same_string != NULL) {
     ch_primitive *position = ch_table_get(&comp->strings, same_string);
-    return (ch_dataptr)position->number_value;
+    return (ch_dataptr)AS_NUMBER(*position);
   }
 
   ch_dataptr string_ptr;
   EMIT_DATA_STRING(GET_EMIT(comp), value, size, string_ptr);
 
-  char* copied_value = (char*) malloc(size + 1);
-  memcpy(copied_value, value, size);
-  copied_value[size] = '\0';
-
-  ch_string *key = new_string(copied_value, size);
+  ch_string *key = copy_string(comp, value, size);
   ch_table_set(&comp->strings, key, MAKE_NUMBER(string_ptr));
 
   return string_ptr;
 }
 
+/*
+  Lifts the bytecode of the scope being compiled into the IR, runs the
+  optimizer passes over it and lowers it back before the scope is committed.
+  The peephole pass runs again to merge the pops left by propagation, types
+  are inferred last so that they see the folded constants.
+*/
+void optimize_scope(ch_compilation *comp, ch_argcount argcount) {
+  ch_blob *bytecode = GET_BYTECODE(GET_EMIT(comp));
+  ch_ir ir;
+  if (comp->has_errors || !ch_ir_build(&ir, bytecode))
+    return;
+
+  ch_peephole(&ir);
+  ch_propagate(&ir, comp);
+  ch_peephole(&ir);
+  ch_infer_types(&ir, argcount);
+  ch_ir_lower(&ir, bytecode);
+}
+
+// Numbers are keyed by their bits, which tells -0 from 0
+ch_dataptr ch_compiler_number(ch_compilation *comp, double value) {
+  const char *bits = (const char *)&value;
+  ch_string *same_number = ch_table_find_string(&comp->numbers, bits, sizeof(double));
+
+  if (same_number != NULL) {
+    ch_primitive *position = ch_table_get(&comp->numbers, same_number);
+    return (ch_dataptr)AS_NUMBER(*position);
+  }
+
+  ch_dataptr number_ptr = EMIT_DATA_DOUBLE(GET_EMIT(comp), value);
+
+  ch_string *key = copy_string(comp, bits, sizeof(double));
+  ch_table_set(&comp->numbers, key, MAKE_NUMBER(number_ptr));
+
+  return number_ptr;
+}
+
+// Pushes a constant of the data section, which operators may fold
+static void emit_constant(ch_compilation *comp, ch_op push_op, ch_dataptr value_ptr) {
+  ch_blob *bytecode = GET_BYTECODE(GET_EMIT(comp));
+  size_t start = CH_BLOB_CONTENT_SIZE(bytecode);
+  EMIT_OP(GET_EMIT(comp), push_op);
+  EMIT_PTR(GET_EMIT(comp), value_ptr);
+
+  comp->literal = (ch_literal){
+      .scope = GET_EMIT(comp)->emit_scope,
+      .start = start,
+      .end = CH_BLOB_CONTENT_SIZE(bytecode),
+      .op = push_op,
+      .value_ptr = value_ptr,
+  };
+}
+
+// Whether the last instruction emitted pushed a constant
+static bool last_literal(ch_compilation *comp, ch_literal *out_literal) {
+  ch_literal *literal = &comp->literal;
+  if (literal->scope != GET_EMIT(comp)->emit_scope ||
+      literal->end != (size_t)CH_BLOB_CONTENT_SIZE(GET_BYTECODE(GET_EMIT(comp))))
+    return false;
+
+  *out_literal = *literal;
+  return true;
+}
+
+static double literal_number(ch_compilation *comp, ch_literal literal) {
+  double value;
+  memcpy(&value, &GET_DATA(GET_EMIT(comp))->start[literal.value_ptr], sizeof(double));
+  return value;
+}
+
+static ch_dataptr concat_literals(ch_compilation *comp, ch_literal left, ch_literal right) {
+  const uint8_t *data = GET_DATA(GET_EMIT(comp))->start;
+  uint32_t left_size = READ_U32(&data[left.value_ptr]);
+  uint32_t right_size = READ_U32(&data[right.value_ptr]);
+
+  // Copied out first, emitting the result may move the data section
+  size_t size = (size_t)left_size + right_size;
+  char *value = ch_memory_alloc(comp->memory, size + 1);
+  memcpy(value, &data[left.value_ptr + sizeof(uint32_t)], left_size);
+  memcpy(value + left_size, &data[right.value_ptr + sizeof(uint32_t)], right_size);
+
+  ch_dataptr value_ptr = emit_string(comp, value, size);
+  ch_memory_release(comp->memory, value, size + 1);
+  return value_ptr;
+}
+
+/*
+  Replaces a constant and the one right after it, which were the last
+  instructions emitted, by the result of op. Numbers fold like the VM would
+  compute them, strings only fold their concatenation. Returns whether the
+  operands were folded, mixed types are left to fail at runtime.
+*/
+static bool fold_binary(ch_compilation *comp, ch_literal left, ch_op op) {
+  ch_literal right;
+  if (!last_literal(comp, &right) || right.start != left.end || right.op != left.op)
+    return false;
+
+  ch_dataptr result_ptr;
+  if (left.op == OP_NUMBER) {
+    double left_value = literal_number(comp, left);
+    double right_value = literal_number(comp, right);
+    double result;
+    switch (op) {
+    case OP_ADD:
+      result = left_value + right_value;
+      break;
+    case OP_SUB:
+      result = left_value - right_value;
+      break;
+    case OP_MUL:
+      result = left_value * right_value;
+      break;
+    case OP_DIV:
+      result = left_value / right_value;
+      break;
+    default:
+      return false;
+    }
+
+    result_ptr = ch_compiler_number(comp, result);
+  } else if (op == OP_ADD) {
+    result_ptr = concat_literals(comp, left, right);
+  } else {
+    return false;
+  }
+
+  ch_emit_truncate(GET_EMIT(comp), left.start);
+  emit_constant(comp, left.op, result_ptr);
+  return true;
+}
+
+uint32_t global_slot(ch_compilation *comp, ch_lexeme name) {
+  ch_string *same_name = ch_table_find_string(&comp->globals, name.start, name.size);
+
+  if (same_name != NULL) {
+    ch_primitive *slot = ch_table_get(&comp->globals, same_name);
+    return (uint32_t)AS_NUMBER(*slot);
+  }
+
+  uint32_t slot = comp->globals_count++;
+  ch_string *key = copy_string(comp, name.start, name.size);
+  ch_table_set(&comp->globals, key, MAKE_NUMBER(slot));
+
+  return slot;
+}
+
+// The directory lets the VM (and the host through it) map global names to slots
+ch_dataptr emit_globals_directory(ch_compilation *comp) {
+  size_t keys_size = comp->globals_count * sizeof(ch_string *);
+  ch_string **keys = ch_memory_alloc(comp->memory, keys_size);
+  ch_table_slots *slots = &comp->globals.slots;
+  ch_table_finish_resize(&comp->globals);
+  for (uint32_t i = 0; i < slots->capacity; i++) {
+    if (!CH_TABLE_IN_USE(slots, i))
+      continue;
+
+    uint32_t slot = (uint32_t)AS_NUMBER(slots->values[i]);
+    keys[slot] = slots->keys[i];
+  }
+
+  // Names missing from the data section are emitted in slot order, the order
+  // of the table changes with the hash seed and the bytecode must not
+  size_t names_size = comp->globals_count * sizeof(ch_dataptr);
+  ch_dataptr *names = ch_memory_alloc(comp->memory, names_size);
+  for (uint32_t i = 0; i < comp->globals_count; i++) {
+    names[i] = emit_string(comp, keys[i]->value, keys[i]->size);
+  }
+  ch_memory_release(comp->memory, keys, keys_size);
+
+  ch_dataptr globals_ptr = ch_emit_data_position(GET_EMIT(comp));
+  for (uint32_t i = 0; i < comp->globals_count; i++) {
+    uint8_t le_value[4];
+    ch_uint32_to_le_array(names[i], le_value);
+    EMIT_DATA(GET_EMIT(comp), &le_value, sizeof(le_value));
+  }
+
+  ch_memory_release(comp->memory, names, names_size);
+  return globals_ptr;
+}
+
 ch_jmpptr emit_jump(ch_compilation *comp, ch_op jump_instruction) {
   EMIT_OP(GET_EMIT(comp), jump_instruction);
   EMIT_PTR(GET_EMIT(comp), 0)
@@ -312,6 +534,8 @@ void patch_jump(ch_compilation *comp, ch_jmpptr patch_address) {
   ch_jmpptr offset = CH_BLOB_CONTENT_SIZE(bytecode) - patch_address - sizeof(ch_jmpptr);
 
   ch_emit_patch_ptr(GET_EMIT(comp), offset, patch_address);
+  // Jumps land here, the constant before is not always what's on the stack
+  comp->literal.scope = NULL;
 }
 
 void emit_loop(ch_compilation *comp, ch_jmpptr offset) {
@@ -327,6 +551,7 @@ void emit_loop(ch_compilation *comp, ch_jmpptr offset) {
 
 ch_jmpptr record_loop(ch_compilation *comp) {
   ch_blob* bytecode = &GET_EMIT(comp)->emit_scope->bytecode;
+  comp->literal.scope = NULL;
   return CH_BLOB_CONTENT_SIZE(bytecode);
 }
 
@@ -363,6 +588,8 @@ void function(ch_compilation *comp) {
 
   ch_emit_scope emit_scope;
   ch_emit_create_scope(&comp->emit, &emit_scope);
+  // A constant recorded in a sibling function could sit at the same address
+  comp->literal.scope = NULL;
 
   uint8_t scope_mark = begin_scope(comp);
   ch_argcount argcount = function_arglist(comp);
@@ -372,6 +599,7 @@ void function(ch_compilation *comp) {
   // Ensure that all functions return
   EMIT_OP(GET_EMIT(comp), OP_RETURN_VOID);
 
+  optimize_scope(comp, argcount);
   ch_dataptr function_ptr = ch_emit_commit_scope(&comp->emit);
 
   EMIT_OP(GET_EMIT(comp), OP_FUNCTION);
@@ -468,6 +696,11 @@ void identifier(ch_compilation *comp, bool is_statement) {
       assignement(comp, name.lexeme);
       break;
     }
+    case TK_BOPEN:
+    case TK_DOT: {
+      subscript_identifier(comp, name, is_statement);
+      break;
+    }
     default: {
       load_variable(comp, name.lexeme);
       postfix_identifier(comp, name);
@@ -493,6 +726,57 @@ void postfix_identifier(ch_compilation* comp, ch_token name) {
   }
 }
 
+// Indexes into a variable or reads its members, which a[i] = value,
+// a[] = value and m.key = value store into
+void subscript_identifier(ch_compilation* comp, ch_token name, bool is_statement) {
+  load_variable(comp, name.lexeme);
+
+  ch_token access;
+  while (opt_consume(comp, TK_BOPEN, &access) || opt_consume(comp, TK_DOT, &access)) {
+    if (access.kind == TK_DOT) {
+      ch_token key;
+      if (!consume(comp, TK_ID, "Expected member name.", &key)) return;
+
+      ch_dataptr key_ptr = emit_string(comp, key.lexeme.start, key.lexeme.size);
+      if (opt_consume(comp, TK_EQ, NULL)) {
+        expression(comp);
+        // The map stays on the stack after a store
+        EMIT_OP(GET_EMIT(comp), OP_MAP_SET);
+        EMIT_PTR(GET_EMIT(comp), key_ptr);
+        EMIT_OP(GET_EMIT(comp), OP_POP);
+        return;
+      }
+
+      EMIT_OP(GET_EMIT(comp), OP_MAP_GET);
+      EMIT_PTR(GET_EMIT(comp), key_ptr);
+      continue;
+    }
+
+    if (opt_consume(comp, TK_BCLOSE, NULL)) {
+      consume(comp, TK_EQ, "Expected value to append.", NULL);
+      expression(comp);
+      // The array stays on the stack after an append
+      EMIT_OP(GET_EMIT(comp), OP_ARRAY_PUSH);
+      EMIT_OP(GET_EMIT(comp), OP_POP);
+      return;
+    }
+
+    expression(comp);
+    consume(comp, TK_BCLOSE, "Expected closing bracket.", NULL);
+    if (opt_consume(comp, TK_EQ, NULL)) {
+      expression(comp);
+      EMIT_OP(GET_EMIT(comp), OP_INDEX_SET);
+      return;
+    }
+
+    EMIT_OP(GET_EMIT(comp), OP_INDEX_GET);
+  }
+
+  if (is_statement) {
+    EMIT_OP(GET_EMIT(comp), OP_POP);
+  }
+}
+
 void invocation(ch_compilation *comp, ch_lexeme name) {
   consume(comp, TK_POPEN, "Expected start of invocation", NULL);
   ch_argcount argcount = invocation_arguments(comp);
@@ -587,9 +871,8 @@ uint8_t add_upvalue(ch_compilation *comp, ch_scope * scope, uint8_t offset, bool
 }
 
 void add_global(ch_compilation *comp, ch_lexeme name) {
-  EMIT_OP(GET_EMIT(comp), OP_DEFINE_GLOBAL);
-  ch_dataptr string_ptr = emit_string(comp, name.start, name.size);
-  EMIT_PTR(GET_EMIT(comp), string_ptr);
+  EMIT_OP(GET_EMIT(comp), OP_DEFINE_GLOBAL_SLOT);
+  EMIT_PTR(GET_EMIT(comp), global_slot(comp, name));
 }
 
 void load_variable(ch_compilation *comp, ch_lexeme name) {
@@ -602,9 +885,8 @@ void load_variable(ch_compilation *comp, ch_lexeme name) {
     EMIT_OP(GET_EMIT(comp), OP_LOAD_UPVALUE);
     EMIT_ARGCOUNT(GET_EMIT(comp), offset);
   } else {
-    EMIT_OP(GET_EMIT(comp), OP_LOAD_GLOBAL);
-    ch_dataptr string_ptr = emit_string(comp, name.start, name.size);
-    EMIT_PTR(GET_EMIT(comp), string_ptr);
+    EMIT_OP(GET_EMIT(comp), OP_LOAD_GLOBAL_SLOT);
+    EMIT_PTR(GET_EMIT(comp), global_slot(comp, name));
   }
 }
 
@@ -618,9 +900,8 @@ void set_variable(ch_compilation* comp, ch_lexeme name) {
     EMIT_OP(GET_EMIT(comp), OP_SET_UPVALUE);
     EMIT_ARGCOUNT(GET_EMIT(comp), offset);
   } else {
-    EMIT_OP(GET_EMIT(comp), OP_SET_GLOBAL);
-    ch_dataptr string_ptr = emit_string(comp, name.start, name.size);
-    EMIT_PTR(GET_EMIT(comp), string_ptr);
+    EMIT_OP(GET_EMIT(comp), OP_SET_GLOBAL_SLOT);
+    EMIT_PTR(GET_EMIT(comp), global_slot(comp, name));
   }
 }
 
@@ -927,35 +1208,79 @@ void binary(ch_compilation *comp) {
   ch_token_kind kind = comp->previous.kind;
 
   ch_precedence_level prec = get_rule(kind)->prec;
+  ch_literal left;
+  bool left_literal = last_literal(comp, &left);
   parse(comp, (ch_precedence_level)(prec + 1));
 
+  ch_op operation;
   switch (kind) {
-  case TK_PLUS:
-    EMIT_OP(GET_EMIT(comp), OP_ADD);
-    break;
+  case TK_PLUS: {
+    // A chain of additions is evaluated by a single instruction, so that
+    // concatenating strings does not build every intermediate result.
+    // Numbers only fold while the whole chain does, additions of doubles
+    // do not associate.
+    ch_argcount count = 2;
+    if (left_literal && fold_binary(comp, left, OP_ADD)) {
+      count--;
+    }
+
+    while (comp->current.kind == TK_PLUS && count < UINT8_MAX) {
+      advance(comp);
+      left_literal = last_literal(comp, &left);
+      parse(comp, (ch_precedence_level)(prec + 1));
+      count++;
+
+      if (left_literal && (count == 2 || left.op == OP_STRING) &&
+          fold_binary(comp, left, OP_ADD)) {
+        count--;
+      }
+    }
+
+    if (count == 2) {
+      EMIT_OP(GET_EMIT(comp), OP_ADD);
+    } else if (count > 2) {
+      EMIT_OP(GET_EMIT(comp), OP_CONCATN);
+      EMIT_ARGCOUNT(GET_EMIT(comp), count);
+    }
+    return;
+  }
   case TK_MINUS:
-    EMIT_OP(GET_EMIT(comp), OP_SUB);
+    operation = OP_SUB;
     break;
   case TK_STAR:
-    EMIT_OP(GET_EMIT(comp), OP_MUL);
+    operation = OP_MUL;
     break;
   case TK_FSLASH:
-    EMIT_OP(GET_EMIT(comp), OP_DIV);
+    operation = OP_DIV;
     break;
   default:
     return;
   }
+
+  if (!left_literal || !fold_binary(comp, left, operation)) {
+    EMIT_OP(GET_EMIT(comp), operation);
+  }
 }
 
 void unary(ch_compilation *comp) {
   ch_token_kind kind = comp->previous.kind;
 
+  size_t start = CH_BLOB_CONTENT_SIZE(GET_BYTECODE(GET_EMIT(comp)));
   parse(comp, PREC_UNARY);
 
   switch (kind) {
-  case TK_MINUS:
+  case TK_MINUS: {
+    // Negative literals are constants of their own
+    ch_literal operand;
+    if (last_literal(comp, &operand) && operand.start == start && operand.op == OP_NUMBER) {
+      ch_emit_truncate(GET_EMIT(comp), start);
+      emit_constant(comp, OP_NUMBER, ch_compiler_number(comp, -literal_number(comp, operand)));
+      break;
+    }
+
     EMIT_OP(GET_EMIT(comp), OP_NEGATE);
     break;
+  }
   default:
     return;
   }
@@ -979,27 +1304,23 @@ void number(ch_compilation *comp) {
   const char *start = comp->previous.lexeme.start;
 
   double value = strtod(start, NULL);
-  ch_dataptr value_ptr = EMIT_DATA_DOUBLE(GET_EMIT(comp), value);
-
-  EMIT_OP(GET_EMIT(comp), OP_NUMBER);
-  EMIT_PTR(GET_EMIT(comp), value_ptr);
+  emit_constant(comp, OP_NUMBER, ch_compiler_number(comp, value));
 }
 
-void string(ch_compilation* comp) {
-  ch_token string = comp->previous;
-
-  // We strip the string of escape chars
-  char cleaned_string[string.lexeme.size];
+// Emits the value of a string literal, stripped of its escape chars
+static ch_dataptr emit_literal(ch_compilation* comp, ch_lexeme literal) {
+  char cleaned_string[literal.size];
   uint32_t output_i = 0;
-  for(uint32_t i = 0; i < string.lexeme.size; i++) {
-    if(string.lexeme.start[i] == '\\') i++;
-    cleaned_string[output_i++] = string.lexeme.start[i]; 
+  for(uint32_t i = 0; i < literal.size; i++) {
+    if(literal.start[i] == '\\') i++;
+    cleaned_string[output_i++] = literal.start[i]; 
   }
 
-  EMIT_OP(GET_EMIT(comp), OP_STRING);
-  // TODO make emit_string copy cleaned_string, because the buffer becomes out of scope once the function returns
-  ch_dataptr string_ptr = emit_string(comp, cleaned_string, output_i);
-  EMIT_PTR(GET_EMIT(comp), string_ptr);
+  return emit_string(comp, cleaned_string, output_i);
+}
+
+void string(ch_compilation* comp) {
+  emit_constant(comp, OP_STRING, emit_literal(comp, comp->previous.lexeme));
 }
 
 void boolean(ch_compilation* comp) {
@@ -1035,6 +1356,73 @@ void expression_null(ch_compilation* comp) {
   EMIT_OP(GET_EMIT(comp), OP_NULL);
 }
 
+void array(ch_compilation* comp) {
+  // OP_ARRAY takes up to UINT8_MAX elements, any further ones are appended
+  ch_argcount count = 0;
+  bool created = false;
+  while (comp->current.kind != TK_BCLOSE && comp->current.kind != TK_EOF) {
+    expression(comp);
+    if (created) {
+      EMIT_OP(GET_EMIT(comp), OP_ARRAY_PUSH);
+    } else if (++count == UINT8_MAX) {
+      EMIT_OP(GET_EMIT(comp), OP_ARRAY);
+      EMIT_ARGCOUNT(GET_EMIT(comp), count);
+      created = true;
+    }
+
+    if (!opt_consume(comp, TK_COMMA, NULL))
+      break;
+  }
+
+  consume(comp, TK_BCLOSE, "Expected closing bracket.", NULL);
+  if (!created) {
+    EMIT_OP(GET_EMIT(comp), OP_ARRAY);
+    EMIT_ARGCOUNT(GET_EMIT(comp), count);
+  }
+}
+
+void subscript(ch_compilation* comp) {
+  expression(comp);
+  consume(comp, TK_BCLOSE, "Expected closing bracket.", NULL);
+  EMIT_OP(GET_EMIT(comp), OP_INDEX_GET);
+}
+
+// {key: value, "other key": value}
+void map(ch_compilation* comp) {
+  EMIT_OP(GET_EMIT(comp), OP_MAP);
+  while (comp->current.kind != TK_CCLOSE && comp->current.kind != TK_EOF) {
+    ch_token key;
+    ch_dataptr key_ptr;
+    if (opt_consume(comp, TK_ID, &key)) {
+      key_ptr = emit_string(comp, key.lexeme.start, key.lexeme.size);
+    } else if (opt_consume(comp, TK_STRING, &key)) {
+      key_ptr = emit_literal(comp, key.lexeme);
+    } else {
+      error(comp, "Expected map key.");
+      return;
+    }
+
+    consume(comp, TK_COLON, "Expected colon after map key.", NULL);
+    expression(comp);
+    // The map stays on the stack for the next member
+    EMIT_OP(GET_EMIT(comp), OP_MAP_SET);
+    EMIT_PTR(GET_EMIT(comp), key_ptr);
+
+    if (!opt_consume(comp, TK_COMMA, NULL))
+      break;
+  }
+
+  consume(comp, TK_CCLOSE, "Expected closing brace.", NULL);
+}
+
+void member(ch_compilation* comp) {
+  ch_token key;
+  if (!consume(comp, TK_ID, "Expected member name.", &key)) return;
+
+  EMIT_OP(GET_EMIT(comp), OP_MAP_GET);
+  EMIT_PTR(GET_EMIT(comp), emit_string(comp, key.lexeme.start, key.lexeme.size));
+}
+
 void and(ch_compilation* comp) {
   ch_dataptr patch = emit_jump(comp, OP_JMP_FALSE); // If false, no need to evaluate the next expression
   EMIT_OP(GET_EMIT(comp), OP_POP);
@@ -1049,4 +1437,4 @@ void or(ch_compilation* comp) {
   EMIT_OP(GET_EMIT(comp), OP_POP);
   parse(comp, PREC_OR);
   patch_jump(comp, patch_true);
-}
\ No newline at end of file
+}
\ No newline at end of file
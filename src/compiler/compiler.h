@@ -26,6 +26,20 @@ typedef struct ch_scope {
   struct ch_scope* parent;
 } ch_scope;
 
+/*
+  The constant pushed by the last OP_NUMBER or OP_STRING emitted. Operators
+  applied to constants replace their operands by the result, as long as
+  nothing was emitted after them.
+*/
+typedef struct {
+  ch_emit_scope *scope;
+  // Offsets of the instruction in the scope's bytecode
+  size_t start;
+  size_t end;
+  ch_op op;
+  ch_dataptr value_ptr;
+} ch_literal;
+
 typedef struct {
   ch_token_state token_state;
   ch_token previous;
@@ -44,7 +58,23 @@ typedef struct {
 
   ch_emit emit;
   ch_table strings;
+  // Bits of a number -> its position in the data section
+  ch_table numbers;
+  ch_literal literal;
+  // Global name -> slot index, slots are handed out in order of first use
+  ch_table globals;
+  uint32_t globals_count;
+
+  ch_memory *memory;
 } ch_compilation;
 
+// Position of the number in the data section, each number is only emitted once
+ch_dataptr ch_compiler_number(ch_compilation *comp, double value);
+
 bool ch_compile(const uint8_t *program, size_t program_size,
-                ch_program *output);
\ No newline at end of file
+                ch_program *output);
+
+// Everything the compiler allocates goes through the allocator, including
+// output->start which the caller frees with it
+bool ch_compile_with_allocator(const uint8_t *program, size_t program_size,
+                               ch_program *output, ch_allocator allocator);
\ No newline at end of file
@@ -1,19 +1,19 @@
 #include "emit.h"
 #include "util.h"
 #include <stddef.h>
-#include <stdlib.h>
 #include <string.h>
 
 #define INITIAL_BLOB_SIZE 10000
 
-ch_blob create_blob();
+ch_blob create_blob(ch_memory *memory);
 void free_blob(ch_blob *blob);
 
-ch_emit ch_emit_create(ch_emit_scope *out_scope) {
+ch_emit ch_emit_create(ch_emit_scope *out_scope, ch_memory *memory) {
   ch_emit emit = {
       .emit_scope = NULL,
-      .data = create_blob(),
-      .function_bytecode = create_blob(),
+      .data = create_blob(memory),
+      .function_bytecode = create_blob(memory),
+      .memory = memory,
   };
 
   ch_emit_create_scope(&emit, out_scope);
@@ -23,7 +23,7 @@ ch_emit ch_emit_create(ch_emit_scope *out_scope) {
 }
 
 void ch_emit_create_scope(ch_emit *emit, ch_emit_scope *out_scope) {
-  out_scope->bytecode = create_blob();
+  out_scope->bytecode = create_blob(emit->memory);
   out_scope->parent = emit->emit_scope;
 
   emit->emit_scope = out_scope;
@@ -50,7 +50,7 @@ ch_program ch_emit_assemble(ch_emit *emit, ch_dataptr program_start_ptr) {
       emit->function_bytecode.current - emit->function_bytecode.start;
   size_t program_size = data_size + bytecode_size;
 
-  uint8_t *program = (uint8_t *)malloc(program_size);
+  uint8_t *program = (uint8_t *)ch_memory_alloc(emit->memory, program_size);
   memcpy(program, emit->data.start, data_size);
   memcpy(program + data_size, emit->function_bytecode.start, bytecode_size);
 
@@ -74,10 +74,11 @@ ch_dataptr ch_emit_write(ch_blob *blob, const void *data_start,
   if (new_size >= blob->size) {
     size_t max_new_size =
         MAX(blob->size * CH_BLOB_BUFFER_GROWTH_MULTIPLIER, new_size);
-    // TODO check how realloc changes blob->start pointer
-    blob->start =
-        realloc((void *)blob->start, MIN(CH_DATAPTR_MAX, max_new_size));
-    blob->current = blob->start + CH_BLOB_CONTENT_SIZE(blob);
+    size_t content_size = CH_BLOB_CONTENT_SIZE(blob);
+    size_t size = MIN(CH_DATAPTR_MAX, max_new_size);
+    blob->start = ch_memory_realloc(blob->memory, blob->start, blob->size, size);
+    blob->current = blob->start + content_size;
+    blob->size = size;
   }
 
   ch_dataptr write_ptr = blob->current - blob->start;
@@ -87,6 +88,10 @@ ch_dataptr ch_emit_write(ch_blob *blob, const void *data_start,
   return write_ptr;
 }
 
+ch_dataptr ch_emit_data_position(ch_emit *emit) {
+  return CH_BLOB_CONTENT_SIZE(&emit->data);
+}
+
 void ch_emit_patch_ptr(ch_emit* emit, ch_dataptr ptr, ch_jmpptr patch_at) {
   ch_blob* bytecode = &emit->emit_scope->bytecode;
 
@@ -100,6 +105,13 @@ void ch_emit_patch_ptr(ch_emit* emit, ch_dataptr ptr, ch_jmpptr patch_at) {
   memcpy(&bytecode->start[patch_at], &ptr_le[0], sizeof(ptr_le));
 }
 
+void ch_emit_truncate(ch_emit *emit, size_t offset) {
+  ch_blob *bytecode = &emit->emit_scope->bytecode;
+  if (offset < (size_t)CH_BLOB_CONTENT_SIZE(bytecode)) {
+    bytecode->current = bytecode->start + offset;
+  }
+}
+
 inline void ch_uint32_to_le_array(uint32_t value, uint8_t *out_array) {
   out_array[0] = (value & 0xff);
   out_array[1] = (value & 0xff00) >> 8;
@@ -107,19 +119,20 @@ inline void ch_uint32_to_le_array(uint32_t value, uint8_t *out_array) {
   out_array[3] = (value & 0xff000000) >> 24;
 }
 
-ch_blob create_blob() {
-  uint8_t *start = malloc(INITIAL_BLOB_SIZE);
+ch_blob create_blob(ch_memory *memory) {
+  uint8_t *start = ch_memory_alloc(memory, INITIAL_BLOB_SIZE);
   return (ch_blob){
       .size = INITIAL_BLOB_SIZE,
       .start = start,
       .current = start,
+      .memory = memory,
   };
 }
 
 void free_blob(ch_blob *blob) {
-  free(blob->start);
+  ch_memory_release(blob->memory, blob->start, blob->size);
 
   blob->start = NULL;
   blob->current = NULL;
   blob->size = 0;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -54,6 +54,7 @@ typedef struct {
   uint8_t *start;
   uint8_t *current;
   size_t size;
+  ch_memory *memory;
 } ch_blob;
 
 typedef struct ch_emit_scope {
@@ -65,20 +66,28 @@ typedef struct {
   ch_emit_scope *emit_scope;
   ch_blob function_bytecode;
   ch_blob data;
+  ch_memory *memory;
 } ch_emit;
 
-ch_emit ch_emit_create(ch_emit_scope *out_scope);
+ch_emit ch_emit_create(ch_emit_scope *out_scope, ch_memory *memory);
 
 void ch_emit_create_scope(ch_emit *emit, ch_emit_scope *out_scope);
 
 ch_dataptr ch_emit_commit_scope(ch_emit *emit);
 
+// The program is allocated with the emitter's allocator
 ch_program ch_emit_assemble(ch_emit *emit, ch_dataptr program_start_ptr);
 
 ch_dataptr ch_emit_write(ch_blob *emit, const void *value_ptr, size_t size);
 
+// Offset at which the next write to the data section will land
+ch_dataptr ch_emit_data_position(ch_emit *emit);
+
 void ch_emit_patch_ptr(ch_emit* emit, ch_dataptr ptr, ch_jmpptr patch_at);
 
+// Drops the bytecode of the current scope from offset on
+void ch_emit_truncate(ch_emit *emit, size_t offset);
+
 // Convert a uint32_t to a uint8_t[4] array that contains the bytes in
 // little-endian order
-void ch_uint32_to_le_array(uint32_t value, uint8_t *out_array);
\ No newline at end of file
+void ch_uint32_to_le_array(uint32_t value, uint8_t *out_array);
\ No newline at end of file
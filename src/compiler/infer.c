@@ -0,0 +1,350 @@
+#include "infer.h"
+#include <string.h>
+
+// Deeper stacks are left to the generic ops
+#define MAX_DEPTH 512
+#define MAX_SLOTS (UINT8_MAX + 1)
+#define UNVISITED UINT32_MAX
+
+typedef enum {
+  TYPE_UNKNOWN,
+  TYPE_NUMBER,
+  // A string or a rope
+  TYPE_TEXT,
+} ch_static_type;
+
+// Types of the values on the stack, locals included, relative to the frame
+typedef struct {
+  uint32_t depth;
+  uint8_t types[MAX_DEPTH];
+} ch_stack_types;
+
+typedef struct {
+  ch_ir *ir;
+  bool captured[MAX_SLOTS];
+
+  // Stack at the start of each block, UNVISITED depth until flow reaches it
+  ch_stack_types *entries;
+  // Block starting at each instruction
+  uint32_t *block_of;
+
+  uint32_t *pending;
+  uint32_t pending_count;
+  bool *queued;
+} ch_inference;
+
+static ch_argcount argcount_operand(const ch_ir *ir, uint32_t index,
+                                    size_t position) {
+  const uint8_t *instruction = &ir->bytecode[ir->instructions[index].offset];
+  return READ_ARGCOUNT(instruction + 1 + position * sizeof(ch_argcount));
+}
+
+static void find_captured(ch_inference *inference) {
+  ch_ir *ir = inference->ir;
+  memset(inference->captured, 0, sizeof(inference->captured));
+
+  for (uint32_t i = 0; i < ir->count; i++) {
+    if (!ir->instructions[i].kept || ir->instructions[i].op != OP_CLOSURE)
+      continue;
+
+    // (is_local, index) pairs follow the upvalue count
+    ch_argcount upvalue_count = argcount_operand(ir, i, 0);
+    for (ch_argcount upvalue = 0; upvalue < upvalue_count; upvalue++) {
+      if (argcount_operand(ir, i, 1 + upvalue * 2))
+        inference->captured[argcount_operand(ir, i, 2 + upvalue * 2)] = true;
+    }
+  }
+}
+
+static bool push(ch_stack_types *stack, ch_static_type type) {
+  if (stack->depth >= MAX_DEPTH)
+    return false;
+  stack->types[stack->depth++] = type;
+  return true;
+}
+
+static bool pop(ch_stack_types *stack, uint32_t count) {
+  if (stack->depth < count)
+    return false;
+  stack->depth -= count;
+  return true;
+}
+
+static ch_static_type local_type(ch_inference *inference,
+                                 const ch_stack_types *stack, uint32_t slot) {
+  if (slot >= stack->depth || slot >= MAX_SLOTS || inference->captured[slot])
+    return TYPE_UNKNOWN;
+  return stack->types[slot];
+}
+
+static ch_op typed_op(ch_op op, ch_static_type left, ch_static_type right) {
+  if (left == TYPE_TEXT && right == TYPE_TEXT && op == OP_ADD)
+    return OP_CONCAT_STR;
+  if (left != TYPE_NUMBER || right != TYPE_NUMBER)
+    return op;
+
+  switch (op) {
+  case OP_ADD:
+    return OP_ADD_NUM;
+  case OP_SUB:
+    return OP_SUB_NUM;
+  case OP_MUL:
+    return OP_MUL_NUM;
+  case OP_DIV:
+    return OP_DIV_NUM;
+  default:
+    return op;
+  }
+}
+
+// Mismatched operands stop the program, so a result only exists when the
+// known operand told the type of the other one
+static ch_static_type binary_result(ch_op op, ch_static_type left,
+                                    ch_static_type right) {
+  switch (op) {
+  case OP_ADD:
+    return left != TYPE_UNKNOWN ? left : right;
+  case OP_CONCAT_STR:
+    return TYPE_TEXT;
+  default:
+    return TYPE_NUMBER;
+  }
+}
+
+static bool binary(ch_inference *inference, ch_stack_types *stack,
+                   uint32_t index, bool rewrite) {
+  if (stack->depth < 2)
+    return false;
+
+  ch_op op = inference->ir->instructions[index].op;
+  ch_static_type left = stack->types[stack->depth - 2];
+  ch_static_type right = stack->types[stack->depth - 1];
+  ch_op typed = typed_op(op, left, right);
+  if (rewrite && typed != op)
+    ch_ir_rewrite(inference->ir, index, typed, 0);
+
+  stack->depth--;
+  stack->types[stack->depth - 1] = binary_result(op, left, right);
+  return true;
+}
+
+// Operands of OP_CONCATN are either all numbers or all texts
+static bool concat(ch_stack_types *stack, uint32_t count) {
+  if (count == 0 || !pop(stack, count))
+    return false;
+
+  ch_static_type result = TYPE_UNKNOWN;
+  for (uint32_t i = 0; i < count; i++) {
+    if (stack->types[stack->depth + i] != TYPE_UNKNOWN)
+      result = stack->types[stack->depth + i];
+  }
+  return push(stack, result);
+}
+
+// Returns false for stacks the pass can't follow
+static bool step(ch_inference *inference, ch_stack_types *stack,
+                 uint32_t index, bool rewrite) {
+  ch_ir *ir = inference->ir;
+  ch_ir_instruction *instruction = &ir->instructions[index];
+
+  switch (instruction->op) {
+  case OP_NUMBER:
+    return push(stack, TYPE_NUMBER);
+  case OP_STRING:
+    return push(stack, TYPE_TEXT);
+  case OP_FALSE:
+  case OP_TRUE:
+  case OP_CHAR:
+  case OP_NULL:
+  case OP_MAP:
+  case OP_LOAD_UPVALUE:
+  case OP_LOAD_GLOBAL:
+  case OP_LOAD_GLOBAL_SLOT:
+  case OP_FUNCTION:
+    return push(stack, TYPE_UNKNOWN);
+  case OP_TOP:
+    return stack->depth > 0 && push(stack, stack->types[stack->depth - 1]);
+  case OP_LOAD_LOCAL:
+    return push(stack, local_type(inference, stack, instruction->operand));
+  case OP_SET_LOCAL: {
+    if (!pop(stack, 1))
+      return false;
+    if (instruction->operand < stack->depth)
+      stack->types[instruction->operand] = stack->types[stack->depth];
+    return true;
+  }
+
+  case OP_ADD:
+  case OP_SUB:
+  case OP_MUL:
+  case OP_DIV:
+  case OP_ADD_NUM:
+  case OP_SUB_NUM:
+  case OP_MUL_NUM:
+  case OP_DIV_NUM:
+  case OP_CONCAT_STR:
+    return binary(inference, stack, index, rewrite);
+  case OP_ADDONE:
+  case OP_SUBONE:
+  case OP_NEGATE:
+    return pop(stack, 1) && push(stack, TYPE_NUMBER);
+  case OP_CONCATN:
+    return concat(stack, argcount_operand(ir, index, 0));
+
+  case OP_POP:
+  case OP_SET_UPVALUE:
+  case OP_CLOSE_UPVALUE:
+  case OP_SET_GLOBAL:
+  case OP_DEFINE_GLOBAL:
+  case OP_SET_GLOBAL_SLOT:
+  case OP_DEFINE_GLOBAL_SLOT:
+  case OP_ARRAY_PUSH:
+  case OP_MAP_SET:
+  case OP_RETURN_VALUE:
+    return pop(stack, 1);
+  case OP_POPN:
+    return pop(stack, instruction->operand);
+  case OP_INDEX_SET:
+    return pop(stack, 3);
+  case OP_INDEX_GET:
+    return pop(stack, 2) && push(stack, TYPE_UNKNOWN);
+  case OP_MAP_GET:
+  case OP_CLOSURE:
+    return pop(stack, 1) && push(stack, TYPE_UNKNOWN);
+  case OP_ARRAY:
+    return pop(stack, argcount_operand(ir, index, 0)) &&
+           push(stack, TYPE_UNKNOWN);
+  // The callee is on top of its arguments
+  case OP_CALL:
+    return pop(stack, argcount_operand(ir, index, 0) + 1) &&
+           push(stack, TYPE_UNKNOWN);
+
+  case OP_JMP:
+  case OP_JMP_FALSE:
+  case OP_BEGIN:
+  case OP_RETURN_VOID:
+  case OP_HALT:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Meets the stack flowing into the block starting at target with what it
+// already knew, the block is revisited when that changed anything
+static bool flow(ch_inference *inference, const ch_stack_types *stack,
+                 uint32_t target) {
+  ch_ir *ir = inference->ir;
+  if (target >= ir->count)
+    return true;
+
+  uint32_t block = inference->block_of[target];
+  if (block == CH_IR_NO_INSTRUCTION)
+    return false;
+
+  ch_stack_types *entry = &inference->entries[block];
+  bool changed = false;
+  if (entry->depth == UNVISITED) {
+    entry->depth = stack->depth;
+    memcpy(entry->types, stack->types, stack->depth);
+    changed = true;
+  } else if (entry->depth != stack->depth) {
+    return false;
+  } else {
+    for (uint32_t i = 0; i < stack->depth; i++) {
+      if (entry->types[i] != stack->types[i] &&
+          entry->types[i] != TYPE_UNKNOWN) {
+        entry->types[i] = TYPE_UNKNOWN;
+        changed = true;
+      }
+    }
+  }
+
+  if (changed && !inference->queued[block]) {
+    inference->queued[block] = true;
+    inference->pending[inference->pending_count++] = block;
+  }
+  return true;
+}
+
+static bool infer_block(ch_inference *inference, uint32_t block, bool rewrite) {
+  ch_ir *ir = inference->ir;
+  ch_ir_block bounds = ir->blocks[block];
+  ch_stack_types stack = inference->entries[block];
+
+  uint32_t last = bounds.start;
+  for (uint32_t i = bounds.start; i < bounds.end; i = ch_ir_next(ir, i)) {
+    if (!step(inference, &stack, i, rewrite))
+      return false;
+    last = i;
+  }
+
+  if (rewrite)
+    return true;
+
+  ch_op op = ir->instructions[last].op;
+  if (ch_ir_is_jump(op) &&
+      !flow(inference, &stack, ch_ir_landing(ir, ir->instructions[last].target)))
+    return false;
+  if (!ch_ir_ends_flow(op) && !flow(inference, &stack, bounds.end))
+    return false;
+  return true;
+}
+
+// Runs to a fixed point before rewriting anything, a type only ever goes
+// back to unknown so this ends
+static void infer(ch_inference *inference, ch_argcount argcount) {
+  ch_ir *ir = inference->ir;
+  ch_stack_types arguments = {.depth = argcount, .types = {TYPE_UNKNOWN}};
+  if (!flow(inference, &arguments, ir->blocks[0].start))
+    return;
+
+  while (inference->pending_count > 0) {
+    uint32_t block = inference->pending[--inference->pending_count];
+    inference->queued[block] = false;
+    if (!infer_block(inference, block, false))
+      return;
+  }
+
+  for (uint32_t block = 0; block < ir->block_count; block++) {
+    if (inference->entries[block].depth != UNVISITED)
+      infer_block(inference, block, true);
+  }
+}
+
+void ch_infer_types(ch_ir *ir, ch_argcount argcount) {
+  ch_ir_split_blocks(ir);
+  if (ir->block_count == 0)
+    return;
+
+  ch_inference inference = {
+      .ir = ir,
+      .entries = ch_memory_alloc(ir->memory,
+                                 ir->block_count * sizeof(ch_stack_types)),
+      .block_of = ch_memory_alloc(ir->memory, ir->count * sizeof(uint32_t)),
+      .pending = ch_memory_alloc(ir->memory, ir->block_count * sizeof(uint32_t)),
+      .pending_count = 0,
+      .queued = ch_memory_alloc(ir->memory, ir->block_count * sizeof(bool)),
+  };
+  find_captured(&inference);
+
+  for (uint32_t i = 0; i < ir->count; i++) {
+    inference.block_of[i] = CH_IR_NO_INSTRUCTION;
+  }
+  for (uint32_t block = 0; block < ir->block_count; block++) {
+    inference.entries[block].depth = UNVISITED;
+    inference.queued[block] = false;
+    inference.block_of[ir->blocks[block].start] = block;
+  }
+
+  infer(&inference, argcount);
+
+  ch_memory_release(ir->memory, inference.queued,
+                    ir->block_count * sizeof(bool));
+  ch_memory_release(ir->memory, inference.pending,
+                    ir->block_count * sizeof(uint32_t));
+  ch_memory_release(ir->memory, inference.block_of,
+                    ir->count * sizeof(uint32_t));
+  ch_memory_release(ir->memory, inference.entries,
+                    ir->block_count * sizeof(ch_stack_types));
+}
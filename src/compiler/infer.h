@@ -0,0 +1,11 @@
+#pragma once
+#include "ir.h"
+
+/*
+  Follows the type of every value on the stack through the control flow of
+  the scope, starting from its arguments. Arithmetic whose operands are known
+  to be numbers, and additions of two texts, are rewritten to the typed ops
+  that skip the VM's checks. Locals captured by a closure can change behind
+  any call and are never known.
+*/
+void ch_infer_types(ch_ir *ir, ch_argcount argcount);
@@ -0,0 +1,248 @@
+#include "ir.h"
+#include <string.h>
+#include <vm/bytecode.h>
+
+bool ch_ir_is_jump(ch_op op) { return op == OP_JMP || op == OP_JMP_FALSE; }
+
+bool ch_ir_ends_flow(ch_op op) {
+  return op == OP_JMP || op == OP_RETURN_VALUE || op == OP_RETURN_VOID ||
+         op == OP_HALT;
+}
+
+// Operands written back for rewritten instructions
+static size_t rewritten_operand_size(ch_op op) {
+  switch (op) {
+  case OP_POPN:
+  case OP_NUMBER:
+  case OP_STRING:
+  case OP_LOAD_LOCAL:
+  case OP_SET_LOCAL:
+    return sizeof(ch_dataptr);
+  default:
+    return 0;
+  }
+}
+
+static bool decode(ch_ir *ir, uint32_t *indexes) {
+  const uint8_t *start = ir->bytecode;
+  const uint8_t *end = start + ir->size;
+
+  size_t offset = 0;
+  for (uint32_t i = 0; i < ir->count; i++) {
+    size_t size;
+    ch_bytecode_instruction_size(&start[offset], end, &size);
+    ch_ir_instruction *instruction = &ir->instructions[i];
+    *instruction = (ch_ir_instruction){
+        .op = start[offset],
+        .operand = 0,
+        .target = CH_IR_NO_INSTRUCTION,
+        .offset = offset,
+        .size = size,
+        .rewritten = false,
+        .kept = true,
+        .is_target = false,
+    };
+
+    if (ch_ir_is_jump(instruction->op)) {
+      // Jumps are relative to the end of the instruction
+      int64_t target = (int64_t)offset + size + READ_JMPPTR(&start[offset + 1]);
+      if (target < 0 || (size_t)target > ir->size ||
+          indexes[target] == CH_IR_NO_INSTRUCTION)
+        return false;
+
+      instruction->target = indexes[target];
+    } else if (size == 1 + sizeof(ch_dataptr)) {
+      instruction->operand = READ_U32(&start[offset + 1]);
+    }
+
+    offset += size;
+  }
+
+  return true;
+}
+
+bool ch_ir_build(ch_ir *ir, const ch_blob *bytecode) {
+  *ir = (ch_ir){
+      .bytecode = bytecode->start,
+      .size = CH_BLOB_CONTENT_SIZE(bytecode),
+      .instructions = NULL,
+      .blocks = NULL,
+      .memory = bytecode->memory,
+  };
+  if (ir->size == 0)
+    return false;
+
+  // Byte offset -> instruction starting there, jumps may only land on those
+  size_t indexes_size = (ir->size + 1) * sizeof(uint32_t);
+  uint32_t *indexes = ch_memory_alloc(ir->memory, indexes_size);
+  for (size_t i = 0; i < ir->size; i++) {
+    indexes[i] = CH_IR_NO_INSTRUCTION;
+  }
+
+  const uint8_t *end = ir->bytecode + ir->size;
+  const uint8_t *instruction = ir->bytecode;
+  while (instruction < end) {
+    size_t size;
+    if (!ch_bytecode_instruction_size(instruction, end, &size)) {
+      ch_memory_release(ir->memory, indexes, indexes_size);
+      return false;
+    }
+
+    indexes[instruction - ir->bytecode] = ir->count++;
+    instruction += size;
+  }
+  indexes[ir->size] = ir->count;
+
+  ir->instructions =
+      ch_memory_alloc(ir->memory, ir->count * sizeof(ch_ir_instruction));
+  bool decoded = decode(ir, indexes);
+  ch_memory_release(ir->memory, indexes, indexes_size);
+
+  if (!decoded) {
+    ch_ir_free(ir);
+    return false;
+  }
+
+  ch_ir_mark_targets(ir);
+  return true;
+}
+
+void ch_ir_free(ch_ir *ir) {
+  ch_memory_release(ir->memory, ir->instructions,
+                    ir->count * sizeof(ch_ir_instruction));
+  if (ir->blocks != NULL) {
+    ch_memory_release(ir->memory, ir->blocks, ir->count * sizeof(ch_ir_block));
+  }
+
+  ir->instructions = NULL;
+  ir->blocks = NULL;
+  ir->count = 0;
+  ir->block_count = 0;
+}
+
+void ch_ir_mark_targets(ch_ir *ir) {
+  ch_ir_instruction *instructions = ir->instructions;
+  for (uint32_t i = 0; i < ir->count; i++) {
+    instructions[i].is_target = false;
+  }
+
+  for (uint32_t i = 0; i < ir->count; i++) {
+    if (instructions[i].kept && ch_ir_is_jump(instructions[i].op) &&
+        instructions[i].target < ir->count) {
+      instructions[ch_ir_landing(ir, instructions[i].target)].is_target = true;
+    }
+  }
+}
+
+void ch_ir_split_blocks(ch_ir *ir) {
+  ch_ir_mark_targets(ir);
+  if (ir->blocks != NULL) {
+    ch_memory_release(ir->memory, ir->blocks, ir->count * sizeof(ch_ir_block));
+  }
+
+  // Blocks start at the first instruction, at targets and after jumps or
+  // returns, there are never more of them than instructions
+  ir->blocks = ch_memory_alloc(ir->memory, ir->count * sizeof(ch_ir_block));
+  ir->block_count = 0;
+
+  uint32_t start = ch_ir_landing(ir, 0);
+  while (start < ir->count) {
+    uint32_t end = start;
+    do {
+      ch_op op = ir->instructions[end].op;
+      end = ch_ir_next(ir, end);
+      if (ch_ir_is_jump(op) || ch_ir_ends_flow(op))
+        break;
+    } while (end < ir->count && !ir->instructions[end].is_target);
+
+    ir->blocks[ir->block_count++] = (ch_ir_block){.start = start, .end = end};
+    start = end;
+  }
+}
+
+uint32_t ch_ir_next(const ch_ir *ir, uint32_t index) {
+  do {
+    index++;
+  } while (index < ir->count && !ir->instructions[index].kept);
+  return index;
+}
+
+uint32_t ch_ir_previous(const ch_ir *ir, uint32_t index) {
+  while (index > 0) {
+    index--;
+    if (ir->instructions[index].kept)
+      return index;
+  }
+  return CH_IR_NO_INSTRUCTION;
+}
+
+uint32_t ch_ir_landing(const ch_ir *ir, uint32_t index) {
+  while (index < ir->count && !ir->instructions[index].kept) {
+    index++;
+  }
+  return index;
+}
+
+void ch_ir_rewrite(ch_ir *ir, uint32_t index, ch_op op, uint32_t operand) {
+  ir->instructions[index].op = op;
+  ir->instructions[index].operand = operand;
+  ir->instructions[index].rewritten = true;
+}
+
+static size_t encoded_size(const ch_ir_instruction *instruction) {
+  if (instruction->rewritten)
+    return 1 + rewritten_operand_size(instruction->op);
+  return instruction->size;
+}
+
+static void encode(const ch_ir *ir, const ch_ir_instruction *instruction,
+                   size_t size, uint8_t *out) {
+  if (instruction->rewritten) {
+    out[0] = instruction->op;
+    if (rewritten_operand_size(instruction->op) != 0)
+      ch_uint32_to_le_array(instruction->operand, out + 1);
+    return;
+  }
+
+  memcpy(out, &ir->bytecode[instruction->offset], instruction->size);
+  if (ch_ir_is_jump(instruction->op)) {
+    size_t target_offset =
+        instruction->target < ir->count
+            ? ir->instructions[instruction->target].landing_offset
+            : size;
+    ch_jmpptr relative =
+        (ch_jmpptr)((int64_t)target_offset -
+                    (int64_t)(instruction->new_offset + instruction->size));
+    ch_uint32_to_le_array((uint32_t)relative, out + 1);
+  }
+}
+
+void ch_ir_lower(ch_ir *ir, ch_blob *bytecode) {
+  ch_ir_instruction *instructions = ir->instructions;
+  size_t size = 0;
+  for (uint32_t i = 0; i < ir->count; i++) {
+    if (instructions[i].kept) {
+      instructions[i].new_offset = size;
+      size += encoded_size(&instructions[i]);
+    }
+  }
+
+  size_t landing_offset = size;
+  for (uint32_t i = ir->count; i-- > 0;) {
+    if (instructions[i].kept)
+      landing_offset = instructions[i].new_offset;
+    instructions[i].landing_offset = landing_offset;
+  }
+
+  // Written aside first, the instructions are copied from the bytecode
+  uint8_t *output = ch_memory_alloc(ir->memory, size);
+  for (uint32_t i = 0; i < ir->count; i++) {
+    if (instructions[i].kept)
+      encode(ir, &instructions[i], size, &output[instructions[i].new_offset]);
+  }
+
+  bytecode->current = bytecode->start;
+  ch_emit_write(bytecode, output, size);
+  ch_memory_release(ir->memory, output, size);
+  ch_ir_free(ir);
+}
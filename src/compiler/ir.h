@@ -0,0 +1,83 @@
+#pragma once
+#include "emit.h"
+
+#define CH_IR_NO_INSTRUCTION UINT32_MAX
+
+/*
+  A scope's bytecode decoded into instructions and split into basic blocks,
+  so that passes can look further than the instruction being emitted. Passes
+  rewrite instructions in place and drop them by clearing kept, lowering lays
+  the kept ones out again and recomputes the jump offsets.
+*/
+typedef struct {
+  ch_op op;
+  // Slot, count or data pointer of the instructions that carry one in 4 bytes
+  uint32_t operand;
+  // Instruction a jump lands on, the instruction count stands for the end of
+  // the bytecode
+  uint32_t target;
+
+  // Where the instruction was decoded from. Rewritten instructions are
+  // encoded from their op and operand instead.
+  size_t offset;
+  size_t size;
+  bool rewritten;
+
+  bool kept;
+  // Whether a kept jump lands on it, see ch_ir_mark_targets
+  bool is_target;
+
+  size_t new_offset;
+  // New offset of the first instruction kept from this one on
+  size_t landing_offset;
+} ch_ir_instruction;
+
+typedef struct {
+  // Instructions [start, end), start is kept
+  uint32_t start;
+  uint32_t end;
+} ch_ir_block;
+
+typedef struct {
+  const uint8_t *bytecode;
+  size_t size;
+
+  ch_ir_instruction *instructions;
+  uint32_t count;
+
+  ch_ir_block *blocks;
+  uint32_t block_count;
+
+  ch_memory *memory;
+} ch_ir;
+
+// Returns false, building nothing, if the bytecode doesn't decode or if a jump
+// doesn't land on an instruction
+bool ch_ir_build(ch_ir *ir, const ch_blob *bytecode);
+
+// Replaces the bytecode by the kept instructions and frees the IR
+void ch_ir_lower(ch_ir *ir, ch_blob *bytecode);
+
+void ch_ir_free(ch_ir *ir);
+
+bool ch_ir_is_jump(ch_op op);
+
+// Whether execution never continues with the next instruction
+bool ch_ir_ends_flow(ch_op op);
+
+void ch_ir_mark_targets(ch_ir *ir);
+
+// Splits the kept instructions into basic blocks, marking targets first
+void ch_ir_split_blocks(ch_ir *ir);
+
+// Kept instruction after index, or the instruction count
+uint32_t ch_ir_next(const ch_ir *ir, uint32_t index);
+
+// Kept instruction before index, or CH_IR_NO_INSTRUCTION
+uint32_t ch_ir_previous(const ch_ir *ir, uint32_t index);
+
+// First instruction kept at index or after it, where a jump to index lands
+uint32_t ch_ir_landing(const ch_ir *ir, uint32_t index);
+
+// Only ops without operands or with a 4 bytes one can be rewritten
+void ch_ir_rewrite(ch_ir *ir, uint32_t index, ch_op op, uint32_t operand);
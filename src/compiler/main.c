@@ -26,13 +26,13 @@ char *load_program() {
 }
 
 void printvalue(ch_primitive return_value) {
-  switch(return_value.type) {
+  switch(PRIMITIVE_TYPE(return_value)) {
     case PRIMITIVE_BOOLEAN: {
-      printf("BOOLEAN: %d", return_value.boolean_value);
+      printf("BOOLEAN: %d", AS_BOOLEAN(return_value));
       break;
     }
     case PRIMITIVE_NUMBER: {
-      printf("NUMBER: %f", return_value.number_value);
+      printf("NUMBER: %f", AS_NUMBER(return_value));
       break;
     }
     case PRIMITIVE_NULL: {
@@ -40,7 +40,7 @@ void printvalue(ch_primitive return_value) {
       break;
     }
     case PRIMITIVE_CHAR: {
-      printf("CHAR: %c", return_value.char_value);
+      printf("CHAR: %c", AS_CHAR(return_value));
       break;
     }
     case PRIMITIVE_OBJECT: {
@@ -0,0 +1,185 @@
+#include "peephole.h"
+
+// What a jump knows about the value on top of the stack when it's executed
+typedef enum {
+  CONDITION_UNKNOWN,
+  CONDITION_FALSY,
+  CONDITION_TRUTHY,
+} ch_condition;
+
+static ch_condition jump_condition(ch_ir *ir, uint32_t index) {
+  ch_ir_instruction *instructions = ir->instructions;
+  if (instructions[index].op == OP_JMP_FALSE)
+    return CONDITION_FALSY;
+
+  // Only reached when the OP_JMP_FALSE before it didn't jump, like the jump
+  // that skips the rest of an `||`
+  uint32_t previous = ch_ir_previous(ir, index);
+  if (previous != CH_IR_NO_INSTRUCTION &&
+      instructions[previous].op == OP_JMP_FALSE &&
+      !instructions[index].is_target)
+    return CONDITION_TRUTHY;
+
+  return CONDITION_UNKNOWN;
+}
+
+/*
+  Jumps landing on other jumps go to where those would end up. OP_JMP_FALSE
+  doesn't pop, so a jump that knows whether the top of the stack is falsy
+  also knows what an OP_JMP_FALSE it lands on will do. Expects is_target to
+  describe the instructions as they were before threading.
+*/
+static void thread_jumps(ch_ir *ir) {
+  ch_ir_instruction *instructions = ir->instructions;
+  for (uint32_t i = 0; i < ir->count; i++) {
+    if (!instructions[i].kept || !ch_ir_is_jump(instructions[i].op))
+      continue;
+
+    ch_condition condition = jump_condition(ir, i);
+    uint32_t target = ch_ir_landing(ir, instructions[i].target);
+
+    // Bounded since jumps can form cycles
+    for (uint32_t hops = 0; hops < ir->count && target < ir->count; hops++) {
+      ch_ir_instruction *landing = &instructions[target];
+      if (landing->op == OP_JMP ||
+          (landing->op == OP_JMP_FALSE && condition == CONDITION_FALSY)) {
+        target = ch_ir_landing(ir, landing->target);
+      } else if (landing->op == OP_JMP_FALSE && condition == CONDITION_TRUTHY) {
+        target = ch_ir_next(ir, target);
+      } else {
+        break;
+      }
+    }
+
+    instructions[i].target = target;
+  }
+}
+
+static void reach(ch_ir *ir, uint32_t *pending, uint32_t *pending_count,
+                  uint32_t index) {
+  if (index < ir->count && !ir->instructions[index].kept) {
+    ir->instructions[index].kept = true;
+    pending[(*pending_count)++] = index;
+  }
+}
+
+// Keeps only the instructions that can be reached from the first one
+static void drop_unreachable(ch_ir *ir) {
+  ch_ir_instruction *instructions = ir->instructions;
+  uint32_t entry = ch_ir_landing(ir, 0);
+
+  // Successors are followed through the instructions kept so far
+  bool *was_kept = ch_memory_alloc(ir->memory, ir->count * sizeof(bool));
+  for (uint32_t i = 0; i < ir->count; i++) {
+    was_kept[i] = instructions[i].kept;
+    instructions[i].kept = false;
+  }
+
+  // Each instruction is only pending once
+  size_t pending_size = ir->count * sizeof(uint32_t);
+  uint32_t *pending = ch_memory_alloc(ir->memory, pending_size);
+  uint32_t pending_count = 0;
+
+  reach(ir, pending, &pending_count, entry);
+  while (pending_count > 0) {
+    uint32_t index = pending[--pending_count];
+    ch_op op = instructions[index].op;
+
+    uint32_t next = index + 1;
+    while (next < ir->count && !was_kept[next]) {
+      next++;
+    }
+
+    if (ch_ir_is_jump(op)) {
+      uint32_t target = instructions[index].target;
+      while (target < ir->count && !was_kept[target]) {
+        target++;
+      }
+      reach(ir, pending, &pending_count, target);
+    }
+    if (!ch_ir_ends_flow(op))
+      reach(ir, pending, &pending_count, next);
+  }
+
+  ch_memory_release(ir->memory, pending, pending_size);
+  ch_memory_release(ir->memory, was_kept, ir->count * sizeof(bool));
+}
+
+static bool is_step(ch_op op) { return op == OP_ADDONE || op == OP_SUBONE; }
+
+static bool is_store(ch_op op) {
+  return op == OP_SET_LOCAL || op == OP_SET_UPVALUE || op == OP_SET_GLOBAL ||
+         op == OP_SET_GLOBAL_SLOT;
+}
+
+// `x++` as a statement copies x to return the old value, which is popped
+// right away: TOP, ADDONE, SET_*, POP only needs ADDONE, SET_*
+static void drop_postfix_copies(ch_ir *ir) {
+  ch_ir_instruction *instructions = ir->instructions;
+  for (uint32_t i = 0; i < ir->count; i++) {
+    if (!instructions[i].kept || instructions[i].op != OP_TOP)
+      continue;
+
+    uint32_t step = ch_ir_next(ir, i);
+    uint32_t store = ch_ir_next(ir, step);
+    uint32_t pop = ch_ir_next(ir, store);
+    if (pop >= ir->count)
+      continue;
+
+    // Jumping to the copy itself is fine, it then lands on the step
+    if (is_step(instructions[step].op) && !instructions[step].is_target &&
+        is_store(instructions[store].op) && !instructions[store].is_target &&
+        instructions[pop].op == OP_POP && !instructions[pop].is_target) {
+      instructions[i].kept = false;
+      instructions[pop].kept = false;
+    }
+  }
+}
+
+// OP_JMP_FALSE doesn't pop either, so neither jump does anything when it
+// lands on the instruction right after it
+static void drop_jumps_to_next(ch_ir *ir) {
+  ch_ir_instruction *instructions = ir->instructions;
+  // Backwards, so that dropping a jump shows an earlier one it's the next
+  for (uint32_t i = ir->count; i-- > 0;) {
+    if (instructions[i].kept && ch_ir_is_jump(instructions[i].op) &&
+        ch_ir_landing(ir, instructions[i].target) == ch_ir_next(ir, i)) {
+      instructions[i].kept = false;
+    }
+  }
+}
+
+static uint32_t popped(const ch_ir_instruction *instruction) {
+  return instruction->op == OP_POPN ? instruction->operand : 1;
+}
+
+static void merge_pops(ch_ir *ir) {
+  ch_ir_instruction *instructions = ir->instructions;
+  for (uint32_t i = ch_ir_landing(ir, 0); i < ir->count; i = ch_ir_next(ir, i)) {
+    if (instructions[i].op != OP_POP && instructions[i].op != OP_POPN)
+      continue;
+
+    uint32_t count = popped(&instructions[i]);
+    uint32_t next = ch_ir_next(ir, i);
+    while (next < ir->count && !instructions[next].is_target &&
+           (instructions[next].op == OP_POP || instructions[next].op == OP_POPN)) {
+      count += popped(&instructions[next]);
+      instructions[next].kept = false;
+      next = ch_ir_next(ir, next);
+    }
+
+    if (count > 1)
+      ch_ir_rewrite(ir, i, OP_POPN, count);
+  }
+}
+
+void ch_peephole(ch_ir *ir) {
+  ch_ir_mark_targets(ir);
+  thread_jumps(ir);
+  drop_unreachable(ir);
+
+  ch_ir_mark_targets(ir);
+  drop_postfix_copies(ir);
+  drop_jumps_to_next(ir);
+  merge_pops(ir);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "ir.h"
+
+/*
+  Cleans up after the single pass compiler: jumps landing on other jumps go
+  straight to their final target, code that can't be reached is dropped,
+  statement-level `x++` no longer copies x just to pop it, and runs of OP_POP
+  become a single OP_POPN.
+*/
+void ch_peephole(ch_ir *ir);
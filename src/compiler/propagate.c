@@ -0,0 +1,248 @@
+#include "propagate.h"
+#include <string.h>
+
+// Locals are addressed by a byte
+#define MAX_SLOTS (UINT8_MAX + 1)
+
+typedef enum {
+  VALUE_UNKNOWN,
+  VALUE_CONSTANT,
+  VALUE_COPY,
+} ch_value_kind;
+
+typedef struct {
+  ch_value_kind kind;
+  // OP_NUMBER or OP_STRING for constants
+  ch_op op;
+  // Data pointer of a constant, slot of a copy
+  uint32_t operand;
+  // Last OP_SET_LOCAL of the slot that nothing read since
+  uint32_t store;
+} ch_slot_value;
+
+typedef struct {
+  ch_ir *ir;
+  ch_compilation *comp;
+  ch_slot_value slots[MAX_SLOTS];
+
+  // Kept instructions of the block up to the current one, folding looks
+  // back at the constants they pushed
+  uint32_t *history;
+  uint32_t history_count;
+} ch_propagation;
+
+static void forget(ch_propagation *propagation) {
+  for (uint32_t slot = 0; slot < MAX_SLOTS; slot++) {
+    propagation->slots[slot] = (ch_slot_value){
+        .kind = VALUE_UNKNOWN,
+        .store = CH_IR_NO_INSTRUCTION,
+    };
+  }
+}
+
+static uint32_t last_pushed(ch_propagation *propagation, uint32_t back) {
+  if (propagation->history_count < back)
+    return CH_IR_NO_INSTRUCTION;
+  return propagation->history[propagation->history_count - back];
+}
+
+static void load(ch_propagation *propagation, uint32_t index) {
+  uint32_t slot = propagation->ir->instructions[index].operand;
+  if (slot >= MAX_SLOTS)
+    return;
+
+  ch_slot_value *value = &propagation->slots[slot];
+  value->store = CH_IR_NO_INSTRUCTION;
+  if (value->kind == VALUE_CONSTANT) {
+    ch_ir_rewrite(propagation->ir, index, value->op, value->operand);
+  } else if (value->kind == VALUE_COPY) {
+    ch_ir_rewrite(propagation->ir, index, OP_LOAD_LOCAL, value->operand);
+    propagation->slots[value->operand].store = CH_IR_NO_INSTRUCTION;
+  }
+}
+
+static void store(ch_propagation *propagation, uint32_t index) {
+  ch_ir *ir = propagation->ir;
+  uint32_t slot = ir->instructions[index].operand;
+  if (slot >= MAX_SLOTS)
+    return;
+
+  // The value stored before was overwritten without being read
+  ch_slot_value *value = &propagation->slots[slot];
+  if (value->store != CH_IR_NO_INSTRUCTION)
+    ch_ir_rewrite(ir, value->store, OP_POP, 0);
+
+  for (uint32_t other = 0; other < MAX_SLOTS; other++) {
+    if (propagation->slots[other].kind == VALUE_COPY &&
+        propagation->slots[other].operand == slot)
+      propagation->slots[other].kind = VALUE_UNKNOWN;
+  }
+
+  // The stored value was pushed right before
+  *value = (ch_slot_value){.kind = VALUE_UNKNOWN, .store = index};
+  uint32_t pushed = last_pushed(propagation, 1);
+  if (pushed == CH_IR_NO_INSTRUCTION)
+    return;
+
+  ch_ir_instruction *source = &ir->instructions[pushed];
+  if (source->op == OP_NUMBER || source->op == OP_STRING) {
+    value->kind = VALUE_CONSTANT;
+    value->op = source->op;
+    value->operand = source->operand;
+  } else if (source->op == OP_LOAD_LOCAL && source->operand != slot &&
+             source->operand < MAX_SLOTS) {
+    value->kind = VALUE_COPY;
+    value->operand = source->operand;
+  }
+}
+
+static bool number_pushed(ch_propagation *propagation, uint32_t index,
+                          double *out_value) {
+  if (index == CH_IR_NO_INSTRUCTION ||
+      propagation->ir->instructions[index].op != OP_NUMBER)
+    return false;
+
+  ch_dataptr value_ptr = propagation->ir->instructions[index].operand;
+  memcpy(out_value, &GET_DATA(&propagation->comp->emit)->start[value_ptr],
+         sizeof(double));
+  return true;
+}
+
+// Returns whether the operator and its operands were replaced by the result
+static bool fold(ch_propagation *propagation, uint32_t index) {
+  ch_ir *ir = propagation->ir;
+  ch_op op = ir->instructions[index].op;
+  uint32_t right = last_pushed(propagation, 1);
+  double right_value;
+  if (!number_pushed(propagation, right, &right_value))
+    return false;
+
+  double result;
+  switch (op) {
+  case OP_ADDONE:
+    result = right_value + 1;
+    break;
+  case OP_SUBONE:
+    result = right_value - 1;
+    break;
+  case OP_NEGATE:
+    result = -right_value;
+    break;
+  default: {
+    uint32_t left = last_pushed(propagation, 2);
+    double left_value;
+    if (!number_pushed(propagation, left, &left_value))
+      return false;
+
+    if (op == OP_ADD)
+      result = left_value + right_value;
+    else if (op == OP_SUB)
+      result = left_value - right_value;
+    else if (op == OP_MUL)
+      result = left_value * right_value;
+    else
+      result = left_value / right_value;
+
+    // The left operand holds the result
+    ir->instructions[right].kept = false;
+    propagation->history_count--;
+    right = left;
+    break;
+  }
+  }
+
+  ch_ir_rewrite(ir, right, OP_NUMBER, ch_compiler_number(propagation->comp, result));
+  ir->instructions[index].kept = false;
+  return true;
+}
+
+static void propagate_block(ch_propagation *propagation, ch_ir_block block) {
+  ch_ir *ir = propagation->ir;
+  forget(propagation);
+  propagation->history_count = 0;
+
+  for (uint32_t i = block.start; i < block.end; i = ch_ir_next(ir, i)) {
+    switch (ir->instructions[i].op) {
+    case OP_LOAD_LOCAL:
+      load(propagation, i);
+      break;
+    case OP_SET_LOCAL:
+      store(propagation, i);
+      break;
+    case OP_ADD:
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_ADDONE:
+    case OP_SUBONE:
+    case OP_NEGATE:
+      if (fold(propagation, i))
+        continue;
+      break;
+    // Slots can be redefined once popped, and calls can reach captured ones
+    case OP_POP:
+    case OP_POPN:
+    case OP_CLOSE_UPVALUE:
+    case OP_CALL:
+      forget(propagation);
+      break;
+    default:
+      break;
+    }
+
+    propagation->history[propagation->history_count++] = i;
+  }
+}
+
+static bool is_pure_push(ch_op op) {
+  switch (op) {
+  case OP_NUMBER:
+  case OP_STRING:
+  case OP_CHAR:
+  case OP_TRUE:
+  case OP_FALSE:
+  case OP_NULL:
+  case OP_TOP:
+  case OP_LOAD_LOCAL:
+  case OP_LOAD_UPVALUE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Values popped right after being pushed, like the ones of dropped stores
+static void drop_unused_pushes(ch_propagation *propagation, ch_ir_block block) {
+  ch_ir *ir = propagation->ir;
+  propagation->history_count = 0;
+
+  for (uint32_t i = block.start; i < block.end; i = ch_ir_next(ir, i)) {
+    uint32_t pushed = last_pushed(propagation, 1);
+    if (ir->instructions[i].op == OP_POP && pushed != CH_IR_NO_INSTRUCTION &&
+        is_pure_push(ir->instructions[pushed].op)) {
+      ir->instructions[pushed].kept = false;
+      ir->instructions[i].kept = false;
+      propagation->history_count--;
+      continue;
+    }
+
+    propagation->history[propagation->history_count++] = i;
+  }
+}
+
+void ch_propagate(ch_ir *ir, ch_compilation *comp) {
+  ch_propagation propagation = {
+      .ir = ir,
+      .comp = comp,
+      .history = ch_memory_alloc(ir->memory, ir->count * sizeof(uint32_t)),
+  };
+
+  ch_ir_split_blocks(ir);
+  for (uint32_t i = 0; i < ir->block_count; i++) {
+    propagate_block(&propagation, ir->blocks[i]);
+    drop_unused_pushes(&propagation, ir->blocks[i]);
+  }
+
+  ch_memory_release(ir->memory, propagation.history,
+                    ir->count * sizeof(uint32_t));
+}
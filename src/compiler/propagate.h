@@ -0,0 +1,12 @@
+#pragma once
+#include "compiler.h"
+#include "ir.h"
+
+/*
+  Works on each basic block of the IR on its own: loads of locals known to
+  hold a constant or a copy of another local are replaced by the constant or
+  by a load of that local, arithmetic on numbers this exposes is folded, and
+  stores overwritten before anything reads them are dropped with the values
+  they stored.
+*/
+void ch_propagate(ch_ir *ir, ch_compilation *comp);
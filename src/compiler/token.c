@@ -94,6 +94,18 @@ bool ch_token_next(ch_token_state *state, ch_token *next) {
     case '}':
       *next = get_token(start, state, TK_CCLOSE);
       return true;
+    case '[':
+      *next = get_token(start, state, TK_BOPEN);
+      return true;
+    case ']':
+      *next = get_token(start, state, TK_BCLOSE);
+      return true;
+    case '.':
+      *next = get_token(start, state, TK_DOT);
+      return true;
+    case ':':
+      *next = get_token(start, state, TK_COLON);
+      return true;
     case '\0':
       *next = get_token(start, state, TK_EOF);
       return true;
@@ -31,6 +31,13 @@ typedef enum {
   TK_COPEN,
   TK_CCLOSE,
 
+  // Square bracket
+  TK_BOPEN,
+  TK_BCLOSE,
+
+  TK_DOT,
+  TK_COLON,
+
   TK_ID,
   TK_STRING,
   TK_CHAR,
@@ -0,0 +1,82 @@
+#include "arena.h"
+
+#define ALIGNMENT 16
+#define ALIGN(size) (((size) + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1))
+
+void ch_arena_create(ch_arena *out_arena, size_t chunk_size,
+                     ch_memory *memory) {
+  out_arena->chunks = NULL;
+  out_arena->current = NULL;
+  out_arena->used = 0;
+  out_arena->chunk_size = chunk_size;
+  out_arena->bytes_allocated = 0;
+  out_arena->memory = memory;
+}
+
+void ch_arena_free(ch_arena *arena) {
+  ch_arena_chunk *chunk = arena->chunks;
+  while (chunk != NULL) {
+    ch_arena_chunk *next = chunk->next;
+    ch_memory_release(arena->memory, chunk,
+                      sizeof(ch_arena_chunk) + chunk->size);
+    chunk = next;
+  }
+
+  ch_arena_create(arena, arena->chunk_size, arena->memory);
+}
+
+static ch_arena_chunk *new_chunk(ch_arena *arena, size_t size) {
+  ch_arena_chunk *chunk =
+      ch_memory_alloc(arena->memory, sizeof(ch_arena_chunk) + size);
+  if (chunk == NULL)
+    return NULL;
+
+  chunk->next = NULL;
+  chunk->size = size;
+  return chunk;
+}
+
+// Moves to the next chunk, which is inserted if it is missing or too small.
+// Returns false when no chunk could be allocated.
+static bool next_chunk(ch_arena *arena, size_t size) {
+  ch_arena_chunk *current = arena->current;
+  ch_arena_chunk *next = current != NULL ? current->next : arena->chunks;
+
+  if (next == NULL || next->size < size) {
+    ch_arena_chunk *chunk =
+        new_chunk(arena, size > arena->chunk_size ? size : arena->chunk_size);
+    if (chunk == NULL)
+      return false;
+
+    chunk->next = next;
+    if (current != NULL) {
+      current->next = chunk;
+    } else {
+      arena->chunks = chunk;
+    }
+    next = chunk;
+  }
+
+  arena->current = next;
+  arena->used = 0;
+  return true;
+}
+
+void *ch_arena_allocate(ch_arena *arena, size_t size) {
+  size = ALIGN(size);
+  if (arena->current == NULL || arena->used + size > arena->current->size) {
+    if (!next_chunk(arena, size))
+      return NULL;
+  }
+
+  void *allocation = &arena->current->data[arena->used];
+  arena->used += size;
+  arena->bytes_allocated += size;
+  return allocation;
+}
+
+void ch_arena_reset(ch_arena *arena) {
+  arena->current = arena->chunks;
+  arena->used = 0;
+  arena->bytes_allocated = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include "memory.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CH_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct ch_arena_chunk {
+  struct ch_arena_chunk *next;
+  size_t size;
+  // Aligns data for any object stored in it
+  _Alignas(16) unsigned char data[];
+} ch_arena_chunk;
+
+/*
+  Bump allocator over a list of chunks. Memory is never freed one allocation
+  at a time, resetting the arena hands every chunk out again from the start.
+  Chunks are only returned to the system by ch_arena_free.
+*/
+typedef struct {
+  ch_arena_chunk *chunks;
+  ch_arena_chunk *current;
+  // Bytes handed out from the current chunk
+  size_t used;
+  size_t chunk_size;
+  // Bytes handed out since the last reset, padding included
+  size_t bytes_allocated;
+  ch_memory *memory;
+} ch_arena;
+
+void ch_arena_create(ch_arena *out_arena, size_t chunk_size,
+                     ch_memory *memory);
+
+void ch_arena_free(ch_arena *arena);
+
+// Returns NULL when a new chunk was needed and could not be allocated
+void *ch_arena_allocate(ch_arena *arena, size_t size);
+
+// Drops every allocation at once, the chunks are kept for reuse
+void ch_arena_reset(ch_arena *arena);
@@ -3,10 +3,95 @@
 #include <stdlib.h>
 #include <string.h>
 
+#define OPERANDS(op, size) [op] = 1 + (size)
+
+// Instruction sizes in bytes (opcode included), unknown opcodes are left at 0
+static const uint8_t instruction_sizes[NUMBER_OF_OPCODES] = {
+    OPERANDS(OP_HALT, 0),
+    OPERANDS(OP_POP, 0),
+    OPERANDS(OP_POPN, sizeof(ch_dataptr)),
+    OPERANDS(OP_TOP, 0),
+
+    OPERANDS(OP_NUMBER, sizeof(ch_dataptr)),
+    OPERANDS(OP_NEGATE, 0),
+    OPERANDS(OP_ADD, 0),
+    OPERANDS(OP_ADDONE, 0),
+    OPERANDS(OP_SUB, 0),
+    OPERANDS(OP_SUBONE, 0),
+    OPERANDS(OP_MUL, 0),
+    OPERANDS(OP_DIV, 0),
+    OPERANDS(OP_CONCATN, sizeof(ch_argcount)),
+    OPERANDS(OP_ADD_NUM, 0),
+    OPERANDS(OP_SUB_NUM, 0),
+    OPERANDS(OP_MUL_NUM, 0),
+    OPERANDS(OP_DIV_NUM, 0),
+    OPERANDS(OP_CONCAT_STR, 0),
+
+    OPERANDS(OP_STRING, sizeof(ch_dataptr)),
+    OPERANDS(OP_FALSE, 0),
+    OPERANDS(OP_TRUE, 0),
+    OPERANDS(OP_CHAR, sizeof(char)),
+    OPERANDS(OP_NULL, 0),
+
+    OPERANDS(OP_ARRAY, sizeof(ch_argcount)),
+    OPERANDS(OP_ARRAY_PUSH, 0),
+    OPERANDS(OP_INDEX_GET, 0),
+    OPERANDS(OP_INDEX_SET, 0),
+    OPERANDS(OP_MAP, 0),
+    OPERANDS(OP_MAP_GET, sizeof(ch_dataptr)),
+    OPERANDS(OP_MAP_SET, sizeof(ch_dataptr)),
+
+    OPERANDS(OP_LOAD_LOCAL, sizeof(ch_dataptr)),
+    OPERANDS(OP_SET_LOCAL, sizeof(ch_dataptr)),
+    OPERANDS(OP_LOAD_UPVALUE, sizeof(ch_argcount)),
+    OPERANDS(OP_SET_UPVALUE, sizeof(ch_argcount)),
+    OPERANDS(OP_CLOSE_UPVALUE, 0),
+    OPERANDS(OP_SET_GLOBAL, sizeof(ch_dataptr)),
+    OPERANDS(OP_DEFINE_GLOBAL, sizeof(ch_dataptr)),
+    OPERANDS(OP_LOAD_GLOBAL, sizeof(ch_dataptr)),
+    OPERANDS(OP_SET_GLOBAL_SLOT, sizeof(ch_dataptr)),
+    OPERANDS(OP_DEFINE_GLOBAL_SLOT, sizeof(ch_dataptr)),
+    OPERANDS(OP_LOAD_GLOBAL_SLOT, sizeof(ch_dataptr)),
+
+    OPERANDS(OP_BEGIN, 0),
+    OPERANDS(OP_CALL, sizeof(ch_argcount)),
+    OPERANDS(OP_RETURN_VOID, 0),
+    OPERANDS(OP_RETURN_VALUE, 0),
+    OPERANDS(OP_JMP_FALSE, sizeof(ch_jmpptr)),
+    OPERANDS(OP_JMP, sizeof(ch_jmpptr)),
+
+    OPERANDS(OP_FUNCTION, sizeof(ch_dataptr) + sizeof(ch_argcount)),
+    // Followed by an (is_local, index) pair per upvalue
+    OPERANDS(OP_CLOSURE, sizeof(ch_argcount)),
+    OPERANDS(OP_NATIVE, sizeof(ch_argcount)),
+};
+
 ch_bytecode_string ch_bytecode_load_string(const ch_program *program,
                                            ch_dataptr location) {
   uint32_t size = READ_U32(&program->start[location]);
   char *value = (char*)&program->start[location + sizeof(uint32_t)];
 
   return (ch_bytecode_string){.size = size, .value = value};
-}
\ No newline at end of file
+}
+
+bool ch_bytecode_instruction_size(const uint8_t *instruction,
+                                  const uint8_t *end, size_t *out_size) {
+  uint8_t opcode = *instruction;
+  if (opcode >= NUMBER_OF_OPCODES || instruction_sizes[opcode] == 0)
+    return false;
+
+  size_t size = instruction_sizes[opcode];
+  if (instruction + size > end)
+    return false;
+
+  if (opcode == OP_CLOSURE) {
+    ch_argcount upvalue_count = READ_ARGCOUNT(instruction + 1);
+    size += upvalue_count * 2 * sizeof(ch_argcount);
+
+    if (instruction + size > end)
+      return false;
+  }
+
+  *out_size = size;
+  return true;
+}
@@ -12,4 +12,9 @@ typedef struct {
 } ch_bytecode_string;
 
 ch_bytecode_string ch_bytecode_load_string(const ch_program *program,
-                                           ch_dataptr location);
\ No newline at end of file
+                                           ch_dataptr location);
+
+// Size of the instruction starting at `instruction`, including its opcode.
+// Returns false if the opcode is unknown or if its operands go past `end`.
+bool ch_bytecode_instruction_size(const uint8_t *instruction,
+                                  const uint8_t *end, size_t *out_size);
@@ -4,25 +4,81 @@
 #include "type_check.h"
 #include <string.h>
 
-ch_context ch_newvm(ch_program program) { 
-  ch_context context = ch_vm_newcontext(program); 
+ch_context ch_newvm(ch_program program) {
+  return ch_newvm_with_allocator(program, ch_default_allocator());
+}
+
+ch_context ch_newvm_with_allocator(ch_program program, ch_allocator allocator) {
+  ch_context context = ch_vm_newcontext(program, allocator);
 
-  ch_addnative(&context, ch_native_string_size, "size");
+  ch_addnative(&context, ch_native_size, "size");
   ch_addnative(&context, ch_native_string_substring, "substring");
   ch_addnative(&context, ch_native_string_contains, "contains");
+  ch_addnative(&context, ch_native_string_indexof, "indexOf");
+  ch_addnative(&context, ch_native_string_lastindexof, "lastIndexOf");
+  ch_addnative(&context, ch_native_string_count, "count");
+  ch_addnative(&context, ch_native_string_split, "split");
+  ch_addnative(&context, ch_native_numbers, "numbers");
+  ch_addnative(&context, ch_native_numbers_sum, "sum");
+  ch_addnative(&context, ch_native_numbers_min, "min");
+  ch_addnative(&context, ch_native_numbers_max, "max");
+  ch_addnative(&context, ch_native_numbers_dot, "dot");
+  ch_addnative(&context, ch_native_numbers_scale, "scale");
+  ch_addnative(&context, ch_native_numbers_accumulate, "accumulate");
+  ch_addnative(&context, ch_native_numbers_prefixsum, "prefixSum");
+  ch_addnative(&context, ch_native_map_keys, "keys");
+  ch_addnative(&context, ch_native_map_has, "has");
+  ch_addnative(&context, ch_native_map_remove, "remove");
 
   return context;
 }
 
 void ch_freevm(ch_context *context) { ch_vm_free(context); }
 
+void ch_loadconstants(ch_program *program) {
+  if (program->constants == NULL) {
+    // Shared between contexts, so not charged to any of them
+    program->constants = ch_constants_create(NULL);
+  }
+}
+
+void ch_freeconstants(ch_program *program) {
+  if (program->constants != NULL) {
+    ch_constants_release(program->constants);
+    program->constants = NULL;
+  }
+}
+
+void ch_memory_setlimit(ch_context *context, size_t limit) {
+  context->memory->limit = limit;
+}
+
+ch_memory_stats ch_memory_getstats(ch_context *context) {
+  return (ch_memory_stats){
+      .live_bytes = context->memory->live_bytes,
+      .peak_bytes = context->memory->peak_bytes,
+      .limit = context->memory->limit,
+  };
+}
+
 ch_primitive ch_runfunction(ch_context *context, const char *function_name) {
   ch_string *name =
       ch_loadstring(context, function_name, strlen(function_name), COPY_STRING);
 
-  ch_primitive result = ch_vm_call(context, name);
+  // Names unknown to both the program and the host can never be defined
+  uint32_t slot;
+  if (!ch_globals_find(&context->globals, name, &slot)) {
+    ch_runtime_error(context, EXIT_GLOBAL_NOT_FOUND,
+                     "Global variable does not exist: %s.", name->value);
+    return MAKE_NULL();
+  }
+
+  ch_gc_enterarena(context);
+  ch_vm_call(context, slot);
+  // The returned value is promoted with the rest of what outlives the call
+  ch_gc_leavearena(context);
 
-  return result;
+  return context->program_return_value;
 }
 
 bool ch_popnumber(ch_context* vm, double* popped) {
@@ -44,4 +100,4 @@ ch_primitive ch_pop(ch_context *vm) {
 
 void ch_push(ch_context *vm, ch_primitive primitive) {
   ch_stack_push(&vm->stack, primitive);
-}
\ No newline at end of file
+}
\ No newline at end of file
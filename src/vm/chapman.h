@@ -1,5 +1,10 @@
 #pragma once
+#include "code.h"
+#include "constants.h"
 #include "defs.h"
+#include "gc.h"
+#include "globals.h"
+#include "memory.h"
 #include "ops.h"
 #include "stack.h"
 #include "table.h"
@@ -21,11 +26,9 @@ typedef enum {
   EXIT_GLOBAL_NOT_FOUND,
   EXIT_UNSUPPORTED_OPERATION,
   EXIT_USER_ERROR,
+  EXIT_OUT_OF_MEMORY,
 } ch_exit;
 
-#define IS_PROGRAM_PTR_SAFE(context_ptr, program_ptr)                          \
-  (program_ptr >= (context_ptr)->pstart && program_ptr < (context_ptr)->pend)
-
 typedef struct {
   // The data section comes first, then the program section is after
   uint8_t *start;
@@ -34,10 +37,18 @@ typedef struct {
   // Where the program setup is located, relative to the start of the bytecode
   // section
   ch_dataptr program_start_ptr;
+  // Directory of global names, stored in the data section. It is an array of
+  // globals_count pointers to strings, where the global at slot i is named by
+  // the i-th string.
+  ch_dataptr globals_ptr;
+  uint32_t globals_count;
+  // Shared string constants, see ch_loadconstants. NULL means every context
+  // materializes its own.
+  ch_constants *constants;
 } ch_program;
 
 typedef struct {
-  uint8_t *return_addr;
+  ch_code *return_addr;
   ch_stack_addr stack_addr;
   ch_closure* closure;
 } ch_call;
@@ -50,34 +61,86 @@ typedef struct {
 } ch_call_stack;
 
 typedef struct ch_context {
-  uint8_t *pstart;
-  uint8_t *pend;
-  uint8_t *pcurrent;
-  size_t data_size;
+  // Every allocation of the context goes through it, see ch_memory_setlimit
+  ch_memory *memory;
+  // Pre-decoded instruction stream, built from the program by the loader
+  ch_code *code;
+  uint32_t code_size;
+  ch_code *pcurrent;
+  // Set once the program's setup code ran, later calls start from there
+  ch_code *pbegin;
 
   ch_stack stack;
   ch_call_stack call_stack;
   ch_exit exit;
 
   ch_upvalue* open_upvalues;
-  ch_table globals;
+  ch_globals globals;
   // For interned strings
   ch_table strings;
+  ch_constants *constants;
   ch_program program;
+  ch_gc gc;
 
   ch_primitive program_return_value;
 } ch_context;
 
 ch_context ch_newvm(ch_program program);
 
+// The allocator is used for everything the context allocates, down to the
+// context's own memory account
+ch_context ch_newvm_with_allocator(ch_program program, ch_allocator allocator);
+
 void ch_freevm(ch_context *context);
 
+// Gives the program a constant pool, so that the contexts created from it
+// share their string constants instead of each building a copy
+void ch_loadconstants(ch_program *program);
+
+// Drops the program's reference to its pool, contexts keep theirs
+void ch_freeconstants(ch_program *program);
+
+// Frees every object that is not reachable from the stack or the globals.
+// Objects the host keeps elsewhere must not be used after a collection.
+void ch_gc_collect(ch_context *context);
+
+// After a collection, the next one starts once the heap has grown by this
+// factor (2 by default). A factor of 0 collects at every safepoint.
+void ch_gc_setgrowth(ch_context *context, double growth_factor);
+
+// Splits collections into slices of at most work_budget traced or swept
+// objects, run at the interpreter's safepoints. 0 goes back to collecting in
+// a single pause.
+void ch_gc_setincremental(ch_context *context, size_t work_budget);
+
+// Allocates the objects created by each ch_runfunction call in an arena,
+// released at once when the call returns. Objects still reachable from the
+// globals or the returned value are moved to the heap first. Collections are
+// put off until the call returns.
+void ch_gc_setarena(ch_context *context, bool enabled);
+
+ch_gc_stats ch_gc_getstats(ch_context *context);
+
+// Starts a new measurement window, for example around one call
+void ch_gc_resetstats(ch_context *context);
+
+// Once the context has more than limit bytes allocated, the interpreter
+// collects at its next safepoint and stops with EXIT_OUT_OF_MEMORY if that
+// was not enough. Storage sized by the script, like array elements or text,
+// is refused outright when it would go over. Objects themselves are not, so
+// the limit can be overrun by a few of them between safepoints. 0 removes
+// the limit.
+void ch_memory_setlimit(ch_context *context, size_t limit);
+
+ch_memory_stats ch_memory_getstats(ch_context *context);
+
 ch_primitive ch_runfunction(ch_context *context, const char *function_name);
 
 void ch_runtime_error(ch_context *context, ch_exit exit, const char *error,
                       ...);
 
-// name_size should include null byte for strlen()
+// name_size should include null byte for strlen(). A script may define the
+// same name, which then replaces the native.
 void ch_addnative(ch_context *context, ch_native_function function,
                   const char *name);
 
@@ -85,6 +148,7 @@ void ch_addnative(ch_context *context, ch_native_function function,
 // So before using the popped value, it's important to check the returned flag
 bool ch_popnumber(ch_context* vm, double* popped);
 
+// The popped string is always terminated, a slice is copied first
 bool ch_popstring(ch_context* vm, ch_string** popped);
 
 ch_primitive ch_pop(ch_context *vm);
@@ -0,0 +1,38 @@
+#pragma once
+#include "object.h"
+#include <stdint.h>
+
+/*
+  Global accesses by name are followed by their name and an inline cache:
+  the slot found by the last lookup and the generation of the globals at
+  that time. The slot stays valid until the globals are reallocated.
+*/
+#define CH_GLOBAL_SITE_SIZE 3
+
+/*
+  Map accesses by constant key are followed by the key and the slot it was
+  last found in. Any map holding the key in that slot can use it, so the
+  cache is checked against the slot's key rather than against a map.
+*/
+#define CH_MAP_SITE_SIZE 2
+
+/*
+  Internal, pre-decoded form of a program. Every opcode and every operand
+  occupies one aligned word, so the interpreter never has to reassemble
+  operands byte by byte. This form only lives in memory, the emitted
+  ch_program format is unchanged.
+*/
+typedef union ch_code {
+  uint32_t op;
+  // Local offsets, pop counts, argcounts, upvalue indices and function entries
+  uint32_t index;
+  char character;
+  double number;
+  ch_string *string;
+  ch_primitive *global;
+  union ch_code *target;
+  struct {
+    uint8_t is_local;
+    uint8_t index;
+  } upvalue;
+} ch_code;
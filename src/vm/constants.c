@@ -0,0 +1,116 @@
+#include "constants.h"
+#include <stdlib.h>
+
+#define MAX_LOAD 0.75
+#define GROW_CAPACITY(capacity) ((capacity) < 8 ? 8 : (capacity)*2)
+#define NO_CONSTANT UINT32_MAX
+
+static uint32_t hash_ptr(ch_dataptr ptr) { return ptr * 2654435761u; }
+
+static ch_constant_entry *find_entry(ch_constant_entry *entries,
+                                     uint32_t capacity, ch_dataptr ptr) {
+  // Capacity is always a power of two
+  uint32_t index = hash_ptr(ptr) & (capacity - 1);
+  for (;;) {
+    ch_constant_entry *entry = &entries[index];
+    if (entry->ptr == ptr || entry->ptr == NO_CONSTANT)
+      return entry;
+
+    index = (index + 1) & (capacity - 1);
+  }
+}
+
+static void adjust_capacity(ch_constants *constants, uint32_t capacity) {
+  ch_constant_entry *entries =
+      ch_memory_alloc(constants->memory, sizeof(ch_constant_entry) * capacity);
+  for (uint32_t i = 0; i < capacity; i++) {
+    entries[i].ptr = NO_CONSTANT;
+    entries[i].string = NULL;
+  }
+
+  for (uint32_t i = 0; i < constants->capacity; i++) {
+    ch_constant_entry *entry = &constants->entries[i];
+    if (entry->ptr == NO_CONSTANT)
+      continue;
+
+    *find_entry(entries, capacity, entry->ptr) = *entry;
+  }
+
+  ch_memory_release(constants->memory, constants->entries,
+                    sizeof(ch_constant_entry) * constants->capacity);
+  constants->entries = entries;
+  constants->capacity = capacity;
+}
+
+ch_constants *ch_constants_create(ch_memory *memory) {
+  ch_constants *constants = ch_memory_alloc(memory, sizeof(ch_constants));
+  constants->memory = memory;
+  constants->entries = NULL;
+  constants->capacity = 0;
+  constants->size = 0;
+  constants->references = 1;
+  ch_table_create(&constants->strings, memory);
+
+  return constants;
+}
+
+ch_constants *ch_constants_retain(ch_constants *constants) {
+  constants->references++;
+  return constants;
+}
+
+void ch_constants_release(ch_constants *constants) {
+  if (--constants->references > 0)
+    return;
+
+  ch_memory *memory = constants->memory;
+  ch_table_finish_resize(&constants->strings);
+  ch_table_slots *slots = &constants->strings.slots;
+  for (uint32_t i = 0; i < slots->capacity; i++) {
+    // The values themselves belong to the program
+    if (CH_TABLE_IN_USE(slots, i)) {
+      ch_memory_release(memory, slots->keys[i], sizeof(ch_string));
+    }
+  }
+
+  ch_table_free(&constants->strings);
+  ch_memory_release(memory, constants->entries,
+                    sizeof(ch_constant_entry) * constants->capacity);
+  ch_memory_release(memory, constants, sizeof(ch_constants));
+}
+
+ch_string *ch_constants_get(ch_constants *constants, ch_dataptr ptr) {
+  if (constants->size == 0)
+    return NULL;
+
+  return find_entry(constants->entries, constants->capacity, ptr)->string;
+}
+
+ch_string *ch_constants_add(ch_constants *constants, ch_dataptr ptr,
+                            const char *value, size_t size) {
+  if (constants->size + 1 > constants->capacity * MAX_LOAD) {
+    adjust_capacity(constants, GROW_CAPACITY(constants->capacity));
+  }
+
+  ch_constant_entry *entry =
+      find_entry(constants->entries, constants->capacity, ptr);
+  if (entry->ptr == ptr)
+    return entry->string;
+
+  ch_string *string = ch_table_find_string(&constants->strings, value, size);
+  if (string == NULL) {
+    string = ch_memory_alloc(constants->memory, sizeof(ch_string));
+    ch_initstring(string, value, size);
+    // Shared between contexts, so never collected by any of them
+    string->object.marked = true;
+    string->object.in_arena = false;
+    string->object.next = NULL;
+    ch_table_set(&constants->strings, string, MAKE_NULL());
+  }
+
+  entry->ptr = ptr;
+  entry->string = string;
+  constants->size++;
+
+  return string;
+}
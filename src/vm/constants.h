@@ -0,0 +1,42 @@
+#pragma once
+#include "defs.h"
+#include "object.h"
+#include "table.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  ch_dataptr ptr;
+  ch_string *string;
+} ch_constant_entry;
+
+/*
+  Strings of the data section, materialized once and shared by every context
+  created from the same program. Entries are keyed by the data section
+  pointer the bytecode refers to them with. The strings point straight into
+  the program, so the program must outlive the pool.
+*/
+typedef struct ch_constants {
+  ch_constant_entry *entries;
+  uint32_t capacity;
+  uint32_t size;
+
+  // Constants with the same value share one string
+  ch_table strings;
+  uint32_t references;
+  // NULL for pools shared between contexts, which no context is charged for
+  ch_memory *memory;
+} ch_constants;
+
+ch_constants *ch_constants_create(ch_memory *memory);
+
+ch_constants *ch_constants_retain(ch_constants *constants);
+
+// Frees the pool and its strings once the last reference is released
+void ch_constants_release(ch_constants *constants);
+
+// Returns NULL if the string at ptr has not been materialized yet
+ch_string *ch_constants_get(ch_constants *constants, ch_dataptr ptr);
+
+ch_string *ch_constants_add(ch_constants *constants, ch_dataptr ptr,
+                            const char *value, size_t size);
@@ -21,12 +21,26 @@ const char *OPCODE_NAMES[NUMBER_OF_OPCODES] = {
     NAME(OP_SUBONE, SUBONE),
     NAME(OP_MUL, MUL),
     NAME(OP_DIV, DIV),
+    NAME(OP_CONCATN, CONCATN),
+    NAME(OP_ADD_NUM, ADD_NUM),
+    NAME(OP_SUB_NUM, SUB_NUM),
+    NAME(OP_MUL_NUM, MUL_NUM),
+    NAME(OP_DIV_NUM, DIV_NUM),
+    NAME(OP_CONCAT_STR, CONCAT_STR),
 
     NAME(OP_STRING, STRING),
     NAME(OP_TRUE, TRUE),
     NAME(OP_FALSE, FALSE),
     NAME(OP_NULL, NULL),
 
+    NAME(OP_ARRAY, ARRAY),
+    NAME(OP_ARRAY_PUSH, ARRAY_PUSH),
+    NAME(OP_INDEX_GET, INDEX_GET),
+    NAME(OP_INDEX_SET, INDEX_SET),
+    NAME(OP_MAP, MAP),
+    NAME(OP_MAP_GET, MAP_GET),
+    NAME(OP_MAP_SET, MAP_SET),
+
     NAME(OP_LOAD_LOCAL, LOAD_LOCAL),
     NAME(OP_SET_LOCAL, SET_LOCAL),
     NAME(OP_LOAD_UPVALUE, LOAD_UPVALUE),
@@ -35,6 +49,9 @@ const char *OPCODE_NAMES[NUMBER_OF_OPCODES] = {
     NAME(OP_SET_GLOBAL, SET_GLOBAL),
     NAME(OP_DEFINE_GLOBAL, DEFINE_GLOBAL),
     NAME(OP_LOAD_GLOBAL, LOAD_GLOBAL),
+    NAME(OP_SET_GLOBAL_SLOT, SET_GLOBAL_SLOT),
+    NAME(OP_DEFINE_GLOBAL_SLOT, DEFINE_GLOBAL_SLOT),
+    NAME(OP_LOAD_GLOBAL_SLOT, LOAD_GLOBAL_SLOT),
 
     NAME(OP_BEGIN, BEGIN),
     NAME(OP_CALL, CALL),
@@ -90,6 +107,16 @@ static size_t print_string_ptr(const ch_program *program, uint8_t *i) {
   return sizeof(ptr);
 }
 
+static size_t print_global_slot(const ch_program *program, uint8_t *i) {
+  uint32_t slot = READ_U32(i);
+  ch_dataptr name_ptr =
+      READ_U32(&program->start[program->globals_ptr + slot * sizeof(ch_dataptr)]);
+  ch_bytecode_string name = ch_bytecode_load_string(program, name_ptr);
+  printf("(slot %" PRIu32 " <%.*s>) ", slot, (int) name.size, name.value);
+
+  return sizeof(slot);
+}
+
 static size_t print_argcount(const ch_program *program, uint8_t *i) {
   ch_argcount argcount = *i;
   printf("(argc %" PRIu8 ") ", argcount);
@@ -122,6 +149,7 @@ void ch_disassemble(const ch_program *program) {
          program->total_size - program->data_size);
   printf("Program starts at: %zu b\n",
          program->data_size + program->program_start_ptr);
+  printf("Globals: %" PRIu32 "\n", program->globals_count);
 
   header("INSTRUCTIONS");
   uint8_t *i = program->start + program->data_size;
@@ -162,17 +190,27 @@ void ch_disassemble(const ch_program *program) {
       break;
     }
     case OP_NATIVE:
+    case OP_CONCATN:
+    case OP_ARRAY:
     case OP_CALL: {
       i += print_argcount(program, i);
       break;
     }
     case OP_STRING:
+    case OP_MAP_GET:
+    case OP_MAP_SET:
     case OP_LOAD_GLOBAL:
     case OP_DEFINE_GLOBAL:
     case OP_SET_GLOBAL: {
       i += print_string_ptr(program, i);
       break;
     }
+    case OP_LOAD_GLOBAL_SLOT:
+    case OP_DEFINE_GLOBAL_SLOT:
+    case OP_SET_GLOBAL_SLOT: {
+      i += print_global_slot(program, i);
+      break;
+    }
     case OP_JMP:
     case OP_JMP_FALSE: {
       i += print_jump_ptr(program, i);
@@ -0,0 +1,767 @@
+#include "gc.h"
+#include "chapman.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GROW_CAPACITY(capacity) ((capacity) < 8 ? 8 : (capacity)*2)
+#define UNLIMITED_WORK SIZE_MAX
+
+static void list_create(ch_gc_list *list) {
+  list->objects = NULL;
+  list->count = 0;
+  list->capacity = 0;
+}
+
+static void list_push(ch_gc *gc, ch_gc_list *list, ch_object *object) {
+  if (list->count == list->capacity) {
+    size_t capacity = GROW_CAPACITY(list->capacity);
+    list->objects = ch_memory_realloc(gc->memory, list->objects,
+                                      list->capacity * sizeof(ch_object *),
+                                      capacity * sizeof(ch_object *));
+    list->capacity = capacity;
+  }
+
+  list->objects[list->count++] = object;
+}
+
+static void list_free(ch_gc *gc, ch_gc_list *list) {
+  ch_memory_release(gc->memory, list->objects,
+                    list->capacity * sizeof(ch_object *));
+  list_create(list);
+}
+
+void ch_gc_create(ch_gc *out_gc, ch_memory *memory) {
+  out_gc->memory = memory;
+  out_gc->objects = NULL;
+  out_gc->bytes_allocated = 0;
+  out_gc->next_collection = CH_GC_MIN_THRESHOLD;
+  out_gc->growth_factor = CH_GC_DEFAULT_GROWTH_FACTOR;
+  out_gc->phase = CH_GC_IDLE;
+  out_gc->work_budget = 0;
+  list_create(&out_gc->gray);
+  out_gc->sweep_link = NULL;
+  out_gc->cycles = 0;
+  out_gc->pauses = 0;
+  out_gc->total_pause = 0;
+  out_gc->pause_samples = NULL;
+  out_gc->use_arena = false;
+  out_gc->arena_active = false;
+  ch_arena_create(&out_gc->arena, CH_ARENA_CHUNK_SIZE, memory);
+  list_create(&out_gc->arena_strings);
+  list_create(&out_gc->remembered);
+}
+
+static ch_object *allocate_arena(ch_gc *gc, size_t size,
+                                 ch_object_type type) {
+  ch_object *object = ch_arena_allocate(&gc->arena, size);
+  object->type = type;
+  object->marked = false;
+  object->in_arena = true;
+  object->next = NULL;
+
+  if (type == TYPE_STRING) {
+    list_push(gc, &gc->arena_strings, object);
+  }
+
+  return object;
+}
+
+static ch_object *allocate_heap(ch_gc *gc, size_t size, ch_object_type type) {
+  ch_object *object = ch_memory_alloc(gc->memory, size);
+  object->type = type;
+  // Objects created while marking are black, their fields are stored through
+  // the barrier
+  object->marked = gc->phase == CH_GC_MARK;
+  object->in_arena = false;
+  object->next = gc->objects;
+  gc->objects = object;
+  gc->bytes_allocated += size;
+
+  // Objects created while sweeping must stay out of reach of this sweep
+  if (gc->sweep_link == &gc->objects) {
+    gc->sweep_link = &object->next;
+  }
+
+  return object;
+}
+
+ch_object *ch_gc_allocate(ch_context *context, size_t size,
+                          ch_object_type type) {
+  if (context->gc.arena_active)
+    return allocate_arena(&context->gc, size, type);
+
+  return allocate_heap(&context->gc, size, type);
+}
+
+ch_object *ch_gc_allocate_heap(ch_context *context, size_t size,
+                               ch_object_type type) {
+  return allocate_heap(&context->gc, size, type);
+}
+
+static size_t next_collection(ch_gc *gc) {
+  if (gc->growth_factor <= 0)
+    return 0;
+
+  size_t next = gc->bytes_allocated * gc->growth_factor;
+  return next < CH_GC_MIN_THRESHOLD ? CH_GC_MIN_THRESHOLD : next;
+}
+
+void ch_gc_track(ch_context *context, size_t size) {
+  if (!context->gc.arena_active) {
+    context->gc.bytes_allocated += size;
+  }
+}
+
+static void *refuse_data(ch_context *context, size_t size) {
+  ch_runtime_error(context, EXIT_OUT_OF_MEMORY,
+                   "Could not allocate %zu bytes.", size);
+  return NULL;
+}
+
+void *ch_gc_allocate_data(ch_context *context, size_t size) {
+  void *data = context->gc.arena_active
+                   ? ch_arena_allocate(&context->gc.arena, size)
+                   : ch_memory_alloc(context->gc.memory, size);
+  return data != NULL ? data : refuse_data(context, size);
+}
+
+void *ch_gc_grow_data(ch_context *context, ch_object *owner, void *data,
+                      size_t size, size_t new_size) {
+  ch_gc *gc = &context->gc;
+  if (owner->in_arena) {
+    void *grown = ch_arena_allocate(&gc->arena, new_size);
+    if (grown == NULL)
+      return refuse_data(context, new_size);
+
+    if (size > 0) {
+      memcpy(grown, data, size);
+    }
+    return grown;
+  }
+
+  void *grown = ch_memory_realloc(gc->memory, data, size, new_size);
+  if (grown == NULL)
+    return refuse_data(context, new_size);
+
+  gc->bytes_allocated += new_size - size;
+  return grown;
+}
+
+void ch_gc_free_data(ch_context *context, void *data, size_t size) {
+  // Arena memory goes away with the next reset
+  if (!context->gc.arena_active) {
+    ch_memory_release(context->gc.memory, data, size);
+  }
+}
+
+static size_t object_size(ch_object *object) {
+  switch (object->type) {
+  case TYPE_STRING:
+    return sizeof(ch_string);
+  case TYPE_CLOSURE:
+    return sizeof(ch_closure);
+  case TYPE_FUNCTION:
+    return sizeof(ch_function);
+  case TYPE_UPVALUE:
+    return sizeof(ch_upvalue);
+  case TYPE_NATIVE:
+    return sizeof(ch_native);
+  case TYPE_ROPE:
+    return sizeof(ch_rope);
+  case TYPE_ARRAY:
+    return sizeof(ch_array);
+  case TYPE_F64ARRAY:
+    return sizeof(ch_f64array);
+  case TYPE_MAP:
+    return sizeof(ch_map);
+  }
+
+  return 0;
+}
+
+static size_t free_object(ch_gc *gc, ch_object *object) {
+  size_t size = object_size(object);
+
+  switch (object->type) {
+  case TYPE_STRING: {
+    ch_string *string = AS_STRING(object);
+    if (string->owns_value) {
+      ch_memory_release(gc->memory, (char *)string->value, string->size + 1);
+      size += string->size + 1;
+    }
+    break;
+  }
+  case TYPE_CLOSURE: {
+    ch_closure *closure = AS_CLOSURE(object);
+    size_t upvalues_size = closure->upvalue_count * sizeof(ch_upvalue *);
+    ch_memory_release(gc->memory, closure->upvalues, upvalues_size);
+    size += upvalues_size;
+    break;
+  }
+  case TYPE_ARRAY: {
+    ch_array *array = AS_ARRAY(object);
+    size_t values_size = array->capacity * sizeof(ch_primitive);
+    ch_memory_release(gc->memory, array->values, values_size);
+    size += values_size;
+    break;
+  }
+  case TYPE_F64ARRAY: {
+    ch_f64array *array = AS_F64ARRAY(object);
+    size_t values_size = array->capacity * sizeof(double);
+    ch_memory_release(gc->memory, array->values, values_size);
+    size += values_size;
+    break;
+  }
+  case TYPE_MAP: {
+    ch_table *table = &AS_MAP(object)->table;
+    size += ch_table_footprint(table);
+    ch_table_free(table);
+    break;
+  }
+  default:
+    break;
+  }
+
+  ch_memory_release(gc->memory, object, object_size(object));
+  return size;
+}
+
+static void mark_object(ch_gc *gc, ch_object *object) {
+  // Arena objects are never collected, the collector does not run while they
+  // exist. They can still be shaded by the barrier.
+  if (object == NULL || object->marked || object->in_arena)
+    return;
+
+  object->marked = true;
+  // Strings and natives go straight to black. A slice only refers to its
+  // parent, which never is a slice itself.
+  if (object->type == TYPE_STRING) {
+    mark_object(gc, (ch_object *)AS_STRING(object)->parent);
+    return;
+  }
+
+  if (object->type == TYPE_NATIVE)
+    return;
+
+  list_push(gc, &gc->gray, object);
+}
+
+static void mark_primitive(ch_gc *gc, ch_primitive primitive) {
+  if (IS_OBJECT(primitive)) {
+    mark_object(gc, AS_OBJECT(primitive));
+  }
+}
+
+void ch_gc_shade(ch_gc *gc, ch_primitive value) { mark_primitive(gc, value); }
+
+// Roots that are written without a barrier, scanned at both ends of marking
+static void mark_stack_roots(ch_context *context) {
+  ch_gc *gc = &context->gc;
+
+  for (size_t i = 0; i < context->stack.size; i++) {
+    mark_primitive(gc, context->stack.start[i]);
+  }
+
+  for (uint32_t i = 0; i < context->call_stack.size; i++) {
+    mark_object(gc, (ch_object *)context->call_stack.calls[i].closure);
+  }
+
+  for (ch_upvalue *upvalue = context->open_upvalues; upvalue != NULL;
+       upvalue = upvalue->next) {
+    mark_object(gc, (ch_object *)upvalue);
+  }
+
+  mark_primitive(gc, context->program_return_value);
+}
+
+static void mark_roots(ch_context *context) {
+  ch_gc *gc = &context->gc;
+  mark_stack_roots(context);
+
+  for (uint32_t i = 0; i < context->globals.size; i++) {
+    mark_object(gc, (ch_object *)context->globals.names[i]);
+    if (context->globals.defined[i]) {
+      mark_primitive(gc, context->globals.values[i]);
+    }
+  }
+}
+
+static void mark_table_slots(ch_gc *gc, ch_table_slots *slots) {
+  for (uint32_t i = 0; i < slots->capacity; i++) {
+    if (CH_TABLE_IN_USE(slots, i)) {
+      mark_object(gc, (ch_object *)slots->keys[i]);
+      mark_primitive(gc, slots->values[i]);
+    }
+  }
+}
+
+// Blackens gray objects until the budget runs out, returns what is left of it
+static size_t trace_references(ch_gc *gc, size_t budget) {
+  while (gc->gray.count > 0 && budget > 0) {
+    ch_object *object = gc->gray.objects[--gc->gray.count];
+    budget--;
+
+    switch (object->type) {
+    case TYPE_CLOSURE: {
+      ch_closure *closure = AS_CLOSURE(object);
+      mark_object(gc, (ch_object *)closure->function);
+      for (uint8_t i = 0; i < closure->upvalue_count; i++) {
+        mark_object(gc, (ch_object *)closure->upvalues[i]);
+      }
+      break;
+    }
+    case TYPE_UPVALUE: {
+      // Open upvalues point into the stack, which is a root already
+      mark_primitive(gc, ((ch_upvalue *)object)->closed);
+      break;
+    }
+    case TYPE_ROPE: {
+      ch_rope *rope = AS_ROPE(object);
+      mark_object(gc, rope->left);
+      mark_object(gc, rope->right);
+      mark_object(gc, (ch_object *)rope->flat);
+      break;
+    }
+    case TYPE_ARRAY: {
+      ch_array *array = AS_ARRAY(object);
+      for (uint32_t i = 0; i < array->count; i++) {
+        mark_primitive(gc, array->values[i]);
+      }
+      break;
+    }
+    case TYPE_MAP: {
+      // Migrated old slots are deleted, so every key is in use exactly once
+      ch_table *table = &AS_MAP(object)->table;
+      mark_table_slots(gc, &table->slots);
+      mark_table_slots(gc, &table->old);
+      break;
+    }
+    default:
+      break;
+    }
+  }
+
+  return budget;
+}
+
+// The intern table does not keep strings alive
+static void remove_unmarked_strings(ch_table *strings) {
+  ch_table_finish_resize(strings);
+  for (uint32_t i = 0; i < strings->slots.capacity; i++) {
+    if (!CH_TABLE_IN_USE(&strings->slots, i))
+      continue;
+
+    ch_string *key = strings->slots.keys[i];
+    if (!key->object.marked) {
+      ch_table_delete(strings, key);
+    }
+  }
+}
+
+static void finish_mark(ch_context *context) {
+  ch_gc *gc = &context->gc;
+  mark_stack_roots(context);
+  trace_references(gc, UNLIMITED_WORK);
+  remove_unmarked_strings(&context->strings);
+
+  gc->phase = CH_GC_SWEEP;
+  gc->sweep_link = &gc->objects;
+}
+
+static size_t sweep(ch_gc *gc, size_t budget) {
+  while (*gc->sweep_link != NULL && budget > 0) {
+    ch_object *object = *gc->sweep_link;
+    budget--;
+
+    if (object->marked) {
+      object->marked = false;
+      gc->sweep_link = &object->next;
+    } else {
+      *gc->sweep_link = object->next;
+      gc->bytes_allocated -= free_object(gc, object);
+    }
+  }
+
+  if (*gc->sweep_link == NULL) {
+    gc->phase = CH_GC_IDLE;
+    gc->sweep_link = NULL;
+    gc->next_collection = next_collection(gc);
+    gc->cycles++;
+  }
+
+  return budget;
+}
+
+static void run(ch_context *context, size_t budget) {
+  ch_gc *gc = &context->gc;
+
+  if (gc->phase == CH_GC_IDLE) {
+    gc->phase = CH_GC_MARK;
+    mark_roots(context);
+  }
+
+  if (gc->phase == CH_GC_MARK) {
+    budget = trace_references(gc, budget);
+    if (gc->gray.count == 0) {
+      finish_mark(context);
+    }
+  }
+
+  if (gc->phase == CH_GC_SWEEP && budget > 0) {
+    sweep(gc, budget);
+  }
+}
+
+static uint64_t now_ns(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+static void record_pause(ch_gc *gc, uint64_t pause) {
+  if (gc->pause_samples == NULL) {
+    gc->pause_samples =
+        ch_memory_alloc(gc->memory, CH_GC_PAUSE_SAMPLES * sizeof(uint64_t));
+    memset(gc->pause_samples, 0, CH_GC_PAUSE_SAMPLES * sizeof(uint64_t));
+  }
+
+  gc->pause_samples[gc->pauses % CH_GC_PAUSE_SAMPLES] = pause;
+  gc->pauses++;
+  gc->total_pause += pause;
+}
+
+void ch_gc_step(ch_context *context) {
+  ch_gc *gc = &context->gc;
+  if (gc->arena_active)
+    return;
+
+  uint64_t start = now_ns();
+
+  if (gc->work_budget == 0) {
+    run(context, UNLIMITED_WORK);
+  } else {
+    run(context, gc->work_budget);
+  }
+
+  record_pause(gc, now_ns() - start);
+}
+
+void ch_gc_collect(ch_context *context) {
+  ch_gc *gc = &context->gc;
+  if (gc->arena_active)
+    return;
+
+  uint64_t start = now_ns();
+
+  // A cycle in progress may keep garbage created since it started
+  bool was_collecting = gc->phase != CH_GC_IDLE;
+  run(context, UNLIMITED_WORK);
+  if (was_collecting) {
+    run(context, UNLIMITED_WORK);
+  }
+
+  record_pause(gc, now_ns() - start);
+}
+
+void ch_gc_remember(ch_gc *gc, ch_object *object) {
+  list_push(gc, &gc->remembered, object);
+}
+
+// Copies an arena object to the heap, the first time it is reached. The arena
+// object is left marked, with next forwarding to its copy.
+static ch_object *promote_object(ch_context *context, ch_object *object) {
+  if (object == NULL || !object->in_arena)
+    return object;
+
+  if (object->marked)
+    return object->next;
+
+  ch_gc *gc = &context->gc;
+  size_t size = object_size(object);
+  ch_object *promoted = allocate_heap(gc, size, object->type);
+  memcpy((char *)promoted + sizeof(ch_object),
+         (char *)object + sizeof(ch_object), size - sizeof(ch_object));
+
+  switch (object->type) {
+  case TYPE_STRING: {
+    ch_string *string = AS_STRING(promoted);
+    if (string->owns_value) {
+      char *value = ch_memory_alloc(gc->memory, string->size + 1);
+      memcpy(value, string->value, string->size + 1);
+      string->value = value;
+      gc->bytes_allocated += string->size + 1;
+    }
+    break;
+  }
+  case TYPE_CLOSURE: {
+    ch_closure *closure = AS_CLOSURE(promoted);
+    size_t upvalues_size = closure->upvalue_count * sizeof(ch_upvalue *);
+    ch_upvalue **upvalues = ch_memory_alloc(gc->memory, upvalues_size);
+    memcpy(upvalues, closure->upvalues, upvalues_size);
+    closure->upvalues = upvalues;
+    gc->bytes_allocated += upvalues_size;
+    break;
+  }
+  case TYPE_UPVALUE: {
+    ch_upvalue *upvalue = (ch_upvalue *)promoted;
+    if (upvalue->value == &((ch_upvalue *)object)->closed) {
+      upvalue->value = &upvalue->closed;
+    }
+    break;
+  }
+  case TYPE_ARRAY: {
+    ch_array *array = AS_ARRAY(promoted);
+    if (array->capacity == 0)
+      break;
+
+    size_t values_size = array->capacity * sizeof(ch_primitive);
+    ch_primitive *values = ch_memory_alloc(gc->memory, values_size);
+    memcpy(values, array->values, array->count * sizeof(ch_primitive));
+    array->values = values;
+    gc->bytes_allocated += values_size;
+    break;
+  }
+  case TYPE_F64ARRAY: {
+    ch_f64array *array = AS_F64ARRAY(promoted);
+    if (array->capacity == 0)
+      break;
+
+    size_t values_size = array->capacity * sizeof(double);
+    double *values = ch_memory_alloc(gc->memory, values_size);
+    memcpy(values, array->values, array->count * sizeof(double));
+    array->values = values;
+    gc->bytes_allocated += values_size;
+    break;
+  }
+  default:
+    break;
+  }
+
+  object->marked = true;
+  object->next = promoted;
+  return promoted;
+}
+
+// Copies the arena object a field points to, heap objects are left in place.
+// Promoted objects are black when the collector is marking, so the field goes
+// through the barrier either way.
+static void promote_field(ch_context *context, ch_object **field) {
+  *field = promote_object(context, *field);
+  if (context->gc.phase == CH_GC_MARK) {
+    mark_object(&context->gc, *field);
+  }
+}
+
+static void promote_primitive(ch_context *context, ch_primitive *value) {
+  if (IS_OBJECT(*value)) {
+    ch_object *object = AS_OBJECT(*value);
+    promote_field(context, &object);
+    *value = MAKE_OBJECT(object);
+  }
+}
+
+// A promoted key is the same string at a new address, so it stays in its slot
+static void promote_table_slots(ch_context *context, ch_table_slots *slots) {
+  for (uint32_t i = 0; i < slots->capacity; i++) {
+    if (CH_TABLE_IN_USE(slots, i)) {
+      promote_field(context, (ch_object **)&slots->keys[i]);
+      promote_primitive(context, &slots->values[i]);
+    }
+  }
+}
+
+static void promote_children(ch_context *context, ch_object *object) {
+  switch (object->type) {
+  case TYPE_STRING: {
+    ch_string *string = AS_STRING(object);
+    if (string->parent != NULL) {
+      promote_field(context, (ch_object **)&string->parent);
+      string->value = &string->parent->value[string->offset];
+    }
+    break;
+  }
+  case TYPE_CLOSURE: {
+    ch_closure *closure = AS_CLOSURE(object);
+    promote_field(context, (ch_object **)&closure->function);
+    for (uint8_t i = 0; i < closure->upvalue_count; i++) {
+      promote_field(context, (ch_object **)&closure->upvalues[i]);
+    }
+    break;
+  }
+  case TYPE_UPVALUE: {
+    ch_upvalue *upvalue = (ch_upvalue *)object;
+    promote_primitive(context, &upvalue->closed);
+    // Only open upvalues are still linked
+    if (upvalue->value != &upvalue->closed) {
+      promote_field(context, (ch_object **)&upvalue->next);
+    }
+    break;
+  }
+  case TYPE_ROPE: {
+    ch_rope *rope = AS_ROPE(object);
+    promote_field(context, &rope->left);
+    promote_field(context, &rope->right);
+    promote_field(context, (ch_object **)&rope->flat);
+    break;
+  }
+  case TYPE_ARRAY: {
+    ch_array *array = AS_ARRAY(object);
+    for (uint32_t i = 0; i < array->count; i++) {
+      promote_primitive(context, &array->values[i]);
+    }
+    break;
+  }
+  case TYPE_MAP: {
+    ch_table *table = &AS_MAP(object)->table;
+    promote_table_slots(context, &table->slots);
+    promote_table_slots(context, &table->old);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static void promote_roots(ch_context *context) {
+  for (size_t i = 0; i < context->stack.size; i++) {
+    promote_primitive(context, &context->stack.start[i]);
+  }
+
+  for (uint32_t i = 0; i < context->call_stack.size; i++) {
+    promote_field(context,
+                  (ch_object **)&context->call_stack.calls[i].closure);
+  }
+
+  promote_field(context, (ch_object **)&context->open_upvalues);
+  promote_primitive(context, &context->program_return_value);
+
+  for (uint32_t i = 0; i < context->globals.size; i++) {
+    promote_field(context, (ch_object **)&context->globals.names[i]);
+    if (context->globals.defined[i]) {
+      promote_primitive(context, &context->globals.values[i]);
+    }
+  }
+
+  ch_gc_list *remembered = &context->gc.remembered;
+  for (size_t i = 0; i < remembered->count; i++) {
+    promote_children(context, remembered->objects[i]);
+  }
+}
+
+void ch_gc_enterarena(ch_context *context) {
+  context->gc.arena_active = context->gc.use_arena;
+}
+
+void ch_gc_leavearena(ch_context *context) {
+  ch_gc *gc = &context->gc;
+  if (!gc->arena_active)
+    return;
+
+  uint64_t start = now_ns();
+  gc->arena_active = false;
+
+  // Promoted objects are pushed in front of the objects list, every batch is
+  // scanned until no more objects get promoted
+  ch_object *scanned = gc->objects;
+  promote_roots(context);
+  while (gc->objects != scanned) {
+    ch_object *batch = gc->objects;
+    for (ch_object *object = batch; object != scanned; object = object->next) {
+      promote_children(context, object);
+    }
+    scanned = batch;
+  }
+
+  for (size_t i = 0; i < gc->arena_strings.count; i++) {
+    ch_object *string = gc->arena_strings.objects[i];
+    // Slices were never interned
+    bool interned = ch_table_delete(&context->strings, AS_STRING(string));
+    if (interned && string->marked) {
+      ch_table_set(&context->strings, AS_STRING(string->next), MAKE_NULL());
+    }
+  }
+
+  for (size_t i = 0; i < gc->remembered.count; i++) {
+    ch_object *object = gc->remembered.objects[i];
+    if (object->type == TYPE_ARRAY) {
+      AS_ARRAY(object)->remembered = false;
+    } else if (object->type == TYPE_MAP) {
+      AS_MAP(object)->remembered = false;
+    }
+  }
+
+  gc->arena_strings.count = 0;
+  gc->remembered.count = 0;
+  ch_arena_reset(&gc->arena);
+  record_pause(gc, now_ns() - start);
+}
+
+void ch_gc_setarena(ch_context *context, bool enabled) {
+  context->gc.use_arena = enabled;
+}
+
+void ch_gc_setgrowth(ch_context *context, double growth_factor) {
+  context->gc.growth_factor = growth_factor;
+  if (context->gc.phase == CH_GC_IDLE) {
+    context->gc.next_collection = next_collection(&context->gc);
+  }
+}
+
+void ch_gc_setincremental(ch_context *context, size_t work_budget) {
+  context->gc.work_budget = work_budget;
+}
+
+static int compare_pauses(const void *left, const void *right) {
+  uint64_t a = *(const uint64_t *)left;
+  uint64_t b = *(const uint64_t *)right;
+  return (a > b) - (a < b);
+}
+
+ch_gc_stats ch_gc_getstats(ch_context *context) {
+  ch_gc *gc = &context->gc;
+  ch_gc_stats stats = {
+      .cycles = gc->cycles,
+      .pauses = gc->pauses,
+      .max_pause = 0,
+      .p99_pause = 0,
+      .total_pause = gc->total_pause,
+  };
+
+  size_t count =
+      gc->pauses < CH_GC_PAUSE_SAMPLES ? gc->pauses : CH_GC_PAUSE_SAMPLES;
+  if (count == 0)
+    return stats;
+
+  uint64_t sorted[CH_GC_PAUSE_SAMPLES];
+  memcpy(sorted, gc->pause_samples, count * sizeof(uint64_t));
+  qsort(sorted, count, sizeof(uint64_t), compare_pauses);
+
+  stats.max_pause = sorted[count - 1];
+  stats.p99_pause = sorted[(count * 99 - 1) / 100];
+  return stats;
+}
+
+void ch_gc_resetstats(ch_context *context) {
+  context->gc.cycles = 0;
+  context->gc.pauses = 0;
+  context->gc.total_pause = 0;
+}
+
+void ch_gc_free(ch_context *context) {
+  ch_gc *gc = &context->gc;
+  ch_object *object = gc->objects;
+  while (object != NULL) {
+    ch_object *next = object->next;
+    free_object(gc, object);
+    object = next;
+  }
+
+  list_free(gc, &gc->gray);
+  list_free(gc, &gc->arena_strings);
+  list_free(gc, &gc->remembered);
+  ch_arena_free(&gc->arena);
+  ch_memory_release(gc->memory, gc->pause_samples,
+                    CH_GC_PAUSE_SAMPLES * sizeof(uint64_t));
+  ch_gc_create(gc, gc->memory);
+}
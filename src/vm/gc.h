@@ -0,0 +1,172 @@
+#pragma once
+#include "arena.h"
+#include "object.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Collections never start before this many bytes of objects are allocated,
+// unless the growth factor is 0
+#define CH_GC_MIN_THRESHOLD (1024 * 1024)
+#define CH_GC_DEFAULT_GROWTH_FACTOR 2.0
+// Number of most recent pauses the statistics are computed over
+#define CH_GC_PAUSE_SAMPLES 1024
+
+typedef enum {
+  CH_GC_IDLE,
+  CH_GC_MARK,
+  CH_GC_SWEEP,
+} ch_gc_phase;
+
+typedef struct {
+  uint64_t cycles;
+  uint64_t pauses;
+  // In nanoseconds, over the last CH_GC_PAUSE_SAMPLES pauses
+  uint64_t max_pause;
+  uint64_t p99_pause;
+  uint64_t total_pause;
+} ch_gc_stats;
+
+typedef struct {
+  ch_object **objects;
+  size_t count;
+  size_t capacity;
+} ch_gc_list;
+
+/*
+  Tri-color collector for the objects owned by a context. Every object
+  allocated through object.c is linked into the objects list. White objects
+  are unmarked, gray ones are marked and waiting in the gray stack, black ones
+  are marked and traced. Collections only run at safepoints of the
+  interpreter loop (or when the host asks for one), where every live value is
+  reachable from the roots: the value stack, the call frames, the open
+  upvalues and the globals. Constants belong to the program's pool, they are
+  never linked in the list and stay marked.
+
+  By default a collection runs to completion in a single pause. In
+  incremental mode, every safepoint does at most work_budget units of marking
+  or sweeping. Stores into globals and upvalues then go through
+  CH_GC_BARRIER, so that a black object never points to a white one, and
+  objects allocated while marking start black. The stack roots are scanned
+  once more when marking runs out of gray objects.
+
+  In arena mode, every object created by a ch_runfunction call is bump
+  allocated from the arena instead, and never linked in the objects list.
+  When the call returns, arena objects that are still reachable from the
+  roots, or from the heap upvalues and ropes that were given one of them, are
+  copied to the heap. The arena is then reset at once. Collections are put off while a
+  call runs in the arena, which means its garbage lives until the call
+  returns.
+*/
+typedef struct {
+  ch_memory *memory;
+  ch_object *objects;
+  size_t bytes_allocated;
+  size_t next_collection;
+  // After a collection, the next one starts once the heap has grown by this
+  // factor. A factor of 0 collects at every safepoint.
+  double growth_factor;
+
+  ch_gc_phase phase;
+  // Objects traced or swept per slice, 0 when collections are not incremental
+  size_t work_budget;
+
+  ch_gc_list gray;
+  // Link to the next object to sweep
+  ch_object **sweep_link;
+
+  uint64_t cycles;
+  uint64_t pauses;
+  uint64_t total_pause;
+  // Ring buffer of the most recent pauses, in nanoseconds
+  uint64_t *pause_samples;
+
+  bool use_arena;
+  // Set while a call allocates in the arena
+  bool arena_active;
+  ch_arena arena;
+  // Arena strings, they are interned and have to leave the table on reset
+  ch_gc_list arena_strings;
+  // Heap upvalues, ropes, arrays and maps given an arena object
+  ch_gc_list remembered;
+} ch_gc;
+
+#define CH_GC_SHOULD_STEP(context_ptr)                                         \
+  ((context_ptr)->gc.phase != CH_GC_IDLE ||                                    \
+   (context_ptr)->gc.bytes_allocated > (context_ptr)->gc.next_collection)
+
+// Write barrier for values stored into objects or globals
+#define CH_GC_BARRIER(context_ptr, value)                                      \
+  if ((context_ptr)->gc.phase == CH_GC_MARK) {                                 \
+    ch_gc_shade(&(context_ptr)->gc, value);                                    \
+  }
+
+#define CH_GC_IN_ARENA(value) (IS_OBJECT(value) && AS_OBJECT(value)->in_arena)
+
+// Write barrier for values stored into upvalues, which may have been
+// allocated before the arena. An upvalue already holding an arena object was
+// remembered when it was given it.
+#define CH_GC_UPVALUE_BARRIER(context_ptr, upvalue, value)                     \
+  CH_GC_BARRIER(context_ptr, value)                                            \
+  if (CH_GC_IN_ARENA(value) && !(upvalue)->object.in_arena &&                  \
+      !CH_GC_IN_ARENA((upvalue)->closed)) {                                    \
+    ch_gc_remember(&(context_ptr)->gc, (ch_object *)(upvalue));                \
+  }
+
+// Write barrier for values stored into arrays and maps. A heap container
+// given an arena object is only remembered once per call.
+#define CH_GC_CONTAINER_BARRIER(context_ptr, container, value)                 \
+  CH_GC_BARRIER(context_ptr, value)                                            \
+  if (CH_GC_IN_ARENA(value) && !(container)->object.in_arena &&                \
+      !(container)->remembered) {                                              \
+    (container)->remembered = true;                                            \
+    ch_gc_remember(&(context_ptr)->gc, (ch_object *)(container));              \
+  }
+
+void ch_gc_create(ch_gc *out_gc, ch_memory *memory);
+
+// Frees every object of the context, reachable or not
+void ch_gc_free(ch_context *context);
+
+// Allocates an object and links it into the context's objects list
+ch_object *ch_gc_allocate(ch_context *context, size_t size,
+                          ch_object_type type);
+
+// Allocates on the heap even while a call runs in the arena, for objects whose
+// memory the arena could not release
+ch_object *ch_gc_allocate_heap(ch_context *context, size_t size,
+                               ch_object_type type);
+
+// Accounts for memory owned by an object but allocated separately
+void ch_gc_track(ch_context *context, size_t size);
+
+// Allocates memory owned by an object, from the arena while a call runs in it.
+// Returns NULL and stops the program with EXIT_OUT_OF_MEMORY when the
+// allocator refuses, the memory limit is left to the caller.
+void *ch_gc_allocate_data(ch_context *context, size_t size);
+
+// Grows memory owned by an object from size to new_size bytes. It stays in
+// the arena or on the heap along with the object, whether a call runs in the
+// arena or not. Fails like ch_gc_allocate_data, data is left as it was then.
+void *ch_gc_grow_data(ch_context *context, ch_object *owner, void *data,
+                      size_t size, size_t new_size);
+
+// Frees memory from ch_gc_allocate_data that no object took ownership of
+void ch_gc_free_data(ch_context *context, void *data, size_t size);
+
+// Runs a slice of the current cycle, or a full collection when the collector
+// is not incremental
+void ch_gc_step(ch_context *context);
+
+// Turns a white object gray
+void ch_gc_shade(ch_gc *gc, ch_primitive value);
+
+// Records a heap object given an arena object while a call runs in the arena
+void ch_gc_remember(ch_gc *gc, ch_object *object);
+
+// Starts allocating in the arena, if arena mode is on
+void ch_gc_enterarena(ch_context *context);
+
+// Moves the arena objects that outlive the call to the heap, then resets the
+// arena
+void ch_gc_leavearena(ch_context *context);
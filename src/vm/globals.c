@@ -0,0 +1,82 @@
+#include "globals.h"
+#include <stdlib.h>
+
+#define GROW_CAPACITY(capacity) ((capacity) < 8 ? 8 : (capacity)*2)
+
+static void adjust_capacity(ch_globals *globals, uint32_t capacity) {
+  ch_memory *memory = globals->slots.memory;
+  uint32_t old_capacity = globals->capacity;
+  globals->values =
+      ch_memory_realloc(memory, globals->values,
+                        old_capacity * sizeof(ch_primitive),
+                        capacity * sizeof(ch_primitive));
+  globals->defined = ch_memory_realloc(memory, globals->defined,
+                                       old_capacity * sizeof(bool),
+                                       capacity * sizeof(bool));
+  globals->builtin = ch_memory_realloc(memory, globals->builtin,
+                                       old_capacity * sizeof(bool),
+                                       capacity * sizeof(bool));
+  globals->names = ch_memory_realloc(memory, globals->names,
+                                     old_capacity * sizeof(ch_string *),
+                                     capacity * sizeof(ch_string *));
+  globals->capacity = capacity;
+  globals->generation++;
+}
+
+void ch_globals_create(ch_globals *out_globals, uint32_t capacity,
+                       ch_memory *memory) {
+  out_globals->values = NULL;
+  out_globals->defined = NULL;
+  out_globals->builtin = NULL;
+  out_globals->names = NULL;
+  out_globals->size = 0;
+  out_globals->capacity = 0;
+  out_globals->generation = 0;
+  ch_table_create(&out_globals->slots, memory);
+
+  if (capacity > 0) {
+    adjust_capacity(out_globals, capacity);
+  }
+}
+
+void ch_globals_free(ch_globals *globals) {
+  ch_memory *memory = globals->slots.memory;
+  ch_memory_release(memory, globals->values,
+                    globals->capacity * sizeof(ch_primitive));
+  ch_memory_release(memory, globals->defined,
+                    globals->capacity * sizeof(bool));
+  ch_memory_release(memory, globals->builtin,
+                    globals->capacity * sizeof(bool));
+  ch_memory_release(memory, globals->names,
+                    globals->capacity * sizeof(ch_string *));
+  ch_table_free(&globals->slots);
+  ch_globals_create(globals, 0, memory);
+}
+
+bool ch_globals_find(ch_globals *globals, ch_string *name, uint32_t *out_slot) {
+  ch_primitive *slot = ch_table_get(&globals->slots, name);
+  if (slot == NULL)
+    return false;
+
+  *out_slot = (uint32_t)AS_NUMBER((*slot));
+  return true;
+}
+
+uint32_t ch_globals_declare(ch_globals *globals, ch_string *name) {
+  uint32_t slot;
+  if (ch_globals_find(globals, name, &slot))
+    return slot;
+
+  if (globals->size == globals->capacity) {
+    adjust_capacity(globals, GROW_CAPACITY(globals->capacity));
+  }
+
+  slot = globals->size++;
+  globals->values[slot] = MAKE_NULL();
+  globals->defined[slot] = false;
+  globals->builtin[slot] = false;
+  globals->names[slot] = name;
+  ch_table_set(&globals->slots, name, MAKE_NUMBER(slot));
+
+  return slot;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "object.h"
+#include "primitive.h"
+#include "table.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+  Globals live in a flat array of slots. The compiler gives every global
+  name a slot index and the program carries a directory of those names, so
+  compiled code indexes the array directly. The names table is only used to
+  resolve names coming from the host (natives, entry points).
+*/
+typedef struct {
+  ch_primitive *values;
+  // A slot exists as soon as its name is known, but it is only defined once
+  // the program or the host assigns it
+  bool *defined;
+  // Defined by the host, a script may define the name again to replace it
+  bool *builtin;
+  ch_string **names;
+  uint32_t size;
+  uint32_t capacity;
+  // Bumped every time the slots are reallocated
+  uint32_t generation;
+
+  // Name -> slot index
+  ch_table slots;
+} ch_globals;
+
+void ch_globals_create(ch_globals *out_globals, uint32_t capacity,
+                       ch_memory *memory);
+
+void ch_globals_free(ch_globals *globals);
+
+bool ch_globals_find(ch_globals *globals, ch_string *name, uint32_t *out_slot);
+
+// Finds the slot of a name, appending a new (undefined) slot if needed
+uint32_t ch_globals_declare(ch_globals *globals, ch_string *name);
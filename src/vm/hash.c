@@ -1,15 +1,163 @@
 #include "hash.h"
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
 
-const uint32_t fnv1a_prime = 0x01000193;
-const uint32_t fnv1a_seed = 0x811C9DC5;
+#if defined(__linux__)
+#include <sys/random.h>
+#endif
+
+/*
+  Word at a time hash of the wyhash family. Inputs of up to 16 bytes are read
+  as (overlapping) words with a fixed number of loads, longer inputs are
+  consumed 16 bytes per step, or 48 bytes per step over three independent
+  lanes. Every step folds two words with a full 64x64->128 bit multiply.
+
+  The seed is drawn from the operating system on the first hash, so that
+  scripts fed with untrusted strings cannot precompute keys that collide in
+  every process.
+*/
+
+static const uint64_t secret[4] = {0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+                                   0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull};
+
+static uint64_t hash_seed;
+static bool seeded = false;
+// Advanced by every ch_hash_salt
+static uint64_t salt_state;
+
+// Multiplies a and b, leaving the low half in a and the high half in b
+static inline void multiply(uint64_t *a, uint64_t *b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t product = (__uint128_t)*a * *b;
+  *a = (uint64_t)product;
+  *b = (uint64_t)(product >> 64);
+#else
+  uint64_t a_high = *a >> 32, a_low = (uint32_t)*a;
+  uint64_t b_high = *b >> 32, b_low = (uint32_t)*b;
+  uint64_t high = a_high * b_high, middle0 = a_high * b_low;
+  uint64_t middle1 = b_high * a_low, low = a_low * b_low;
+  uint64_t t = low + (middle0 << 32);
+  uint64_t carry = t < low;
+  uint64_t lo = t + (middle1 << 32);
+  carry += lo < t;
+  *a = lo;
+  *b = high + (middle0 >> 32) + (middle1 >> 32) + carry;
+#endif
+}
+
+static inline uint64_t mix(uint64_t a, uint64_t b) {
+  multiply(&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t read64(const uint8_t *bytes) {
+  uint64_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+static inline uint64_t read32(const uint8_t *bytes) {
+  uint32_t value;
+  memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+// Reads 1 to 3 bytes, all of them are covered
+static inline uint64_t read_small(const uint8_t *bytes, size_t n) {
+  return ((uint64_t)bytes[0] << 16) | ((uint64_t)bytes[n >> 1] << 8) |
+         bytes[n - 1];
+}
+
+// Falls back to what differs between runs when the system has no entropy
+// source we know of, the addresses vary with address space randomization
+static uint64_t random_seed(void) {
+  uint64_t seed;
+#if defined(__linux__)
+  if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) == sizeof(seed))
+    return seed;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) ||    \
+    defined(__NetBSD__)
+  arc4random_buf(&seed, sizeof(seed));
+  return seed;
+#endif
+  seed = mix((uint64_t)time(NULL) ^ secret[0], (uint64_t)clock() ^ secret[1]);
+  return mix(seed ^ (uint64_t)(uintptr_t)&seed,
+             (uint64_t)(uintptr_t)&random_seed ^ secret[2]);
+}
+
+void ch_hash_seed(uint64_t seed) {
+  hash_seed = seed;
+  salt_state = seed ^ secret[3];
+  seeded = true;
+}
+
+uint32_t ch_hash_salt(void) {
+  if (!seeded) {
+    ch_hash_seed(random_seed());
+  }
+
+  uint32_t salt;
+  do {
+    // splitmix64, the state is never exposed
+    uint64_t z = (salt_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    salt = (uint32_t)(z ^ (z >> 31));
+  } while (salt == 0);
+
+  return salt;
+}
 
 uint32_t ch_hash_string(const char *string, size_t n) {
-  uint32_t hash = fnv1a_seed;
+  if (!seeded) {
+    ch_hash_seed(random_seed());
+  }
+
+  const uint8_t *bytes = (const uint8_t *)string;
+  uint64_t seed = hash_seed;
+  uint64_t a, b;
+
+  if (n <= 16) {
+    if (n >= 4) {
+      size_t middle = (n >> 3) << 2;
+      a = (read32(bytes) << 32) | read32(bytes + middle);
+      b = (read32(bytes + n - 4) << 32) | read32(bytes + n - 4 - middle);
+    } else if (n > 0) {
+      a = read_small(bytes, n);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t left = n;
+    if (left > 48) {
+      uint64_t lane1 = seed, lane2 = seed;
+      do {
+        seed = mix(read64(bytes) ^ secret[1], read64(bytes + 8) ^ seed);
+        lane1 = mix(read64(bytes + 16) ^ secret[2], read64(bytes + 24) ^ lane1);
+        lane2 = mix(read64(bytes + 32) ^ secret[3], read64(bytes + 40) ^ lane2);
+        bytes += 48;
+        left -= 48;
+      } while (left > 48);
+      seed ^= lane1 ^ lane2;
+    }
 
-  while (n--) {
-    hash = (*string ^ hash) * fnv1a_prime;
-    string++;
+    while (left > 16) {
+      seed = mix(read64(bytes) ^ secret[1], read64(bytes + 8) ^ seed);
+      bytes += 16;
+      left -= 16;
+    }
+
+    // The last 16 bytes, which may overlap the previous step
+    a = read64(bytes + left - 16);
+    b = read64(bytes + left - 8);
   }
 
-  return hash;
-}
\ No newline at end of file
+  a ^= secret[1];
+  b ^= seed;
+  multiply(&a, &b);
+  uint64_t hash = mix(a ^ secret[0] ^ n, b ^ secret[1]);
+
+  return (uint32_t)(hash ^ (hash >> 32));
+}
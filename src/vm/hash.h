@@ -2,4 +2,13 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-uint32_t ch_hash_string(const char *string, size_t n);
\ No newline at end of file
+// Shared by the compiler and the VM, so their tables agree on every string.
+// Seeded once per process, see ch_hash_seed.
+uint32_t ch_hash_string(const char *string, size_t n);
+
+// Replaces the random seed picked on the first hash, for reproducible runs.
+// Hashes are never recomputed, so no hashed string may be in use.
+void ch_hash_seed(uint64_t seed);
+
+// A random nonzero value derived from the seed, distinct on every call
+uint32_t ch_hash_salt(void);
\ No newline at end of file
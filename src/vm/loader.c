@@ -0,0 +1,347 @@
+#include "loader.h"
+#include "bytecode.h"
+#include <inttypes.h>
+#include <string.h>
+
+#define NO_INSTRUCTION UINT32_MAX
+
+typedef struct {
+  ch_context *context;
+  const ch_program *program;
+
+  const uint8_t *bytecode;
+  size_t bytecode_size;
+
+  // Maps the byte offset of each instruction (relative to the bytecode
+  // section) to the index of its first word in the decoded stream
+  uint32_t *offsets;
+  ch_code *code;
+} ch_loader;
+
+static uint32_t decoded_size(const uint8_t *instruction) {
+  switch (*instruction) {
+  case OP_CLOSURE:
+    // Opcode, upvalue count, then one word per upvalue
+    return 2 + READ_ARGCOUNT(instruction + 1);
+  case OP_FUNCTION:
+    return 3;
+  case OP_SET_GLOBAL:
+  case OP_DEFINE_GLOBAL:
+  case OP_LOAD_GLOBAL:
+    return 1 + CH_GLOBAL_SITE_SIZE;
+  case OP_MAP_GET:
+  case OP_MAP_SET:
+    return 1 + CH_MAP_SITE_SIZE;
+  case OP_POPN:
+  case OP_NUMBER:
+  case OP_STRING:
+  case OP_CHAR:
+  case OP_LOAD_LOCAL:
+  case OP_SET_LOCAL:
+  case OP_SET_GLOBAL_SLOT:
+  case OP_DEFINE_GLOBAL_SLOT:
+  case OP_LOAD_GLOBAL_SLOT:
+  case OP_LOAD_UPVALUE:
+  case OP_SET_UPVALUE:
+  case OP_CALL:
+  case OP_CONCATN:
+  case OP_ARRAY:
+  case OP_JMP:
+  case OP_JMP_FALSE:
+    return 2;
+  default:
+    return 1;
+  }
+}
+
+static bool load_error(ch_loader *loader, ch_exit exit, const char *message,
+                       uint32_t offset) {
+  ch_runtime_error(loader->context, exit, "%s (at bytecode offset %" PRIu32 ").",
+                   message, offset);
+  return false;
+}
+
+// Resolves a byte offset in the bytecode section to a decoded instruction.
+// The end of the bytecode section resolves to the trailing halt.
+static ch_code *resolve(ch_loader *loader, int64_t offset) {
+  if (offset < 0 || (size_t)offset > loader->bytecode_size)
+    return NULL;
+
+  uint32_t index = loader->offsets[offset];
+  if (index == NO_INSTRUCTION)
+    return NULL;
+
+  return &loader->code[index];
+}
+
+static bool load_string(ch_loader *loader, const uint8_t *operand,
+                        ch_code *out) {
+  ch_dataptr ptr = READ_U32(operand);
+  ch_constants *constants = loader->context->constants;
+  ch_string *constant = ch_constants_get(constants, ptr);
+
+  // Only the first context sharing the pool has to materialize the string
+  if (constant == NULL) {
+    if ((size_t)ptr + sizeof(uint32_t) > loader->program->data_size)
+      return false;
+
+    ch_bytecode_string string = ch_bytecode_load_string(loader->program, ptr);
+    if (ptr + sizeof(uint32_t) + string.size > loader->program->data_size)
+      return false;
+
+    constant = ch_constants_add(constants, ptr, string.value, string.size);
+  }
+
+  // Interned so that strings built at runtime resolve to the constant
+  ch_table_set(&loader->context->strings, constant, MAKE_NULL());
+  out->string = constant;
+  return true;
+}
+
+static bool load_number(ch_loader *loader, const uint8_t *operand,
+                        ch_code *out) {
+  ch_dataptr ptr = READ_U32(operand);
+  if ((size_t)ptr + sizeof(double) > loader->program->data_size)
+    return false;
+
+  // The data section gives no alignment guarantees
+  memcpy(&out->number, &loader->program->start[ptr], sizeof(double));
+  return true;
+}
+
+// Declares a slot for every name of the globals directory, in order
+static bool load_globals(ch_loader *loader) {
+  const ch_program *program = loader->program;
+  size_t directory_size = (size_t)program->globals_count * sizeof(ch_dataptr);
+  if ((size_t)program->globals_ptr + directory_size > program->data_size)
+    return load_error(loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                      "Globals directory exceeds data section",
+                      program->globals_ptr);
+
+  for (uint32_t i = 0; i < program->globals_count; i++) {
+    ch_code name;
+    const uint8_t *entry =
+        &program->start[program->globals_ptr + i * sizeof(ch_dataptr)];
+    if (!load_string(loader, entry, &name))
+      return load_error(loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                        "Global name exceeds data section", program->globals_ptr);
+
+    if (ch_globals_declare(&loader->context->globals, name.string) != i)
+      return load_error(loader, EXIT_GLOBAL_ALREADY_EXISTS,
+                        "Global name is declared twice in directory",
+                        program->globals_ptr);
+  }
+
+  return true;
+}
+
+// First pass, validates every instruction and lays out the decoded stream
+static bool map_offsets(ch_loader *loader, uint32_t *out_size) {
+  const uint8_t *end = loader->bytecode + loader->bytecode_size;
+  uint32_t size = 0;
+
+  for (size_t i = 0; i <= loader->bytecode_size; i++) {
+    loader->offsets[i] = NO_INSTRUCTION;
+  }
+
+  const uint8_t *instruction = loader->bytecode;
+  while (instruction < end) {
+    uint32_t offset = instruction - loader->bytecode;
+    size_t instruction_size;
+    if (!ch_bytecode_instruction_size(instruction, end, &instruction_size) ||
+        *instruction == OP_NATIVE) {
+      return load_error(loader, EXIT_UNKNOWN_INSTRUCTION,
+                        "Unknown or truncated instruction", offset);
+    }
+
+    loader->offsets[offset] = size;
+    size += decoded_size(instruction);
+    instruction += instruction_size;
+  }
+
+  loader->offsets[loader->bytecode_size] = size;
+  *out_size = size + 1;
+  return true;
+}
+
+// Second pass, writes the opcode and operand words of every instruction
+static bool decode(ch_loader *loader) {
+  const uint8_t *end = loader->bytecode + loader->bytecode_size;
+  const uint8_t *instruction = loader->bytecode;
+
+  while (instruction < end) {
+    uint32_t offset = instruction - loader->bytecode;
+    size_t instruction_size;
+    ch_bytecode_instruction_size(instruction, end, &instruction_size);
+
+    ch_code *code = &loader->code[loader->offsets[offset]];
+    const uint8_t *operand = instruction + 1;
+    code->op = *instruction;
+
+    switch (*instruction) {
+    case OP_NUMBER: {
+      if (!load_number(loader, operand, &code[1]))
+        return load_error(loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                          "Number constant exceeds data section", offset);
+      break;
+    }
+    case OP_STRING: {
+      if (!load_string(loader, operand, &code[1]))
+        return load_error(loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                          "String constant exceeds data section", offset);
+      break;
+    }
+    case OP_SET_GLOBAL:
+    case OP_DEFINE_GLOBAL:
+    case OP_LOAD_GLOBAL: {
+      if (!load_string(loader, operand, &code[1]))
+        return load_error(loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                          "String constant exceeds data section", offset);
+
+      // Empty inline cache
+      code[2].global = NULL;
+      code[3].index = 0;
+      break;
+    }
+    case OP_MAP_GET:
+    case OP_MAP_SET: {
+      if (!load_string(loader, operand, &code[1]))
+        return load_error(loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                          "String constant exceeds data section", offset);
+
+      // Empty inline cache, checked against the slot's key before use
+      code[2].index = 0;
+      break;
+    }
+    case OP_SET_GLOBAL_SLOT:
+    case OP_DEFINE_GLOBAL_SLOT:
+    case OP_LOAD_GLOBAL_SLOT: {
+      code[1].index = READ_U32(operand);
+      if (code[1].index >= loader->program->globals_count)
+        return load_error(loader, EXIT_GLOBAL_NOT_FOUND,
+                          "Global slot exceeds globals directory", offset);
+      break;
+    }
+    case OP_CHAR: {
+      code[1].character = (char)*operand;
+      break;
+    }
+    case OP_POPN:
+    case OP_LOAD_LOCAL:
+    case OP_SET_LOCAL: {
+      code[1].index = READ_U32(operand);
+      break;
+    }
+    case OP_LOAD_UPVALUE:
+    case OP_SET_UPVALUE:
+    case OP_ARRAY:
+    case OP_CALL: {
+      code[1].index = READ_ARGCOUNT(operand);
+      break;
+    }
+    case OP_CONCATN: {
+      code[1].index = READ_ARGCOUNT(operand);
+      if (code[1].index < 2)
+        return load_error(loader, EXIT_UNKNOWN_INSTRUCTION,
+                          "Concatenation needs at least two operands", offset);
+      break;
+    }
+    case OP_JMP:
+    case OP_JMP_FALSE: {
+      // Jumps are relative to the end of the instruction
+      int64_t target =
+          (int64_t)offset + instruction_size + READ_JMPPTR(operand);
+      code[1].target = resolve(loader, target);
+      if (code[1].target == NULL)
+        return load_error(loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                          "Jump pointer exceeds bounds of program", offset);
+      break;
+    }
+    case OP_FUNCTION: {
+      ch_code *entry = resolve(loader, READ_U32(operand));
+      if (entry == NULL)
+        return load_error(loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                          "Function pointer exceeds bounds of program",
+                          offset);
+
+      code[1].index = entry - loader->code;
+      code[2].index = READ_ARGCOUNT(operand + sizeof(ch_dataptr));
+      break;
+    }
+    case OP_CLOSURE: {
+      ch_argcount upvalue_count = READ_ARGCOUNT(operand);
+      code[1].index = upvalue_count;
+
+      const uint8_t *upvalue = operand + sizeof(ch_argcount);
+      for (ch_argcount i = 0; i < upvalue_count; i++) {
+        code[2 + i].upvalue.is_local = upvalue[0];
+        code[2 + i].upvalue.index = upvalue[1];
+        upvalue += 2 * sizeof(ch_argcount);
+      }
+      break;
+    }
+    default:
+      break;
+    }
+
+    instruction += instruction_size;
+  }
+
+  return true;
+}
+
+bool ch_loader_load(ch_context *context) {
+  const ch_program *program = &context->program;
+  ch_loader loader = {
+      .context = context,
+      .program = program,
+      .bytecode = program->start + program->data_size,
+      .bytecode_size = program->total_size - program->data_size,
+      .code = NULL,
+  };
+
+  size_t offsets_size = (loader.bytecode_size + 1) * sizeof(*loader.offsets);
+  loader.offsets = ch_memory_alloc(context->memory, offsets_size);
+
+  uint32_t code_size = 0;
+  bool loaded = load_globals(&loader) && map_offsets(&loader, &code_size);
+  if (loaded) {
+    loader.code = ch_memory_alloc(context->memory, code_size * sizeof(ch_code));
+    // Returning from the outermost call lands on this halt
+    loader.code[code_size - 1].op = OP_HALT;
+    loaded = decode(&loader);
+  }
+
+  ch_code *entry = NULL;
+  if (loaded) {
+    entry = resolve(&loader, program->program_start_ptr);
+    if (entry == NULL)
+      loaded = load_error(&loader, EXIT_INVALID_INSTRUCTION_POINTER,
+                          "Program entry exceeds bounds of program",
+                          program->program_start_ptr);
+  }
+
+  ch_memory_release(context->memory, loader.offsets, offsets_size);
+
+  if (!loaded) {
+    ch_memory_release(context->memory, loader.code,
+                      code_size * sizeof(ch_code));
+    context->code = NULL;
+    context->code_size = 0;
+    context->pcurrent = NULL;
+    return false;
+  }
+
+  context->code = loader.code;
+  context->code_size = code_size;
+  context->pcurrent = entry;
+  return true;
+}
+
+void ch_loader_free(ch_context *context) {
+  ch_memory_release(context->memory, context->code,
+                    context->code_size * sizeof(ch_code));
+  context->code = NULL;
+  context->code_size = 0;
+  context->pcurrent = NULL;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "chapman.h"
+
+/*
+  Translates the program's bytecode into the context's pre-decoded
+  instruction stream. Jump targets become absolute, number operands are
+  read from the data section and string operands are resolved through the
+  context's constant pool. Malformed bytecode is reported as a runtime error and leaves the
+  context halted.
+*/
+bool ch_loader_load(ch_context *context);
+
+void ch_loader_free(ch_context *context);
@@ -0,0 +1,99 @@
+#include "memory.h"
+#include <stdlib.h>
+
+static void *default_alloc(void *user, size_t size) {
+  (void)user;
+  return malloc(size);
+}
+
+static void *default_realloc(void *user, void *pointer, size_t old_size,
+                             size_t new_size) {
+  (void)user;
+  (void)old_size;
+  return realloc(pointer, new_size);
+}
+
+static void default_free(void *user, void *pointer, size_t size) {
+  (void)user;
+  (void)size;
+  free(pointer);
+}
+
+ch_allocator ch_default_allocator(void) {
+  return (ch_allocator){
+      .alloc = default_alloc,
+      .realloc = default_realloc,
+      .free = default_free,
+      .user = NULL,
+  };
+}
+
+ch_memory *ch_memory_create(ch_allocator allocator) {
+  ch_memory *memory = allocator.alloc(allocator.user, sizeof(ch_memory));
+  memory->allocator = allocator;
+  memory->live_bytes = 0;
+  memory->peak_bytes = 0;
+  memory->limit = 0;
+
+  return memory;
+}
+
+void ch_memory_free(ch_memory *memory) {
+  ch_allocator allocator = memory->allocator;
+  allocator.free(allocator.user, memory, sizeof(ch_memory));
+}
+
+static void account(ch_memory *memory, size_t old_size, size_t new_size) {
+  memory->live_bytes = memory->live_bytes - old_size + new_size;
+  if (memory->live_bytes > memory->peak_bytes) {
+    memory->peak_bytes = memory->live_bytes;
+  }
+}
+
+bool ch_memory_canallocate(ch_memory *memory, size_t size) {
+  if (memory == NULL || memory->limit == 0)
+    return true;
+
+  return memory->live_bytes <= memory->limit &&
+         size <= memory->limit - memory->live_bytes;
+}
+
+void *ch_memory_alloc(ch_memory *memory, size_t size) {
+  if (memory == NULL)
+    return malloc(size);
+
+  void *pointer = memory->allocator.alloc(memory->allocator.user, size);
+  if (pointer != NULL) {
+    account(memory, 0, size);
+  }
+  return pointer;
+}
+
+void *ch_memory_realloc(ch_memory *memory, void *pointer, size_t old_size,
+                        size_t new_size) {
+  if (memory == NULL)
+    return realloc(pointer, new_size);
+
+  void *grown =
+      pointer == NULL
+          ? memory->allocator.alloc(memory->allocator.user, new_size)
+          : memory->allocator.realloc(memory->allocator.user, pointer,
+                                      old_size, new_size);
+  if (grown != NULL) {
+    account(memory, old_size, new_size);
+  }
+  return grown;
+}
+
+void ch_memory_release(ch_memory *memory, void *pointer, size_t size) {
+  if (pointer == NULL)
+    return;
+
+  if (memory == NULL) {
+    free(pointer);
+    return;
+  }
+
+  account(memory, size, 0);
+  memory->allocator.free(memory->allocator.user, pointer, size);
+}
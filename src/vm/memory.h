@@ -0,0 +1,57 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+  Every allocation of the compiler and of a context goes through an
+  allocator given by the host. Sizes are passed back on realloc and free, so
+  that allocators do not need to store them.
+*/
+typedef struct {
+  void *(*alloc)(void *user, size_t size);
+  void *(*realloc)(void *user, void *pointer, size_t old_size,
+                   size_t new_size);
+  void (*free)(void *user, void *pointer, size_t size);
+  void *user;
+} ch_allocator;
+
+typedef struct {
+  size_t live_bytes;
+  size_t peak_bytes;
+  size_t limit;
+} ch_memory_stats;
+
+// An allocator and the bytes allocated through it, for one context or one
+// compilation. Functions taking a NULL account use the system allocator and
+// count nothing.
+typedef struct {
+  ch_allocator allocator;
+  size_t live_bytes;
+  size_t peak_bytes;
+  // 0 means no limit
+  size_t limit;
+} ch_memory;
+
+#define CH_MEMORY_EXCEEDED(memory)                                             \
+  ((memory)->limit != 0 && (memory)->live_bytes > (memory)->limit)
+
+// Wraps malloc, realloc and free
+ch_allocator ch_default_allocator(void);
+
+// The account itself is allocated with the allocator, but not counted
+ch_memory *ch_memory_create(ch_allocator allocator);
+
+void ch_memory_free(ch_memory *memory);
+
+// Whether size more bytes stay within the limit. Allocations do not check
+// it themselves, callers ask before allocating what a script sized.
+bool ch_memory_canallocate(ch_memory *memory, size_t size);
+
+// Returns NULL when the allocator refuses, nothing is counted then
+void *ch_memory_alloc(ch_memory *memory, size_t size);
+
+// Returns NULL when the allocator refuses, pointer is left as it was
+void *ch_memory_realloc(ch_memory *memory, void *pointer, size_t old_size,
+                        size_t new_size);
+
+void ch_memory_release(ch_memory *memory, void *pointer, size_t size);
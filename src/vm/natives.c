@@ -1,11 +1,36 @@
 #include "natives.h"
 #include "type_check.h"
+#include "search.h"
+#include "vector.h"
+#include <string.h>
 
-void ch_native_string_size(ch_context* vm, ch_argcount argcount) {
+// Strings of the built-in natives may be slices, which are only read up to
+// their size
+static bool pop_text(ch_context* vm, ch_string** popped) {
+	return ch_checktext(vm, ch_pop(vm), popped);
+}
+
+void ch_native_size(ch_context* vm, ch_argcount argcount) {
 	if (!ch_checkargcount(vm, 1, argcount)) return;
 
+	ch_primitive value = ch_pop(vm);
+	if (IS_OBJECT(value) && IS_ARRAY(AS_OBJECT(value))) {
+		ch_push(vm, MAKE_NUMBER(AS_ARRAY(AS_OBJECT(value))->count));
+		return;
+	}
+
+	if (IS_OBJECT(value) && IS_F64ARRAY(AS_OBJECT(value))) {
+		ch_push(vm, MAKE_NUMBER(AS_F64ARRAY(AS_OBJECT(value))->count));
+		return;
+	}
+
+	if (IS_OBJECT(value) && IS_MAP(AS_OBJECT(value))) {
+		ch_push(vm, MAKE_NUMBER(AS_MAP(AS_OBJECT(value))->table.size));
+		return;
+	}
+
 	ch_string* string;
-	if (!ch_popstring(vm, &string)) return;
+	if (!ch_checktext(vm, value, &string)) return;
 
 	ch_push(vm, MAKE_NUMBER(string->size));
 }
@@ -24,7 +49,7 @@ void ch_native_string_substring(ch_context* vm, ch_argcount argcount) {
 	if (!ch_popnumber(vm, &start)) return;
 
 	ch_string* string;
-	if (!ch_popstring(vm, &string)) return;
+	if (!pop_text(vm, &string)) return;
 
 	ch_string* result = ch_substring(vm, string, (size_t) start, has_end ? end : string->size);
 	if (result != NULL) {
@@ -38,11 +63,306 @@ void ch_native_string_contains(ch_context* vm, ch_argcount argcount) {
 	if (!ch_checkargcount(vm, 2, argcount)) return;
 
 	ch_string* needle;
-	if(!ch_popstring(vm, &needle)) return;
+	if(!pop_text(vm, &needle)) return;
 
 	ch_string* haystack;
-	if(!ch_popstring(vm, &haystack)) return;
+	if(!pop_text(vm, &haystack)) return;
 
 	bool contains = ch_containsstring(vm, haystack, needle);
 	ch_push(vm, MAKE_BOOLEAN(contains));
+}
+
+void ch_native_string_indexof(ch_context* vm, ch_argcount argcount) {
+	if (argcount != 2 && argcount != 3) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Incorrect number of arguments passed to indexOf.");
+		return;
+	}
+
+	double start = 0;
+	if (argcount == 3 && !ch_popnumber(vm, &start)) return;
+
+	ch_string* needle;
+	if (!pop_text(vm, &needle)) return;
+
+	ch_string* haystack;
+	if (!pop_text(vm, &haystack)) return;
+
+	if (start < 0 || start > haystack->size) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "IndexOf start index is out of range.");
+		return;
+	}
+
+	size_t offset = (size_t) start;
+	size_t index = ch_search_first(haystack->value + offset, haystack->size - offset, needle->value, needle->size);
+	ch_push(vm, MAKE_NUMBER(index == CH_SEARCH_NOT_FOUND ? -1 : (double) (offset + index)));
+}
+
+void ch_native_string_lastindexof(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 2, argcount)) return;
+
+	ch_string* needle;
+	if (!pop_text(vm, &needle)) return;
+
+	ch_string* haystack;
+	if (!pop_text(vm, &haystack)) return;
+
+	size_t index = ch_search_last(haystack->value, haystack->size, needle->value, needle->size);
+	ch_push(vm, MAKE_NUMBER(index == CH_SEARCH_NOT_FOUND ? -1 : (double) index));
+}
+
+void ch_native_string_count(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 2, argcount)) return;
+
+	ch_string* needle;
+	if (!pop_text(vm, &needle)) return;
+
+	ch_string* haystack;
+	if (!pop_text(vm, &haystack)) return;
+
+	// The empty string is found between every two characters
+	if (needle->size == 0) {
+		ch_push(vm, MAKE_NUMBER(haystack->size + 1));
+		return;
+	}
+
+	size_t count = 0;
+	size_t position = 0;
+	for (;;) {
+		size_t index = ch_search_first(haystack->value + position, haystack->size - position, needle->value, needle->size);
+		if (index == CH_SEARCH_NOT_FOUND) break;
+
+		count++;
+		position += index + needle->size;
+	}
+
+	ch_push(vm, MAKE_NUMBER(count));
+}
+
+void ch_native_string_split(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 2, argcount)) return;
+
+	ch_string* separator;
+	if (!pop_text(vm, &separator)) return;
+
+	ch_string* string;
+	if (!pop_text(vm, &string)) return;
+
+	if (separator->size == 0) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Split separator cannot be empty.");
+		return;
+	}
+
+	// Nothing collects while a native runs, the fields need no other root
+	ch_array* fields = ch_loadarray(vm, NULL, 0);
+	size_t start = 0;
+	for (;;) {
+		size_t end = ch_search_first(string->value + start, string->size - start, separator->value, separator->size);
+		end = end == CH_SEARCH_NOT_FOUND ? string->size : start + end;
+
+		// Fields share the storage of the string, except for empty ones
+		ch_string* field = end > start ? ch_substring(vm, string, start, end) : ch_loadstring(vm, "", 0, NOCOPY_STRING);
+		if (!ch_arraypush(vm, fields, MAKE_OBJECT(field))) return;
+
+		if (end == string->size) break;
+		start = end + separator->size;
+	}
+
+	ch_push(vm, MAKE_OBJECT(fields));
+}
+void ch_native_numbers(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 1, argcount)) return;
+
+	ch_primitive value = ch_pop(vm);
+	if (IS_NUMBER(value)) {
+		double size = AS_NUMBER(value);
+		if (!(size >= 0 && size <= UINT32_MAX) || size != (uint32_t) size) {
+			ch_runtime_error(vm, EXIT_USER_ERROR, "Numeric array size must be a whole number.");
+			return;
+		}
+
+		// Refused with EXIT_OUT_OF_MEMORY when it would go over the limit
+		ch_f64array* numbers = ch_loadf64array(vm, (uint32_t) size);
+		if (numbers == NULL) return;
+
+		ch_push(vm, MAKE_OBJECT(numbers));
+		return;
+	}
+
+	if (IS_OBJECT(value) && IS_F64ARRAY(AS_OBJECT(value))) {
+		ch_f64array* source = AS_F64ARRAY(AS_OBJECT(value));
+		ch_f64array* copy = ch_loadf64array(vm, source->count);
+		if (copy == NULL) return;
+
+		if (source->count > 0) {
+			memcpy(copy->values, source->values, source->count * sizeof(double));
+		}
+
+		ch_push(vm, MAKE_OBJECT(copy));
+		return;
+	}
+
+	if (!IS_OBJECT(value) || !IS_ARRAY(AS_OBJECT(value))) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Expected a size or an array of numbers.");
+		return;
+	}
+
+	ch_array* array = AS_ARRAY(AS_OBJECT(value));
+	for (uint32_t i = 0; i < array->count; i++) {
+		if (!IS_NUMBER(array->values[i])) {
+			ch_runtime_error(vm, EXIT_USER_ERROR, "Array element %u is not a number.", i);
+			return;
+		}
+	}
+
+	ch_f64array* numbers = ch_loadf64array(vm, array->count);
+	if (numbers == NULL) return;
+
+	for (uint32_t i = 0; i < array->count; i++) {
+		numbers->values[i] = AS_NUMBER(array->values[i]);
+	}
+
+	ch_push(vm, MAKE_OBJECT(numbers));
+}
+
+void ch_native_numbers_sum(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 1, argcount)) return;
+
+	ch_f64array* numbers;
+	if (!ch_checkf64array(vm, ch_pop(vm), &numbers)) return;
+
+	ch_push(vm, MAKE_NUMBER(ch_vector_sum(numbers->values, numbers->count)));
+}
+
+void ch_native_numbers_min(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 1, argcount)) return;
+
+	ch_f64array* numbers;
+	if (!ch_checkf64array(vm, ch_pop(vm), &numbers)) return;
+
+	if (numbers->count == 0) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Cannot take the minimum of an empty array.");
+		return;
+	}
+
+	ch_push(vm, MAKE_NUMBER(ch_vector_min(numbers->values, numbers->count)));
+}
+
+void ch_native_numbers_max(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 1, argcount)) return;
+
+	ch_f64array* numbers;
+	if (!ch_checkf64array(vm, ch_pop(vm), &numbers)) return;
+
+	if (numbers->count == 0) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Cannot take the maximum of an empty array.");
+		return;
+	}
+
+	ch_push(vm, MAKE_NUMBER(ch_vector_max(numbers->values, numbers->count)));
+}
+
+void ch_native_numbers_dot(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 2, argcount)) return;
+
+	ch_f64array* right;
+	if (!ch_checkf64array(vm, ch_pop(vm), &right)) return;
+
+	ch_f64array* left;
+	if (!ch_checkf64array(vm, ch_pop(vm), &left)) return;
+
+	if (left->count != right->count) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Dot product of arrays of sizes %u and %u.", left->count, right->count);
+		return;
+	}
+
+	ch_push(vm, MAKE_NUMBER(ch_vector_dot(left->values, right->values, left->count)));
+}
+
+void ch_native_numbers_scale(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 2, argcount)) return;
+
+	double factor;
+	if (!ch_popnumber(vm, &factor)) return;
+
+	ch_f64array* numbers;
+	if (!ch_checkf64array(vm, ch_pop(vm), &numbers)) return;
+
+	ch_vector_scale(numbers->values, numbers->count, factor);
+	ch_push(vm, MAKE_OBJECT(numbers));
+}
+
+void ch_native_numbers_accumulate(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 2, argcount)) return;
+
+	ch_f64array* addend;
+	if (!ch_checkf64array(vm, ch_pop(vm), &addend)) return;
+
+	ch_f64array* numbers;
+	if (!ch_checkf64array(vm, ch_pop(vm), &numbers)) return;
+
+	if (numbers->count != addend->count) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Cannot add an array of size %u to one of size %u.", addend->count, numbers->count);
+		return;
+	}
+
+	ch_vector_add(numbers->values, addend->values, numbers->count);
+	ch_push(vm, MAKE_OBJECT(numbers));
+}
+
+void ch_native_numbers_prefixsum(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 1, argcount)) return;
+
+	ch_f64array* numbers;
+	if (!ch_checkf64array(vm, ch_pop(vm), &numbers)) return;
+
+	ch_vector_prefix_sum(numbers->values, numbers->count);
+	ch_push(vm, MAKE_OBJECT(numbers));
+}
+
+static bool push_keys(ch_context* vm, ch_array* keys, ch_table_slots* slots) {
+	for (uint32_t i = 0; i < slots->capacity; i++) {
+		if (CH_TABLE_IN_USE(slots, i) && !ch_arraypush(vm, keys, MAKE_OBJECT((ch_object*) slots->keys[i]))) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ch_native_map_keys(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 1, argcount)) return;
+
+	ch_map* map;
+	if (!ch_checkmap(vm, ch_pop(vm), &map)) return;
+
+	ch_array* keys = ch_loadarray(vm, NULL, 0);
+	if (!push_keys(vm, keys, &map->table.slots) || !push_keys(vm, keys, &map->table.old)) return;
+	ch_push(vm, MAKE_OBJECT(keys));
+}
+
+void ch_native_map_has(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 2, argcount)) return;
+
+	ch_string* key;
+	if (!pop_text(vm, &key)) return;
+
+	ch_map* map;
+	if (!ch_checkmap(vm, ch_pop(vm), &map)) return;
+
+	ch_push(vm, MAKE_BOOLEAN(ch_mapfind(vm, map, (ch_object*) key) != NULL));
+}
+
+void ch_native_map_remove(ch_context* vm, ch_argcount argcount) {
+	if (!ch_checkargcount(vm, 2, argcount)) return;
+
+	ch_string* key;
+	if (!pop_text(vm, &key)) return;
+
+	ch_map* map;
+	if (!ch_checkmap(vm, ch_pop(vm), &map)) return;
+
+	// Only interned texts can be keys
+	ch_string* interned = ch_table_find_string(&vm->strings, key->value, key->size);
+	bool removed = interned != NULL && ch_mapdelete(vm, map, interned);
+	ch_push(vm, MAKE_BOOLEAN(removed));
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #pragma once
 #include "chapman.h"
 
-void ch_native_string_size(ch_context* vm, ch_argcount argcount);
+/*
+	size(string) Number of characters
+	size(array) Number of elements
+	size(map) Number of keys
+*/
+void ch_native_size(ch_context* vm, ch_argcount argcount);
 /*
 	substring(string, start)
 	substring(string, start, end) End is exclusive
@@ -10,4 +15,68 @@ void ch_native_string_substring(ch_context* vm, ch_argcount argcount);
 /*
 	contains(string, substring)
 */
-void ch_native_string_contains(ch_context* vm, ch_argcount argcount);
\ No newline at end of file
+void ch_native_string_contains(ch_context* vm, ch_argcount argcount);
+/*
+	indexOf(string, substring)
+	indexOf(string, substring, start) Searches from start on
+	Returns -1 when substring is not found
+*/
+void ch_native_string_indexof(ch_context* vm, ch_argcount argcount);
+/*
+	lastIndexOf(string, substring)
+	Returns -1 when substring is not found
+*/
+void ch_native_string_lastindexof(ch_context* vm, ch_argcount argcount);
+/*
+	count(string, substring) Counts occurrences that do not overlap
+*/
+void ch_native_string_count(ch_context* vm, ch_argcount argcount);
+/*
+	split(string, separator) Returns an array of the fields between separators
+*/
+void ch_native_string_split(ch_context* vm, ch_argcount argcount);
+/*
+	numbers(size) Numeric array of size zeros
+	numbers(array) Numeric array with the elements of an array of numbers, or a copy of a numeric array
+*/
+void ch_native_numbers(ch_context* vm, ch_argcount argcount);
+/*
+	sum(numbers)
+*/
+void ch_native_numbers_sum(ch_context* vm, ch_argcount argcount);
+/*
+	min(numbers) NaN if any element is NaN, the array cannot be empty
+*/
+void ch_native_numbers_min(ch_context* vm, ch_argcount argcount);
+/*
+	max(numbers) NaN if any element is NaN, the array cannot be empty
+*/
+void ch_native_numbers_max(ch_context* vm, ch_argcount argcount);
+/*
+	dot(numbers, numbers) Both arrays have the same size
+*/
+void ch_native_numbers_dot(ch_context* vm, ch_argcount argcount);
+/*
+	scale(numbers, factor) Multiplies every element in place, returns the array
+*/
+void ch_native_numbers_scale(ch_context* vm, ch_argcount argcount);
+/*
+	accumulate(numbers, addend) Adds an array of the same size in place, returns the first array
+*/
+void ch_native_numbers_accumulate(ch_context* vm, ch_argcount argcount);
+/*
+	prefixSum(numbers) Replaces every element by the sum of the elements up to it, returns the array
+*/
+void ch_native_numbers_prefixsum(ch_context* vm, ch_argcount argcount);
+/*
+	keys(map) Array of the keys, in no particular order
+*/
+void ch_native_map_keys(ch_context* vm, ch_argcount argcount);
+/*
+	has(map, key)
+*/
+void ch_native_map_has(ch_context* vm, ch_argcount argcount);
+/*
+	remove(map, key) Whether the key was in the map
+*/
+void ch_native_map_remove(ch_context* vm, ch_argcount argcount);
\ No newline at end of file
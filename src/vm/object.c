@@ -1,13 +1,35 @@
 #include "object.h"
 #include "chapman.h"
+#include "gc.h"
 #include "hash.h"
+#include "search.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static ch_string *new_string(const char *value, size_t size) {
-  ch_string *string = (ch_string *)malloc(sizeof(ch_string));
+// Capacity of an array's storage after its first growth
+#define ARRAY_MIN_CAPACITY 8
+
+// Storage sized by the script must fit under the limit before it is allocated
+static bool can_allocate(ch_context *vm, size_t size) {
+  if (ch_memory_canallocate(vm->memory, size))
+    return true;
+
+  ch_runtime_error(vm, EXIT_OUT_OF_MEMORY,
+                   "Allocating %zu bytes would exceed the memory limit of %zu bytes.",
+                   size, vm->memory->limit);
+  return false;
+}
+
+static ch_string *new_string(ch_context *vm, const char *value, size_t size,
+                             bool owns_value) {
+  ch_string *string = (ch_string *)ch_gc_allocate(vm, sizeof(ch_string), TYPE_STRING);
   ch_initstring(string, value, size);
+  string->owns_value = owns_value;
+  if (owns_value) {
+    ch_gc_track(vm, size + 1);
+  }
 
   return string;
 }
@@ -17,43 +39,44 @@ static ch_string *new_string(const char *value, size_t size) {
 static ch_string *register_allocated_string(ch_context* vm, char* value, size_t size) {
   ch_string *interned_string = ch_table_find_string(&vm->strings, value, size);
   if (interned_string != NULL) {
-    free(value);
+    ch_gc_free_data(vm, value, size + 1);
     return interned_string;
   }
 
-  ch_string *string = new_string(value, size);
+  ch_string *string = new_string(vm, value, size, true);
   ch_table_set(&vm->strings, string, MAKE_NULL());
 
   return string;
 }
 
-ch_function *ch_loadfunction(ch_dataptr function_ptr, ch_argcount argcount) {
-  ch_function *function = malloc(sizeof(ch_function));
-  function->object.type = TYPE_FUNCTION;
+ch_function *ch_loadfunction(ch_context *vm, ch_dataptr function_ptr,
+                             ch_argcount argcount) {
+  ch_function *function = (ch_function *)ch_gc_allocate(vm, sizeof(ch_function), TYPE_FUNCTION);
   function->argcount = argcount;
   function->ptr = function_ptr;
 
   return function;
 }
 
-ch_closure *ch_loadclosure(ch_function* function, uint8_t upvalue_count) {
-  ch_upvalue** upvalues = malloc(sizeof(ch_upvalue*) * upvalue_count);
+ch_closure *ch_loadclosure(ch_context *vm, ch_function *function,
+                           uint8_t upvalue_count) {
+  ch_upvalue** upvalues = ch_gc_allocate_data(vm, sizeof(ch_upvalue*) * upvalue_count);
   for(uint8_t i = 0; i < upvalue_count; i++) {
     upvalues[i] = NULL;
   }
+  ch_gc_track(vm, sizeof(ch_upvalue*) * upvalue_count);
 
-  ch_closure *closure = malloc(sizeof(ch_closure));
+  ch_closure *closure = (ch_closure *)ch_gc_allocate(vm, sizeof(ch_closure), TYPE_CLOSURE);
+  CH_GC_BARRIER(vm, MAKE_OBJECT(function));
   closure->function = function;
-  closure->object.type = TYPE_CLOSURE;
   closure->upvalues = upvalues;
   closure->upvalue_count = upvalue_count;
 
   return closure;
 }
 
-ch_upvalue *ch_loadupvalue(ch_primitive* value) {
-  ch_upvalue *upvalue = malloc(sizeof(ch_upvalue));
-  upvalue->object.type = TYPE_UPVALUE;
+ch_upvalue *ch_loadupvalue(ch_context *vm, ch_primitive *value) {
+  ch_upvalue *upvalue = (ch_upvalue *)ch_gc_allocate(vm, sizeof(ch_upvalue), TYPE_UPVALUE);
   upvalue->value = value;
   upvalue->next = NULL;
   upvalue->closed = MAKE_NULL();
@@ -61,14 +84,162 @@ ch_upvalue *ch_loadupvalue(ch_primitive* value) {
   return upvalue;
 }
 
-ch_native *ch_loadnative(ch_native_function function) {
-  ch_native *native = malloc(sizeof(ch_native));
+ch_native *ch_loadnative(ch_context *vm, ch_native_function function) {
+  ch_native *native = (ch_native *)ch_gc_allocate(vm, sizeof(ch_native), TYPE_NATIVE);
   native->function = function;
-  native->object.type = TYPE_NATIVE;
 
   return native;
 }
 
+ch_array *ch_loadarray(ch_context *vm, const ch_primitive *values,
+                       uint32_t count) {
+  ch_primitive *storage = NULL;
+  if (count > 0) {
+    size_t values_size = count * sizeof(ch_primitive);
+    if (!can_allocate(vm, values_size))
+      return NULL;
+
+    storage = ch_gc_allocate_data(vm, values_size);
+    if (storage == NULL)
+      return NULL;
+    ch_gc_track(vm, values_size);
+  }
+
+  ch_array *array = (ch_array *)ch_gc_allocate(vm, sizeof(ch_array), TYPE_ARRAY);
+  array->values = storage;
+  array->count = count;
+  array->capacity = count;
+  array->remembered = false;
+
+  for (uint32_t i = 0; i < count; i++) {
+    CH_GC_BARRIER(vm, values[i]);
+    array->values[i] = values[i];
+  }
+
+  return array;
+}
+
+bool ch_arraypush(ch_context *vm, ch_array *array, ch_primitive value) {
+  if (array->count == array->capacity) {
+    uint32_t capacity = array->capacity < ARRAY_MIN_CAPACITY ? ARRAY_MIN_CAPACITY : array->capacity * 2;
+    size_t size = array->capacity * sizeof(ch_primitive);
+    size_t new_size = capacity * sizeof(ch_primitive);
+    if (!can_allocate(vm, new_size - size))
+      return false;
+
+    ch_primitive *values = ch_gc_grow_data(vm, &array->object, array->values, size, new_size);
+    if (values == NULL)
+      return false;
+
+    array->values = values;
+    array->capacity = capacity;
+  }
+
+  CH_GC_CONTAINER_BARRIER(vm, array, value);
+  array->values[array->count++] = value;
+  return true;
+}
+
+ch_f64array *ch_loadf64array(ch_context *vm, uint32_t count) {
+  double *storage = NULL;
+  if (count > 0) {
+    size_t values_size = count * sizeof(double);
+    if (!can_allocate(vm, values_size))
+      return NULL;
+
+    storage = ch_gc_allocate_data(vm, values_size);
+    if (storage == NULL)
+      return NULL;
+    ch_gc_track(vm, values_size);
+    memset(storage, 0, values_size);
+  }
+
+  ch_f64array *array = (ch_f64array *)ch_gc_allocate(vm, sizeof(ch_f64array), TYPE_F64ARRAY);
+  array->values = storage;
+  array->count = count;
+  array->capacity = count;
+
+  return array;
+}
+
+bool ch_f64arraypush(ch_context *vm, ch_f64array *array, double value) {
+  if (array->count == array->capacity) {
+    uint32_t capacity = array->capacity < ARRAY_MIN_CAPACITY ? ARRAY_MIN_CAPACITY : array->capacity * 2;
+    size_t size = array->capacity * sizeof(double);
+    size_t new_size = capacity * sizeof(double);
+    if (!can_allocate(vm, new_size - size))
+      return false;
+
+    double *values = ch_gc_grow_data(vm, &array->object, array->values, size, new_size);
+    if (values == NULL)
+      return false;
+
+    array->values = values;
+    array->capacity = capacity;
+  }
+
+  array->values[array->count++] = value;
+  return true;
+}
+
+ch_map *ch_loadmap(ch_context *vm) {
+  ch_map *map = (ch_map *)ch_gc_allocate_heap(vm, sizeof(ch_map), TYPE_MAP);
+  ch_table_create(&map->table, vm->gc.memory);
+  map->remembered = false;
+  return map;
+}
+
+// The table allocates and releases slots on its own, the collector is told
+// about the difference
+static void track_table(ch_context *vm, ch_map *map, size_t footprint) {
+  vm->gc.bytes_allocated += ch_table_footprint(&map->table);
+  vm->gc.bytes_allocated -= footprint;
+}
+
+// Only a new key grows the slots, which is rare enough to look the key up
+bool ch_mapset(ch_context *vm, ch_map *map, ch_string *key, ch_primitive value) {
+  size_t growth = ch_table_growth(&map->table);
+  bool grows = growth != 0 && ch_table_get(&map->table, key) == NULL;
+  if (grows && !can_allocate(vm, growth))
+    return false;
+
+  ch_primitive key_value = MAKE_OBJECT((ch_object *)key);
+  CH_GC_CONTAINER_BARRIER(vm, map, key_value);
+  CH_GC_CONTAINER_BARRIER(vm, map, value);
+
+  size_t footprint = ch_table_footprint(&map->table);
+  bool inserted = ch_table_set(&map->table, key, value);
+  track_table(vm, map, footprint);
+
+  if (grows && !inserted) {
+    ch_runtime_error(vm, EXIT_OUT_OF_MEMORY, "Could not allocate %zu bytes.", growth);
+    return false;
+  }
+  return true;
+}
+
+bool ch_mapdelete(ch_context *vm, ch_map *map, ch_string *key) {
+  size_t footprint = ch_table_footprint(&map->table);
+  bool deleted = ch_table_delete(&map->table, key);
+  track_table(vm, map, footprint);
+  return deleted;
+}
+
+// A text that was never interned cannot be a key yet
+ch_primitive *ch_mapfind(ch_context *vm, ch_map *map, ch_object *text) {
+  ch_string *flat = ch_flatten(vm, text);
+  if (flat == NULL)
+    return NULL;
+
+  ch_string *key = ch_table_find_string(&vm->strings, flat->value, flat->size);
+  return key == NULL ? NULL : ch_table_get(&map->table, key);
+}
+
+ch_string *ch_mapkey(ch_context *vm, ch_object *text) {
+  ch_string *flat = ch_flatten(vm, text);
+  return flat == NULL ? NULL : ch_internstring(vm, flat);
+}
+
 ch_string *ch_loadstring(ch_context *vm, const char *value, size_t size,
                          bool copy_string) {
   ch_string *interned_string = ch_table_find_string(&vm->strings, value, size);
@@ -79,14 +250,14 @@ ch_string *ch_loadstring(ch_context *vm, const char *value, size_t size,
 
   const char *final_value = value;
   if (copy_string) {
-    char *copied_string = malloc(size + 1);
+    char *copied_string = ch_gc_allocate_data(vm, size + 1);
     memcpy(copied_string, value, size);
     copied_string[size] = '\0';
 
     final_value = copied_string;
   }
 
-  ch_string *string = new_string(final_value, size);
+  ch_string *string = new_string(vm, final_value, size, copy_string);
   ch_table_set(&vm->strings, string, MAKE_NULL());
 
   return string;
@@ -94,7 +265,13 @@ ch_string *ch_loadstring(ch_context *vm, const char *value, size_t size,
 
 ch_string *ch_concatstring(ch_context *vm, ch_string* left, ch_string* right) {
   size_t size = left->size + right->size;
-  char *value = (char*) malloc(size + 1);
+  if (!can_allocate(vm, size + 1))
+    return NULL;
+
+  char *value = (char*) ch_gc_allocate_data(vm, size + 1);
+  if (value == NULL)
+    return NULL;
+
   memcpy(value, left->value, left->size);
   memcpy(value + left->size, right->value, right->size);
   value[size] = '\0';
@@ -102,26 +279,202 @@ ch_string *ch_concatstring(ch_context *vm, ch_string* left, ch_string* right) {
   return register_allocated_string(vm, value, size);
 }
 
-ch_string *ch_substring(ch_context *vm, ch_string* target, size_t start, size_t end) {
-  if (end <= start || start >= target->size || end > target->size) return NULL;
-  size_t size = end - start;
-  char *value = (char*) malloc(size + 1);
-  memcpy(value, &target->value[start], size);
+static uint32_t text_size(ch_object *text) {
+  return IS_STRING(text) ? AS_STRING(text)->size : AS_ROPE(text)->size;
+}
+
+static uint32_t text_depth(ch_object *text) {
+  return IS_STRING(text) ? 0 : AS_ROPE(text)->depth;
+}
+
+ch_object *ch_concat(ch_context *vm, ch_object *left, ch_object *right) {
+  size_t size = (size_t)text_size(left) + text_size(right);
+  if (size > UINT32_MAX) {
+    ch_runtime_error(vm, EXIT_OUT_OF_MEMORY, "Text of %zu characters is too long.", size);
+    return NULL;
+  }
+
+  if (size < CH_ROPE_MIN_SIZE) {
+    return (ch_object *)ch_concatstring(vm, ch_flatten(vm, left), ch_flatten(vm, right));
+  }
+
+  ch_rope *rope = (ch_rope *)ch_gc_allocate(vm, sizeof(ch_rope), TYPE_ROPE);
+  CH_GC_BARRIER(vm, MAKE_OBJECT(left));
+  CH_GC_BARRIER(vm, MAKE_OBJECT(right));
+  rope->left = left;
+  rope->right = right;
+  rope->flat = NULL;
+  rope->size = size;
+
+  uint32_t depth = text_depth(left) > text_depth(right) ? text_depth(left) : text_depth(right);
+  rope->depth = depth + 1;
+
+  return (ch_object *)rope;
+}
+
+static bool is_short_string(ch_object *text) {
+  return IS_STRING(text) && AS_STRING(text)->size < CH_ROPE_MIN_SIZE;
+}
+
+// Copies a run of strings into a single string of exact size
+static ch_string *join_strings(ch_context *vm, ch_object **strings, uint32_t count, size_t size) {
+  if (!can_allocate(vm, size + 1))
+    return NULL;
+
+  char *value = (char*) ch_gc_allocate_data(vm, size + 1);
+  if (value == NULL)
+    return NULL;
+
+  size_t position = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    ch_string *string = AS_STRING(strings[i]);
+    memcpy(&value[position], string->value, string->size);
+    position += string->size;
+  }
   value[size] = '\0';
 
   return register_allocated_string(vm, value, size);
 }
 
-bool ch_containsstring(ch_context *vm, ch_string* haystack, ch_string* needle) {
-  if (needle->size > haystack->size) return false;
+ch_object *ch_concatn(ch_context *vm, ch_object **texts, uint32_t count) {
+  ch_object *result = NULL;
+  uint32_t i = 0;
+
+  while (i < count) {
+    ch_object *part = texts[i];
+    uint32_t run_end = i + 1;
+
+    // Short strings are joined without interning any intermediate result.
+    // Ropes and long strings are kept as they are, so that appending to a
+    // long text in a loop still shares it instead of copying it every time.
+    if (is_short_string(part)) {
+      size_t size = AS_STRING(part)->size;
+      while (run_end < count && is_short_string(texts[run_end])) {
+        size += AS_STRING(texts[run_end])->size;
+        run_end++;
+      }
+
+      if (run_end - i > 1) {
+        part = (ch_object *)join_strings(vm, &texts[i], run_end - i, size);
+        if (part == NULL)
+          return NULL;
+      }
+    }
+
+    result = result == NULL ? part : ch_concat(vm, result, part);
+    if (result == NULL)
+      return NULL;
+    i = run_end;
+  }
+
+  return result;
+}
+
+static ch_string *new_slice(ch_context *vm, ch_string *parent, size_t offset, size_t size) {
+  ch_string *slice = (ch_string *)ch_gc_allocate(vm, sizeof(ch_string), TYPE_STRING);
+  CH_GC_BARRIER(vm, MAKE_OBJECT(parent));
+  slice->value = &parent->value[offset];
+  slice->size = size;
+  // Hashed when interned, slices never are
+  slice->hash = 0;
+  slice->owns_value = false;
+  slice->parent = parent;
+  slice->offset = offset;
+
+  return slice;
+}
+
+ch_string *ch_flatten(ch_context *vm, ch_object *text) {
+  if (IS_STRING(text)) return AS_STRING(text);
+
+  ch_rope *rope = AS_ROPE(text);
+  if (rope->flat != NULL) return rope->flat;
+
+  if (!can_allocate(vm, rope->size + 1))
+    return NULL;
+
+  char *value = (char*) ch_gc_allocate_data(vm, rope->size + 1);
+  if (value == NULL)
+    return NULL;
+  value[rope->size] = '\0';
+
+  // Filled from the end, so that the ropes built by appending in a loop only
+  // ever have one part pending. Every expanded rope adds one pending part and
+  // its parts are shallower, so the list never holds more than depth + 1.
+  size_t pending_size = (rope->depth + 1) * sizeof(ch_object*);
+  ch_object **pending = ch_memory_alloc(vm->memory, pending_size);
+  if (pending == NULL) {
+    ch_gc_free_data(vm, value, rope->size + 1);
+    ch_runtime_error(vm, EXIT_OUT_OF_MEMORY, "Could not allocate %zu bytes.", pending_size);
+    return NULL;
+  }
+  size_t pending_count = 0;
+  size_t position = rope->size;
 
-  return strstr(haystack->value, needle->value) != NULL;
+  pending[pending_count++] = text;
+  while (pending_count > 0) {
+    ch_object *part = pending[--pending_count];
+    ch_string *string = NULL;
+
+    if (IS_STRING(part)) {
+      string = AS_STRING(part);
+    } else if (AS_ROPE(part)->flat != NULL) {
+      string = AS_ROPE(part)->flat;
+    } else {
+      pending[pending_count++] = AS_ROPE(part)->left;
+      pending[pending_count++] = AS_ROPE(part)->right;
+      continue;
+    }
+
+    position -= string->size;
+    memcpy(&value[position], string->value, string->size);
+  }
+
+  ch_memory_release(vm->memory, pending, pending_size);
+
+  ch_string *flat = register_allocated_string(vm, value, rope->size);
+  CH_GC_BARRIER(vm, MAKE_OBJECT(flat));
+  if (vm->gc.arena_active && !rope->object.in_arena && flat->object.in_arena) {
+    ch_gc_remember(&vm->gc, (ch_object*)rope);
+  }
+
+  rope->flat = flat;
+  rope->left = NULL;
+  rope->right = NULL;
+
+  return flat;
+}
+
+ch_string *ch_internstring(ch_context *vm, ch_string *string) {
+  if (string->parent == NULL) return string;
+
+  return ch_loadstring(vm, string->value, string->size, COPY_STRING);
+}
+
+ch_string *ch_substring(ch_context *vm, ch_string* target, size_t start, size_t end) {
+  if (end <= start || start >= target->size || end > target->size) return NULL;
+  if (start == 0 && end == target->size) return target;
+
+  // Slices of slices share the storage of the original string
+  if (target->parent != NULL) {
+    return new_slice(vm, target->parent, target->offset + start, end - start);
+  }
+
+  return new_slice(vm, target, start, end - start);
+}
+
+bool ch_containsstring(ch_context *vm, ch_string* haystack, ch_string* needle) {
+  // Either string may be a slice, neither is expected to be terminated
+  return ch_search_first(haystack->value, haystack->size, needle->value, needle->size) != CH_SEARCH_NOT_FOUND;
 }
 
 void ch_initstring(ch_string *string, const char *value, size_t size) {
   string->value = value;
   string->size = size;
   string->hash = ch_hash_string(value, size);
+  string->owns_value = false;
+  string->parent = NULL;
+  string->offset = 0;
   string->object.type = TYPE_STRING;
 }
 
@@ -132,6 +485,14 @@ bool ch_object_isfalsy(ch_object* object) {
       return false;
     case TYPE_STRING:
       return AS_STRING(object)->size == 0;
+    case TYPE_ROPE:
+      return AS_ROPE(object)->size == 0;
+    case TYPE_ARRAY:
+      return AS_ARRAY(object)->count == 0;
+    case TYPE_F64ARRAY:
+      return AS_F64ARRAY(object)->count == 0;
+    case TYPE_MAP:
+      return AS_MAP(object)->table.size == 0;
     default:
       return false;
   }
@@ -157,7 +518,28 @@ void ch_object_print(ch_object* object) {
       break;
     }
     case TYPE_STRING: {
-      printf("STRING %s", AS_STRING(object)->value);
+      printf("STRING %.*s", (int)AS_STRING(object)->size, AS_STRING(object)->value);
+      break;
+    }
+    case TYPE_ROPE: {
+      ch_rope *rope = AS_ROPE(object);
+      if (rope->flat != NULL) {
+        printf("STRING %s", rope->flat->value);
+      } else {
+        printf("ROPE of size %" PRIu32, rope->size);
+      }
+      break;
+    }
+    case TYPE_ARRAY: {
+      printf("ARRAY of size %" PRIu32, AS_ARRAY(object)->count);
+      break;
+    }
+    case TYPE_F64ARRAY: {
+      printf("F64ARRAY of size %" PRIu32, AS_F64ARRAY(object)->count);
+      break;
+    }
+    case TYPE_MAP: {
+      printf("MAP of size %" PRIu32, AS_MAP(object)->table.size);
       break;
     }
   }
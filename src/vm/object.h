@@ -1,6 +1,7 @@
 #pragma once
 #include "defs.h"
 #include "primitive.h"
+#include "table.h"
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -8,6 +9,7 @@
 
 #define AS_STRING(object) ((ch_string *)object)
 #define IS_STRING(object) (OBJECT_TYPE(object) == TYPE_STRING)
+#define IS_SLICE(object) (IS_STRING(object) && AS_STRING(object)->parent != NULL)
 
 #define AS_FUNCTION(object) ((ch_function *)object)
 #define IS_FUNCTION(object) (OBJECT_TYPE(object) == TYPE_FUNCTION)
@@ -19,6 +21,23 @@
 #define AS_CLOSURE(object) ((ch_closure *)object)
 #define IS_CLOSURE(object) (OBJECT_TYPE(object) == TYPE_CLOSURE)
 
+#define AS_ROPE(object) ((ch_rope *)object)
+#define IS_ROPE(object) (OBJECT_TYPE(object) == TYPE_ROPE)
+// Strings and ropes are both text, see ch_flatten
+#define IS_TEXT(object) (IS_STRING(object) || IS_ROPE(object))
+
+// Concatenations shorter than this build a flat string right away
+#define CH_ROPE_MIN_SIZE 64
+
+#define AS_ARRAY(object) ((ch_array *)object)
+#define IS_ARRAY(object) (OBJECT_TYPE(object) == TYPE_ARRAY)
+
+#define AS_F64ARRAY(object) ((ch_f64array *)object)
+#define IS_F64ARRAY(object) (OBJECT_TYPE(object) == TYPE_F64ARRAY)
+
+#define AS_MAP(object) ((ch_map *)object)
+#define IS_MAP(object) (OBJECT_TYPE(object) == TYPE_MAP)
+
 #define AS_NATIVE(object) ((ch_native *)object)
 #define IS_NATIVE(object) (OBJECT_TYPE(object) == TYPE_NATIVE)
 #define MAKE_NATIVE(native_function)                                           \
@@ -34,6 +53,10 @@ typedef enum {
   TYPE_UPVALUE,
   TYPE_NATIVE,
   TYPE_STRING,
+  TYPE_ROPE,
+  TYPE_ARRAY,
+  TYPE_F64ARRAY,
+  TYPE_MAP,
 } ch_object_type;
 
 typedef struct ch_context ch_context;
@@ -41,13 +64,26 @@ typedef void (*ch_native_function)(ch_context *context, ch_argcount argcount);
 
 typedef struct ch_object {
   ch_object_type type;
+  // Set by the collector while marking. Objects that are not owned by a
+  // context (constants) always stay marked.
+  bool marked;
+  // Allocated in the context's arena, see ch_gc
+  bool in_arena;
+  // Next object allocated by the same context
+  struct ch_object *next;
 } ch_object;
 
-typedef struct {
+typedef struct ch_string {
   ch_object object;
   const char *value;
   uint32_t size;
   uint32_t hash;
+  // Whether value was allocated for this string and is freed along with it
+  bool owns_value;
+  // Set for slices, whose value points into the parent's from offset on. A
+  // slice is not terminated, hashed or interned, see ch_internstring.
+  struct ch_string *parent;
+  uint32_t offset;
 } ch_string;
 
 typedef struct {
@@ -76,20 +112,127 @@ typedef struct {
   ch_native_function function;
 } ch_native;
 
-ch_function *ch_loadfunction(ch_dataptr function_ptr, ch_argcount argcount);
+/*
+  The concatenation of two texts, which are only copied into a string (and
+  hashed, and interned) once a flat string is needed. Appending in a loop
+  therefore stays linear instead of copying the whole text every time.
+*/
+typedef struct {
+  ch_object object;
+  // Strings or ropes, both NULL once the rope is flattened
+  ch_object *left;
+  ch_object *right;
+  ch_string *flat;
+  uint32_t size;
+  // Longest path to a string, bounds the work list used for flattening
+  uint32_t depth;
+} ch_rope;
+
+/*
+  Values stored one after the other. The storage doubles whenever it is full,
+  so appending is amortized O(1), and lives wherever the array does (the
+  context's arena or the heap), see ch_gc_grow_data.
+*/
+typedef struct {
+  ch_object object;
+  ch_primitive *values;
+  uint32_t count;
+  uint32_t capacity;
+  // Set while the collector remembers the array, see CH_GC_CONTAINER_BARRIER
+  bool remembered;
+} ch_array;
+
+/*
+  Numbers stored as raw doubles, without the tag of a primitive, for the
+  kernels in vector.h. It grows like ch_array, but holds no references: the
+  collector never traces it and stores need no barrier.
+*/
+typedef struct {
+  ch_object object;
+  double *values;
+  uint32_t count;
+  uint32_t capacity;
+} ch_f64array;
+
+/*
+  Values by interned string key, see ch_mapkey. The slots are allocated
+  separately from the map and the arena could not release them as the table
+  grows, so maps always live on the heap and are remembered like arrays once
+  they hold arena objects.
+*/
+typedef struct {
+  ch_object object;
+  ch_table table;
+  // Set while the collector remembers the map, see CH_GC_CONTAINER_BARRIER
+  bool remembered;
+} ch_map;
+
+ch_function *ch_loadfunction(ch_context *vm, ch_dataptr function_ptr,
+                             ch_argcount argcount);
+
+ch_closure *ch_loadclosure(ch_context *vm, ch_function *function,
+                           uint8_t upvalue_count);
+
+ch_upvalue *ch_loadupvalue(ch_context *vm, ch_primitive *value);
+
+ch_native *ch_loadnative(ch_context *vm, ch_native_function function);
+
+/*
+  Storage for elements, map slots and text is sized by the script. It is
+  refused when it would go over the memory limit, or when the allocator has
+  none left, with a runtime error. The functions below return NULL or false
+  then.
+*/
+
+// An array holding a copy of the count values
+ch_array *ch_loadarray(ch_context *vm, const ch_primitive *values,
+                       uint32_t count);
+
+bool ch_arraypush(ch_context *vm, ch_array *array, ch_primitive value);
+
+// A numeric array of count zeros
+ch_f64array *ch_loadf64array(ch_context *vm, uint32_t count);
 
-ch_closure *ch_loadclosure(ch_function* function, uint8_t upvalue_count);
+bool ch_f64arraypush(ch_context *vm, ch_f64array *array, double value);
 
-ch_upvalue *ch_loadupvalue(ch_primitive* value);
+ch_map *ch_loadmap(ch_context *vm);
 
-ch_native *ch_loadnative(ch_native_function function);
+// Key must be interned
+bool ch_mapset(ch_context *vm, ch_map *map, ch_string *key, ch_primitive value);
+
+// Returns whether the key was in the map
+bool ch_mapdelete(ch_context *vm, ch_map *map, ch_string *key);
+
+// The value under a text, NULL when the map does not have it or the text
+// could not be flattened
+ch_primitive *ch_mapfind(ch_context *vm, ch_map *map, ch_object *text);
+
+// The interned string a text is stored under in maps
+ch_string *ch_mapkey(ch_context *vm, ch_object *text);
 
 ch_string *ch_loadstring(ch_context *vm, const char *value, size_t size,
                          bool copy_string);
 
 ch_string *ch_concatstring(ch_context *vm, ch_string* left, ch_string* right);
 
-// end is inclusive, so if the string has length n, the max end value is n - 1
+// Concatenates two texts, into a rope unless the result is short. Raises a
+// runtime error and returns NULL when the result would be too long.
+ch_object *ch_concat(ch_context *vm, ch_object *left, ch_object *right);
+
+// Concatenates count texts left to right. Runs of short strings are copied
+// once into a string of exact size, anything longer is joined with ch_concat.
+// Returns NULL when ch_concat fails.
+ch_object *ch_concatn(ch_context *vm, ch_object **texts, uint32_t count);
+
+// Returns a string with the content of a text, which is only a slice when the
+// text is one. A rope keeps the result and lets go of its parts.
+ch_string *ch_flatten(ch_context *vm, ch_object *text);
+
+// Returns the interned string with the same content, for strings that are used
+// for their identity. Only slices are copied.
+ch_string *ch_internstring(ch_context *vm, ch_string *string);
+
+// end is exclusive. The result is a slice sharing the storage of target.
 ch_string *ch_substring(ch_context *vm, ch_string* target, size_t start, size_t end);
 
 bool ch_containsstring(ch_context *vm, ch_string* haystack, ch_string* needle);
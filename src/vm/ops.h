@@ -14,6 +14,13 @@ typedef enum {
   OP_SUBONE,
   OP_MUL,
   OP_DIV,
+  OP_CONCATN, // Adds the top n values, either all numbers or all strings
+  // Emitted when the compiler knows the types of both operands, no checks
+  OP_ADD_NUM,
+  OP_SUB_NUM,
+  OP_MUL_NUM,
+  OP_DIV_NUM,
+  OP_CONCAT_STR,
 
   OP_STRING,
   OP_FALSE,
@@ -21,6 +28,15 @@ typedef enum {
   OP_CHAR,
   OP_NULL,
 
+  OP_ARRAY, // Builds an array of the top n values
+  OP_ARRAY_PUSH, // Appends the top value to the array below it, which stays
+  OP_INDEX_GET,
+  OP_INDEX_SET, // Stores the top value at the index below it, pops all three
+  OP_MAP, // Builds an empty map
+  // Members by constant key, followed by the key and an inline cache
+  OP_MAP_GET,
+  OP_MAP_SET, // Stores the top value in the map below it, which stays
+
   OP_LOAD_LOCAL,
   OP_SET_LOCAL,
   OP_LOAD_UPVALUE,
@@ -29,6 +45,10 @@ typedef enum {
   OP_SET_GLOBAL,
   OP_DEFINE_GLOBAL,
   OP_LOAD_GLOBAL,
+  // Globals addressed by the slot index assigned at compile time
+  OP_SET_GLOBAL_SLOT,
+  OP_DEFINE_GLOBAL_SLOT,
+  OP_LOAD_GLOBAL_SLOT,
 
   OP_BEGIN, // Tells the VM that it may invoke the main function (ex. after all globals are setup)
   OP_CALL,
@@ -42,4 +62,4 @@ typedef enum {
   OP_NATIVE,
 
   NUMBER_OF_OPCODES,
-} ch_op;
\ No newline at end of file
+} ch_op;
\ No newline at end of file
@@ -2,17 +2,17 @@
 #include "object.h"
 
 bool ch_primitive_isfalsy(const ch_primitive value) {
-	switch(value.type) {
+	switch(PRIMITIVE_TYPE(value)) {
 		case PRIMITIVE_BOOLEAN:
-			return !value.boolean_value;
+			return !AS_BOOLEAN(value);
 		case PRIMITIVE_NUMBER:
-			return value.number_value == 0;
+			return AS_NUMBER(value) == 0;
 		case PRIMITIVE_NULL:
 			return true;
 		case PRIMITIVE_OBJECT:
 			return ch_object_isfalsy(AS_OBJECT(value));
 		case PRIMITIVE_CHAR: 
-			return value.char_value == '\0';
+			return AS_CHAR(value) == '\0';
 		default:
 			return false;
 	}
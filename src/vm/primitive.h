@@ -1,30 +1,19 @@
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
-#define AS_NUMBER(p) (p.number_value)
-#define IS_NUMBER(p) (p.type == PRIMITIVE_NUMBER)
-#define MAKE_NUMBER(value)                                                     \
-  ((ch_primitive){.number_value = (double)(value), .type = PRIMITIVE_NUMBER})
-
-#define AS_BOOLEAN(p) (p.boolean_value)
-#define IS_BOOLEAN(p) (p.type == PRIMITIVE_BOOLEAN)
-#define MAKE_BOOLEAN(value)                                                    \
-  ((ch_primitive){.boolean_value = value, .type = PRIMITIVE_BOOLEAN})
-
-#define IS_NULL(p) (p.type == PRIMITIVE_NULL)
-#define MAKE_NULL() ((ch_primitive){.type = PRIMITIVE_NULL})
-
-#define AS_OBJECT(p) (p.object_value)
-#define IS_OBJECT(p) (p.type == PRIMITIVE_OBJECT)
-#define MAKE_OBJECT(value)                                                     \
-  ((ch_primitive){.object_value = (ch_object *)(value),                        \
-                  .type = PRIMITIVE_OBJECT})
-
-#define AS_CHAR(p) (p.char_value)
-#define IS_CHAR(p) (p.type == PRIMITIVE_CHAR)
-#define MAKE_CHAR(value)                                                     \
-  ((ch_primitive){.char_value = (value),                        \
-                  .type = PRIMITIVE_CHAR})
+/*
+  With CH_NAN_BOXING, a primitive is a single 64-bit word instead of a tagged
+  struct. Numbers are stored as plain doubles. Every other type is hidden in
+  the payload of a quiet NaN: objects set the sign bit and keep their 48-bit
+  address in the low bits, while null, booleans and chars use the bits below
+  the NaN. Code that only goes through the macros below works with both
+  layouts.
+*/
+#ifndef CH_NAN_BOXING
+#define CH_NAN_BOXING 0
+#endif
 
 typedef struct ch_object ch_object;
 
@@ -36,6 +25,78 @@ typedef enum {
   PRIMITIVE_CHAR
 } ch_primitive_type;
 
+#if CH_NAN_BOXING
+
+typedef struct {
+  uint64_t bits;
+} ch_primitive;
+
+#define CH_SIGN_BIT ((uint64_t)0x8000000000000000)
+#define CH_QNAN ((uint64_t)0x7ffc000000000000)
+#define CH_TAG_MASK (CH_SIGN_BIT | CH_QNAN | (uint64_t)0x0003000000000000)
+#define CH_TAG_CHAR (CH_QNAN | (uint64_t)0x0001000000000000)
+
+#define CH_NULL_BITS (CH_QNAN | 1)
+#define CH_FALSE_BITS (CH_QNAN | 2)
+#define CH_TRUE_BITS (CH_QNAN | 3)
+
+static inline ch_primitive ch_primitive_frombits(uint64_t bits) {
+  return (ch_primitive){.bits = bits};
+}
+
+static inline ch_primitive ch_primitive_fromnumber(double value) {
+  ch_primitive primitive;
+  memcpy(&primitive.bits, &value, sizeof(double));
+  return primitive;
+}
+
+static inline double ch_primitive_tonumber(ch_primitive primitive) {
+  double value;
+  memcpy(&value, &primitive.bits, sizeof(double));
+  return value;
+}
+
+#define AS_NUMBER(p) (ch_primitive_tonumber(p))
+#define IS_NUMBER(p) (((p).bits & CH_QNAN) != CH_QNAN)
+#define MAKE_NUMBER(value) (ch_primitive_fromnumber((double)(value)))
+
+#define AS_BOOLEAN(p) ((p).bits == CH_TRUE_BITS)
+#define IS_BOOLEAN(p) (((p).bits | 1) == CH_TRUE_BITS)
+#define MAKE_BOOLEAN(value)                                                    \
+  (ch_primitive_frombits((value) ? CH_TRUE_BITS : CH_FALSE_BITS))
+
+#define IS_NULL(p) ((p).bits == CH_NULL_BITS)
+#define MAKE_NULL() (ch_primitive_frombits(CH_NULL_BITS))
+
+#define AS_OBJECT(p)                                                           \
+  ((ch_object *)(uintptr_t)((p).bits & ~(CH_SIGN_BIT | CH_QNAN)))
+#define IS_OBJECT(p) (((p).bits & (CH_SIGN_BIT | CH_QNAN)) == (CH_SIGN_BIT | CH_QNAN))
+#define MAKE_OBJECT(value)                                                     \
+  (ch_primitive_frombits(CH_SIGN_BIT | CH_QNAN |                               \
+                         (uint64_t)(uintptr_t)(ch_object *)(value)))
+
+#define AS_CHAR(p) ((char)((p).bits & 0xff))
+#define IS_CHAR(p) (((p).bits & CH_TAG_MASK) == CH_TAG_CHAR)
+#define MAKE_CHAR(value)                                                       \
+  (ch_primitive_frombits(CH_TAG_CHAR | (uint8_t)(value)))
+
+static inline ch_primitive_type ch_primitive_type_of(ch_primitive primitive) {
+  if (IS_NUMBER(primitive))
+    return PRIMITIVE_NUMBER;
+  if (IS_OBJECT(primitive))
+    return PRIMITIVE_OBJECT;
+  if (IS_CHAR(primitive))
+    return PRIMITIVE_CHAR;
+  if (IS_NULL(primitive))
+    return PRIMITIVE_NULL;
+
+  return PRIMITIVE_BOOLEAN;
+}
+
+#define PRIMITIVE_TYPE(p) (ch_primitive_type_of(p))
+
+#else
+
 typedef struct {
   ch_primitive_type type;
   union {
@@ -46,4 +107,33 @@ typedef struct {
   };
 } ch_primitive;
 
+#define PRIMITIVE_TYPE(p) ((p).type)
+
+#define AS_NUMBER(p) ((p).number_value)
+#define IS_NUMBER(p) ((p).type == PRIMITIVE_NUMBER)
+#define MAKE_NUMBER(value)                                                     \
+  ((ch_primitive){.number_value = (double)(value), .type = PRIMITIVE_NUMBER})
+
+#define AS_BOOLEAN(p) ((p).boolean_value)
+#define IS_BOOLEAN(p) ((p).type == PRIMITIVE_BOOLEAN)
+#define MAKE_BOOLEAN(value)                                                    \
+  ((ch_primitive){.boolean_value = value, .type = PRIMITIVE_BOOLEAN})
+
+#define IS_NULL(p) ((p).type == PRIMITIVE_NULL)
+#define MAKE_NULL() ((ch_primitive){.type = PRIMITIVE_NULL})
+
+#define AS_OBJECT(p) ((p).object_value)
+#define IS_OBJECT(p) ((p).type == PRIMITIVE_OBJECT)
+#define MAKE_OBJECT(value)                                                     \
+  ((ch_primitive){.object_value = (ch_object *)(value),                        \
+                  .type = PRIMITIVE_OBJECT})
+
+#define AS_CHAR(p) ((p).char_value)
+#define IS_CHAR(p) ((p).type == PRIMITIVE_CHAR)
+#define MAKE_CHAR(value)                                                     \
+  ((ch_primitive){.char_value = (value),                        \
+                  .type = PRIMITIVE_CHAR})
+
+#endif
+
 bool ch_primitive_isfalsy(const ch_primitive value);
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include "search.h"
+#include <string.h>
+
+/*
+  Substring search with a first and last byte filter. A block of positions is
+  compared against the first byte of the needle, the same block shifted by the
+  needle size against its last byte, and only the positions where both match
+  are compared in full. Blocks are 32 bytes with AVX2 and 16 bytes with SSE2,
+  other targets check every position.
+*/
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define BLOCK_SIZE 32
+
+typedef __m256i ch_block;
+
+static inline ch_block splat(char byte) { return _mm256_set1_epi8(byte); }
+
+static inline uint32_t candidates(const char *at, ch_block first,
+                                  ch_block last, size_t last_offset) {
+  __m256i starts = _mm256_loadu_si256((const __m256i *)at);
+  __m256i ends = _mm256_loadu_si256((const __m256i *)(at + last_offset));
+  __m256i both = _mm256_and_si256(_mm256_cmpeq_epi8(starts, first),
+                                  _mm256_cmpeq_epi8(ends, last));
+  return (uint32_t)_mm256_movemask_epi8(both);
+}
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define BLOCK_SIZE 16
+
+typedef __m128i ch_block;
+
+static inline ch_block splat(char byte) { return _mm_set1_epi8(byte); }
+
+static inline uint32_t candidates(const char *at, ch_block first,
+                                  ch_block last, size_t last_offset) {
+  __m128i starts = _mm_loadu_si128((const __m128i *)at);
+  __m128i ends = _mm_loadu_si128((const __m128i *)(at + last_offset));
+  __m128i both = _mm_and_si128(_mm_cmpeq_epi8(starts, first),
+                               _mm_cmpeq_epi8(ends, last));
+  return (uint32_t)_mm_movemask_epi8(both);
+}
+#endif
+
+static inline int matches_at(const char *at, const char *needle,
+                             size_t needle_size) {
+  return at[0] == needle[0] && at[needle_size - 1] == needle[needle_size - 1] &&
+         (needle_size <= 2 || memcmp(at + 1, needle + 1, needle_size - 2) == 0);
+}
+
+size_t ch_search_first(const char *haystack, size_t haystack_size,
+                       const char *needle, size_t needle_size) {
+  if (needle_size == 0)
+    return 0;
+  if (needle_size > haystack_size)
+    return CH_SEARCH_NOT_FOUND;
+
+  // Every position up to end may start a match
+  size_t end = haystack_size - needle_size + 1;
+  size_t position = 0;
+
+#ifdef BLOCK_SIZE
+  ch_block first = splat(needle[0]);
+  ch_block last = splat(needle[needle_size - 1]);
+
+  // Both loads of a block stay within the haystack
+  for (; position + BLOCK_SIZE <= end; position += BLOCK_SIZE) {
+    uint32_t mask = candidates(&haystack[position], first, last, needle_size - 1);
+    while (mask != 0) {
+      size_t candidate = position + __builtin_ctz(mask);
+      if (needle_size <= 2 ||
+          memcmp(&haystack[candidate + 1], needle + 1, needle_size - 2) == 0)
+        return candidate;
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  for (; position < end; position++) {
+    if (matches_at(&haystack[position], needle, needle_size))
+      return position;
+  }
+
+  return CH_SEARCH_NOT_FOUND;
+}
+
+size_t ch_search_last(const char *haystack, size_t haystack_size,
+                      const char *needle, size_t needle_size) {
+  if (needle_size == 0)
+    return haystack_size;
+  if (needle_size > haystack_size)
+    return CH_SEARCH_NOT_FOUND;
+
+  // Positions below end are left to check, from the highest one down
+  size_t end = haystack_size - needle_size + 1;
+
+#ifdef BLOCK_SIZE
+  ch_block first = splat(needle[0]);
+  ch_block last = splat(needle[needle_size - 1]);
+
+  for (; end >= BLOCK_SIZE; end -= BLOCK_SIZE) {
+    size_t position = end - BLOCK_SIZE;
+    uint32_t mask = candidates(&haystack[position], first, last, needle_size - 1);
+    while (mask != 0) {
+      int bit = 31 - __builtin_clz(mask);
+      size_t candidate = position + bit;
+      if (needle_size <= 2 ||
+          memcmp(&haystack[candidate + 1], needle + 1, needle_size - 2) == 0)
+        return candidate;
+      mask &= ~(1u << bit);
+    }
+  }
+#endif
+
+  while (end > 0) {
+    end--;
+    if (matches_at(&haystack[end], needle, needle_size))
+      return end;
+  }
+
+  return CH_SEARCH_NOT_FOUND;
+}
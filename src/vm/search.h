@@ -0,0 +1,15 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define CH_SEARCH_NOT_FOUND SIZE_MAX
+
+// Index of the first occurrence of needle in haystack. Neither has to be
+// terminated, an empty needle is found at 0.
+size_t ch_search_first(const char *haystack, size_t haystack_size,
+                       const char *needle, size_t needle_size);
+
+// Index of the last occurrence of needle in haystack. An empty needle is
+// found at haystack_size.
+size_t ch_search_last(const char *haystack, size_t haystack_size,
+                      const char *needle, size_t needle_size);
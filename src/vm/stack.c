@@ -58,13 +58,21 @@ bool ch_stack_seekto(ch_stack *stack, ch_stack_addr addr) {
   return true;
 }
 
-ch_stack ch_stack_create() {
+ch_stack ch_stack_create(ch_memory *memory) {
   // TODO make stack size configurable upon startup
   size_t max_size = 1000;
   size_t size = max_size * sizeof(ch_primitive);
-  void *start = malloc(size);
+  void *start = ch_memory_alloc(memory, size);
 
-  return (ch_stack){.start = start, .max_size = max_size, .size = 0};
+  return (ch_stack){
+      .start = start, .max_size = max_size, .size = 0, .memory = memory};
+}
+
+void ch_stack_free(ch_stack *stack) {
+  ch_memory_release(stack->memory, stack->start,
+                    stack->max_size * sizeof(ch_primitive));
+  *stack = (ch_stack){
+      .start = NULL, .max_size = 0, .size = 0, .memory = stack->memory};
 }
 
 void ch_stack_set(ch_stack *stack, ch_stack_addr addr, ch_primitive entry) {
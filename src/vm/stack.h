@@ -1,4 +1,5 @@
 #pragma once
+#include "memory.h"
 #include "primitive.h"
 #include <stdbool.h>
 #include <stddef.h>
@@ -10,11 +11,14 @@ typedef struct {
   ch_primitive *start;
   size_t max_size;
   size_t size;
+  ch_memory *memory;
 } ch_stack;
 
 typedef uint32_t ch_stack_addr;
 
-ch_stack ch_stack_create();
+ch_stack ch_stack_create(ch_memory *memory);
+
+void ch_stack_free(ch_stack *stack);
 
 bool ch_stack_push(ch_stack *stack, ch_primitive entry);
 
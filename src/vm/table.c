@@ -1,99 +1,351 @@
-// Taken from https://craftinginterpreters.com/hash-tables.html
+// Group probing after https://abseil.io/about/design/swisstables
 #include "table.h"
 #include "hash.h"
+#include "object.h"
 #include <stdlib.h>
 #include <string.h>
 
-#define TABLE_MAX_LOAD 0.75
-#define GROW_CAPACITY(capacity) ((capacity) < 8 ? 8 : (capacity)*2)
-
-static ch_table_entry *find_entry(ch_table_entry *entries, uint32_t capacity,
-                                  ch_string *key) {
-  uint32_t index = key->hash & (capacity - 1);
-  ch_table_entry *tombstone = NULL;
-  for (;;) {
-    ch_table_entry *entry = &entries[index];
-    if (entry->key == NULL) {
-      if (IS_NULL(entry->value)) {
-        return tombstone != NULL ? tombstone : entry;
-      } else {
-        if (tombstone == NULL)
-          tombstone = entry;
-      }
-    } else if (entry->key == key) {
-      return entry;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define CONTROL_EMPTY 0x80
+#define CONTROL_DELETED 0xFE
+#define NOT_FOUND UINT32_MAX
+
+// At most 7/8 of the slots are used before the table grows
+#define MAX_USED(capacity) ((capacity) - (capacity) / 8)
+#define GROW_CAPACITY(capacity)                                                \
+  ((capacity) < CH_TABLE_GROUP_SIZE ? CH_TABLE_GROUP_SIZE : (capacity)*2)
+
+// Old slots migrated by every insertion or deletion during a resize. A resize
+// is over after capacity / 32 of them, long before the new slots fill up.
+#define MIGRATED_SLOTS (2 * CH_TABLE_GROUP_SIZE)
+
+// The low 7 bits are kept in the control byte, the rest picks the first group
+#define HASH_GROUP(hash) ((hash) >> 7)
+#define HASH_CONTROL(hash) ((uint8_t)((hash)&0x7F))
+
+// The hash that places a key in slots, remixed when the slots are salted.
+// Remixing is a bijection, so it only separates keys with different hashes.
+static inline uint32_t slot_hash(const ch_table_slots *slots, uint32_t hash) {
+  if (slots->salt == 0)
+    return hash;
+
+  hash ^= slots->salt;
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  return hash ^ (hash >> 16);
+}
+
+// Bit i is set when control byte i of the group equals byte
+static inline uint32_t match_byte(const uint8_t *group, uint8_t byte) {
+#if defined(__SSE2__)
+  __m128i bytes = _mm_loadu_si128((const __m128i *)group);
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)byte)));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < CH_TABLE_GROUP_SIZE; i++) {
+    mask |= (uint32_t)(group[i] == byte) << i;
+  }
+  return mask;
+#endif
+}
+
+// Bit i is set when slot i of the group is empty or deleted, which are the
+// only control bytes with the high bit set
+static inline uint32_t match_free(const uint8_t *group) {
+#if defined(__SSE2__)
+  return (uint32_t)_mm_movemask_epi8(
+      _mm_loadu_si128((const __m128i *)group));
+#else
+  uint32_t mask = 0;
+  for (uint32_t i = 0; i < CH_TABLE_GROUP_SIZE; i++) {
+    mask |= (uint32_t)(group[i] >> 7) << i;
+  }
+  return mask;
+#endif
+}
+
+static inline uint32_t lowest_bit(uint32_t mask) {
+#if defined(__GNUC__)
+  return (uint32_t)__builtin_ctz(mask);
+#else
+  uint32_t bit = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    bit++;
+  }
+  return bit;
+#endif
+}
+
+/*
+  Groups are visited in triangular order (g, g + 1, g + 3, g + 6, ...), which
+  reaches every group when their number is a power of two. A lookup stops at
+  the first group with an empty slot, since an insertion would have used it.
+*/
+#define FOR_EACH_GROUP(slots, hash, group)                                     \
+  for (uint32_t group_mask_ = (slots)->capacity / CH_TABLE_GROUP_SIZE - 1,     \
+                step_ = 0, group = HASH_GROUP(hash) & group_mask_;             \
+       ; step_++, group = (group + step_) & group_mask_)
+
+static uint32_t find_slot(const ch_table_slots *slots, const ch_string *key) {
+  if (slots->capacity == 0)
+    return NOT_FOUND;
+
+  uint32_t hash = slot_hash(slots, key->hash);
+  uint8_t control = HASH_CONTROL(hash);
+  FOR_EACH_GROUP(slots, hash, group) {
+    uint32_t first = group * CH_TABLE_GROUP_SIZE;
+    const uint8_t *bytes = &slots->control[first];
+    for (uint32_t mask = match_byte(bytes, control); mask != 0; mask &= mask - 1) {
+      uint32_t slot = first + lowest_bit(mask);
+      if (slots->keys[slot] == key)
+        return slot;
+    }
+
+    if (match_byte(bytes, CONTROL_EMPTY) != 0)
+      return NOT_FOUND;
+  }
+}
+
+static ch_string *find_string(const ch_table_slots *slots, const char *value,
+                              size_t size, uint32_t hash) {
+  if (slots->capacity == 0)
+    return NULL;
+
+  uint32_t placed = slot_hash(slots, hash);
+  uint8_t control = HASH_CONTROL(placed);
+  FOR_EACH_GROUP(slots, placed, group) {
+    uint32_t first = group * CH_TABLE_GROUP_SIZE;
+    const uint8_t *bytes = &slots->control[first];
+    for (uint32_t mask = match_byte(bytes, control); mask != 0; mask &= mask - 1) {
+      ch_string *key = slots->keys[first + lowest_bit(mask)];
+      if (key->size == size && key->hash == hash &&
+          memcmp(key->value, value, size) == 0)
+        return key;
     }
 
-    index = (index + 1) & (capacity - 1);
+    if (match_byte(bytes, CONTROL_EMPTY) != 0)
+      return NULL;
   }
 }
 
-static void adjust_capacity(ch_table *table, uint32_t capacity) {
-  ch_table_entry *entries =
-      (ch_table_entry *)malloc(capacity * sizeof(ch_table_entry));
-  for (uint32_t i = 0; i < capacity; i++) {
-    entries[i].key = NULL;
-    entries[i].value = MAKE_NULL();
+// The first empty or deleted slot on the probe sequence of hash, counting the
+// groups that were probed to find it
+static uint32_t find_free_slot(const ch_table_slots *slots, uint32_t hash,
+                               uint32_t *probed) {
+  *probed = 0;
+  FOR_EACH_GROUP(slots, hash, group) {
+    uint32_t mask = match_free(&slots->control[group * CH_TABLE_GROUP_SIZE]);
+    ++*probed;
+    if (mask != 0)
+      return group * CH_TABLE_GROUP_SIZE + lowest_bit(mask);
+  }
+}
+
+static void release_slots(ch_table *table, ch_table_slots *slots) {
+  ch_memory_release(table->memory, slots->control,
+                    slots->capacity * sizeof(uint8_t));
+  ch_memory_release(table->memory, slots->keys,
+                    slots->capacity * sizeof(ch_string *));
+  ch_memory_release(table->memory, slots->values,
+                    slots->capacity * sizeof(ch_primitive));
+  *slots = (ch_table_slots){NULL, NULL, NULL, 0, 0};
+}
+
+// Returns false, with nothing allocated, when the allocator refuses
+static bool allocate_slots(ch_table *table, ch_table_slots *slots,
+                           uint32_t capacity) {
+  slots->control = ch_memory_alloc(table->memory, capacity * sizeof(uint8_t));
+  slots->keys = ch_memory_alloc(table->memory, capacity * sizeof(ch_string *));
+  slots->values =
+      ch_memory_alloc(table->memory, capacity * sizeof(ch_primitive));
+  slots->capacity = capacity;
+  slots->salt = table->salt;
+
+  if (slots->control == NULL || slots->keys == NULL || slots->values == NULL) {
+    release_slots(table, slots);
+    return false;
   }
 
-  table->size = 0;
-  for (uint32_t i = 0; i < table->capacity; i++) {
-    ch_table_entry *entry = &table->entries[i];
+  // Keys and values are only read in slots that are in use, leaving them
+  // alone spares a resize from touching every page of them
+  memset(slots->control, CONTROL_EMPTY, capacity * sizeof(uint8_t));
+  return true;
+}
+
+// Writes a key that is in no slot yet, the caller counts it in size. Returns
+// whether the insertion probed more than CH_TABLE_MAX_PROBE_GROUPS groups.
+static bool insert(ch_table *table, ch_string *key, ch_primitive value) {
+  ch_table_slots *slots = &table->slots;
+  uint32_t hash = slot_hash(slots, key->hash);
+  uint32_t probed;
+  uint32_t slot = find_free_slot(slots, hash, &probed);
+  if (slots->control[slot] == CONTROL_EMPTY)
+    table->used++;
+
+  slots->control[slot] = HASH_CONTROL(hash);
+  slots->keys[slot] = key;
+  slots->values[slot] = value;
+  return probed > CH_TABLE_MAX_PROBE_GROUPS;
+}
+
+static void remove_slot(ch_table_slots *slots, uint32_t slot) {
+  slots->control[slot] = CONTROL_DELETED;
+}
 
-    if (entry->key == NULL)
+// Moves up to count old slots into the new ones. Migrated slots are marked
+// deleted, so that the probe sequences of the remaining keys stay intact.
+static void migrate(ch_table *table, uint32_t count) {
+  ch_table_slots *old = &table->old;
+  if (old->capacity == 0)
+    return;
+
+  uint32_t end = table->migrated + count;
+  if (end > old->capacity)
+    end = old->capacity;
+
+  for (uint32_t i = table->migrated; i < end; i++) {
+    if (!CH_TABLE_IN_USE(old, i))
       continue;
 
-    ch_table_entry *destination = find_entry(entries, capacity, entry->key);
-    destination->key = entry->key;
-    destination->value = entry->value;
-    table->size++;
+    insert(table, old->keys[i], old->values[i]);
+    remove_slot(old, i);
+  }
+
+  table->migrated = end;
+  if (end == old->capacity) {
+    release_slots(table, old);
+  }
+}
+
+/*
+  Moves every key to new slots, which also drops the deleted slots. Small
+  tables are rehashed right away, large ones keep their current slots around
+  and migrate them along with later insertions and deletions. The table is
+  left as it was when the new slots can't be allocated.
+*/
+static bool resize(ch_table *table, uint32_t capacity) {
+  // A resize in progress is finished before starting another
+  ch_table_finish_resize(table);
+
+  ch_table_slots slots;
+  if (!allocate_slots(table, &slots, capacity))
+    return false;
+
+  table->old = table->slots;
+  table->slots = slots;
+  table->migrated = 0;
+  table->used = 0;
+
+  if (table->old.capacity < CH_TABLE_INCREMENTAL_CAPACITY) {
+    migrate(table, table->old.capacity);
   }
+  return true;
+}
+
+// Capacity the slots are resized to before a new key is inserted, 0 while
+// the key fits
+static uint32_t resize_capacity(const ch_table *table) {
+  uint32_t capacity = table->slots.capacity;
+  if (table->used + 1 <= MAX_USED(capacity))
+    return 0;
+
+  // Deleted slots are reclaimed in place while keys fill at most half of
+  // the slots, the table only grows when they are mostly in use
+  bool reclaim = capacity > 0 && (table->size + 1) * 2 <= capacity;
+  return reclaim ? capacity : GROW_CAPACITY(capacity);
+}
 
-  free(table->entries);
+size_t ch_table_growth(const ch_table *table) {
+  size_t slot_size = sizeof(uint8_t) + sizeof(ch_string *) + sizeof(ch_primitive);
+  return (size_t)resize_capacity(table) * slot_size;
+}
 
-  table->entries = entries;
-  table->capacity = capacity;
+void ch_table_finish_resize(ch_table *table) {
+  migrate(table, table->old.capacity);
 }
 
 bool ch_table_set(ch_table *table, ch_string *key, ch_primitive value) {
-  if (table->size + 1 > table->capacity * TABLE_MAX_LOAD) {
-    uint32_t capacity = GROW_CAPACITY(table->capacity);
-    adjust_capacity(table, capacity);
+  migrate(table, MIGRATED_SLOTS);
+
+  uint32_t slot = find_slot(&table->slots, key);
+  if (slot != NOT_FOUND) {
+    table->slots.values[slot] = value;
+    return false;
   }
 
-  ch_table_entry *entry = find_entry(table->entries, table->capacity, key);
-  bool is_new = entry->key == NULL;
+  slot = find_slot(&table->old, key);
+  if (slot != NOT_FOUND) {
+    table->old.values[slot] = value;
+    return false;
+  }
 
-  if (is_new && IS_NULL(entry->value))
-    table->size++;
+  uint32_t capacity = resize_capacity(table);
+  if (capacity != 0 && !resize(table, capacity))
+    return false;
 
-  entry->key = key;
-  entry->value = value;
+  bool flooded = insert(table, key, value);
+  table->size++;
 
-  return is_new;
+  // Salting only helps once, keys that still collide share their whole hash
+  // and no rehash can tell them apart
+  if (flooded && table->salt == 0) {
+    table->salt = ch_hash_salt();
+    resize(table, table->slots.capacity);
+  }
+
+  return true;
 }
 
 ch_primitive *ch_table_get(ch_table *table, ch_string *key) {
   if (table->size == 0)
     return NULL;
 
-  ch_table_entry *entry = find_entry(table->entries, table->capacity, key);
-  if (entry->key == NULL)
-    return NULL;
+  uint32_t slot = find_slot(&table->slots, key);
+  if (slot != NOT_FOUND)
+    return &table->slots.values[slot];
+
+  slot = find_slot(&table->old, key);
+  if (slot != NOT_FOUND)
+    return &table->old.values[slot];
 
-  return &entry->value;
+  return NULL;
 }
 
 bool ch_table_delete(ch_table *table, ch_string *key) {
   if (table->size == 0)
     return false;
 
-  ch_table_entry *entry = find_entry(table->entries, table->capacity, key);
-  if (entry->key == NULL)
-    return false;
+  migrate(table, MIGRATED_SLOTS);
 
-  entry->key = NULL;
-  entry->value = MAKE_BOOLEAN(true);
+  ch_table_slots *slots = &table->slots;
+  uint32_t slot = find_slot(slots, key);
+  if (slot == NOT_FOUND) {
+    slot = find_slot(&table->old, key);
+    if (slot == NOT_FOUND)
+      return false;
+
+    remove_slot(&table->old, slot);
+    table->size--;
+    return true;
+  }
+
+  remove_slot(slots, slot);
+  table->size--;
+
+  // Lookups never probe past a group that has an empty slot, so the slot can
+  // be emptied instead of staying deleted
+  uint32_t first = slot - slot % CH_TABLE_GROUP_SIZE;
+  if (match_byte(&slots->control[first], CONTROL_EMPTY) != 0) {
+    slots->control[slot] = CONTROL_EMPTY;
+    table->used--;
+  }
 
   return true;
 }
@@ -104,36 +356,31 @@ ch_string *ch_table_find_string(ch_table *table, const char *value,
     return NULL;
 
   uint32_t hash = ch_hash_string(value, size);
-  uint32_t index = hash & (table->capacity - 1);
-  for (;;) {
-    ch_table_entry *entry = &table->entries[index];
-    if (entry->key == NULL) {
-
-      if (IS_NULL(entry->value))
-        return NULL;
-    } else  {
-    // } else if (entry->key->size == size && entry->key->hash == hash &&
-    //            memcmp(entry->key->value, value, size) == 0) {
-      bool a = entry->key->size == size;
-      bool b = entry->key->hash == hash;
-      bool result = memcmp(entry->key->value, value, size) == 0;
-      if (a && b && result) {
-        return entry->key;
-      }
-
-    }
-
-    index = (index + 1) & (table->capacity - 1);
+  ch_string *key = find_string(&table->slots, value, size, hash);
+  if (key == NULL) {
+    key = find_string(&table->old, value, size, hash);
   }
+
+  return key;
 }
 
-void ch_table_create(ch_table *out_table) {
-  out_table->capacity = 0;
+void ch_table_create(ch_table *out_table, ch_memory *memory) {
+  out_table->slots = (ch_table_slots){NULL, NULL, NULL, 0, 0};
+  out_table->old = (ch_table_slots){NULL, NULL, NULL, 0, 0};
+  out_table->migrated = 0;
   out_table->size = 0;
-  out_table->entries = NULL;
+  out_table->used = 0;
+  out_table->salt = 0;
+  out_table->memory = memory;
+}
+
+size_t ch_table_footprint(const ch_table *table) {
+  size_t slot_size = sizeof(uint8_t) + sizeof(ch_string *) + sizeof(ch_primitive);
+  return (size_t)(table->slots.capacity + table->old.capacity) * slot_size;
 }
 
 void ch_table_free(ch_table *table) {
-  free(table->entries);
-  ch_table_create(table);
+  release_slots(table, &table->slots);
+  release_slots(table, &table->old);
+  ch_table_create(table, table->memory);
 }
@@ -1,24 +1,70 @@
 #pragma once
-#include "object.h"
+#include "memory.h"
 #include "primitive.h"
 #include <stdbool.h>
 #include <stdint.h>
 
-typedef struct {
-  ch_string *key;
-  ch_primitive value;
-} ch_table_entry;
+// Maps are objects holding a table, see object.h
+typedef struct ch_string ch_string;
+
+// Slots are probed in groups of this many control bytes
+#define CH_TABLE_GROUP_SIZE 16
+
+// Control bytes of the slots in use hold hash bits, which never set the high bit
+#define CH_TABLE_IN_USE(slots, slot) ((slots)->control[slot] < 0x80)
+
+// Tables at least this large migrate their slots a few at a time when they
+// are resized, instead of all at once
+#define CH_TABLE_INCREMENTAL_CAPACITY 1024
+
+// Insertions probing more groups than this rehash the table with a salt, see
+// ch_table_slots
+#define CH_TABLE_MAX_PROBE_GROUPS 16
+
+/*
+  Open addressing with a control byte per slot, which is either empty,
+  deleted, or holds 7 bits of the key's hash. Lookups compare the control
+  bytes of a whole group at once and only look at the keys whose bits match.
+  Keys and values live in parallel arrays, which are only meaningful in the
+  slots that are in use.
 
+  String hashes are seeded per process, so long probe sequences should only
+  come from keys crafted against a leaked seed. Once an insertion probes too
+  far, the table is rehashed with a random salt that remixes every hash, which
+  scatters keys that only collided in the bits picking their slot.
+*/
 typedef struct {
-  ch_table_entry *entries;
+  uint8_t *control;
+  ch_string **keys;
+  ch_primitive *values;
+  // A multiple of the group size, or 0 before the first insertion
   uint32_t capacity;
+  // Remixes the hashes of the keys in these slots, 0 leaves them as they are
+  uint32_t salt;
+} ch_table_slots;
+
+typedef struct {
+  ch_table_slots slots;
+  // While a large table is resized, the previous slots whose keys are still
+  // to be migrated. Every insertion or deletion migrates a few of them.
+  ch_table_slots old;
+  // Old slots below this index have been migrated
+  uint32_t migrated;
+  // Keys in the table, old slots included
   uint32_t size;
+  // Slots that are not empty, keys and deleted slots alike
+  uint32_t used;
+  // Given to the slots of later resizes, set once an insertion probed too far
+  uint32_t salt;
+  ch_memory *memory;
 } ch_table;
 
-void ch_table_create(ch_table *out_table);
+void ch_table_create(ch_table *out_table, ch_memory *memory);
 
 void ch_table_free(ch_table *table);
 
+// Returns whether the key is new. It is false as well when the slots had to
+// grow and the allocator refused, the key is left out then.
 bool ch_table_set(ch_table *table, ch_string *key, ch_primitive value);
 
 ch_primitive *ch_table_get(ch_table *table, ch_string *key);
@@ -26,4 +72,14 @@ ch_primitive *ch_table_get(ch_table *table, ch_string *key);
 bool ch_table_delete(ch_table *table, ch_string *key);
 
 ch_string *ch_table_find_string(ch_table *table, const char *value,
-                                size_t size);
\ No newline at end of file
+                                size_t size);
+
+// Bytes allocated for the slots, old ones included
+size_t ch_table_footprint(const ch_table *table);
+
+// Bytes the next new key allocates for larger slots, 0 while it fits
+size_t ch_table_growth(const ch_table *table);
+
+// Migrates every old slot, after which slots holds every key of the table.
+// Called before walking over the slots.
+void ch_table_finish_resize(ch_table *table);
\ No newline at end of file
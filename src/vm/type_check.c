@@ -2,7 +2,7 @@
 
 bool checkobject(ch_context* vm, ch_primitive value, ch_object** actual) {
 	if (!IS_OBJECT(value)) {
-		ch_runtime_error(vm, EXIT_USER_ERROR, "Expected string type, but got type %d instead", value.type);
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Expected string type, but got type %d instead", PRIMITIVE_TYPE(value));
 		return false;
 	}
 
@@ -20,16 +20,26 @@ bool ch_checkargcount(ch_context* vm, ch_argcount expected, ch_argcount actual)
 	return is_same;
 }
 
-bool ch_checkstring(ch_context* vm, ch_primitive value, ch_string** actual) {
+bool ch_checktext(ch_context* vm, ch_primitive value, ch_string** actual) {
 	ch_object* object_value = NULL;
 	if(!checkobject(vm, value, &object_value)) return false;
 
-	if (!IS_STRING(object_value)) {
+	if (!IS_TEXT(object_value)) {
 		ch_runtime_error(vm, EXIT_USER_ERROR, "Expected string type, but got object type %d instead", object_value->type);
 		return false;
 	}
 
-	*actual = AS_STRING(object_value);
+	// Natives work on flat strings
+	*actual = ch_flatten(vm, object_value);
+
+	return *actual != NULL;
+}
+
+bool ch_checkstring(ch_context* vm, ch_primitive value, ch_string** actual) {
+	if (!ch_checktext(vm, value, actual)) return false;
+
+	// Host natives use the value as a C string, slices are not terminated
+	*actual = ch_internstring(vm, *actual);
 
 	return true;
 }
@@ -54,5 +64,33 @@ bool ch_checknumber(ch_context* vm, ch_primitive value, double* actual) {
 	}
 
 	*actual = AS_NUMBER(value);
+	return true;
+}
+
+bool ch_checkf64array(ch_context* vm, ch_primitive value, ch_f64array** actual) {
+	ch_object* object_value = NULL;
+	if(!checkobject(vm, value, &object_value)) return false;
+
+	if (!IS_F64ARRAY(object_value)) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Expected numeric array type, but got object type %d instead", object_value->type);
+		return false;
+	}
+
+	*actual = AS_F64ARRAY(object_value);
+
+	return true;
+}
+
+bool ch_checkmap(ch_context* vm, ch_primitive value, ch_map** actual) {
+	ch_object* object_value = NULL;
+	if(!checkobject(vm, value, &object_value)) return false;
+
+	if (!IS_MAP(object_value)) {
+		ch_runtime_error(vm, EXIT_USER_ERROR, "Expected map type, but got object type %d instead", object_value->type);
+		return false;
+	}
+
+	*actual = AS_MAP(object_value);
+
 	return true;
 }
\ No newline at end of file
@@ -3,8 +3,17 @@
 
 bool ch_checkargcount(ch_context* vm, ch_argcount expected, ch_argcount actual);
 
+// The string is always terminated, slices are copied
 bool ch_checkstring(ch_context* vm, ch_primitive value, ch_string** actual);
 
+// Like ch_checkstring, but the string may be a slice that is not terminated.
+// For the built-in natives, which only go by the size.
+bool ch_checktext(ch_context* vm, ch_primitive value, ch_string** actual);
+
 bool ch_checkfunction(ch_context* vm, ch_primitive value, ch_function** actual);
 
-bool ch_checknumber(ch_context* vm, ch_primitive value, double* actual);
\ No newline at end of file
+bool ch_checknumber(ch_context* vm, ch_primitive value, double* actual);
+
+bool ch_checkf64array(ch_context* vm, ch_primitive value, ch_f64array** actual);
+
+bool ch_checkmap(ch_context* vm, ch_primitive value, ch_map** actual);
\ No newline at end of file
@@ -0,0 +1,416 @@
+#include "vector.h"
+#include <math.h>
+
+/*
+  Every kernel comes in a scalar version, and on x86 with GCC or Clang in an
+  SSE2 and an AVX2 version as well. The vector versions are compiled for
+  their instruction set with target attributes, so the library itself stays
+  buildable for the baseline CPU, and ch_vector_supported picks the widest one
+  the running CPU has on every call.
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CH_VECTOR_X86
+#include <immintrin.h>
+
+#define SSE2 __attribute__((target("sse2")))
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+static ch_vector_level limit = CH_VECTOR_AVX2;
+
+ch_vector_level ch_vector_supported(void) {
+#ifdef CH_VECTOR_X86
+  if (__builtin_cpu_supports("avx2"))
+    return CH_VECTOR_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return CH_VECTOR_SSE2;
+#endif
+  return CH_VECTOR_SCALAR;
+}
+
+static ch_vector_level level(void) {
+  ch_vector_level supported = ch_vector_supported();
+  return supported < limit ? supported : limit;
+}
+
+ch_vector_level ch_vector_limit(ch_vector_level level_limit) {
+  limit = level_limit;
+  return level();
+}
+
+static double sum_scalar(const double *values, size_t count) {
+  double sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    sum += values[i];
+  }
+  return sum;
+}
+
+static double dot_scalar(const double *left, const double *right,
+                         size_t count) {
+  double sum = 0;
+  for (size_t i = 0; i < count; i++) {
+    sum += left[i] * right[i];
+  }
+  return sum;
+}
+
+// Continues a minimum or maximum from result with values[start] on
+static double extreme_scalar(const double *values, size_t start, size_t count,
+                             double result, int maximum) {
+  for (size_t i = start; i < count; i++) {
+    double value = values[i];
+    if (isnan(value))
+      return value;
+    if (maximum ? value > result : value < result)
+      result = value;
+  }
+  return result;
+}
+
+static void scale_scalar(double *values, size_t count, double factor) {
+  for (size_t i = 0; i < count; i++) {
+    values[i] *= factor;
+  }
+}
+
+static void add_scalar(double *values, const double *addend, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    values[i] += addend[i];
+  }
+}
+
+// Continues a running sum from total with values[start] on
+static void prefix_sum_scalar(double *values, size_t start, size_t count,
+                              double total) {
+  for (size_t i = start; i < count; i++) {
+    total += values[i];
+    values[i] = total;
+  }
+}
+
+#ifdef CH_VECTOR_X86
+SSE2 static inline double hsum_sse2(__m128d lanes) {
+  return _mm_cvtsd_f64(_mm_add_sd(lanes, _mm_unpackhi_pd(lanes, lanes)));
+}
+
+// Four accumulators hide the latency of the additions
+SSE2 static double sum_sse2(const double *values, size_t count) {
+  __m128d a = _mm_setzero_pd(), b = a, c = a, d = a;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    a = _mm_add_pd(a, _mm_loadu_pd(&values[i]));
+    b = _mm_add_pd(b, _mm_loadu_pd(&values[i + 2]));
+    c = _mm_add_pd(c, _mm_loadu_pd(&values[i + 4]));
+    d = _mm_add_pd(d, _mm_loadu_pd(&values[i + 6]));
+  }
+  for (; i + 2 <= count; i += 2) {
+    a = _mm_add_pd(a, _mm_loadu_pd(&values[i]));
+  }
+
+  double sum = hsum_sse2(_mm_add_pd(_mm_add_pd(a, b), _mm_add_pd(c, d)));
+  for (; i < count; i++) {
+    sum += values[i];
+  }
+  return sum;
+}
+
+SSE2 static double dot_sse2(const double *left, const double *right,
+                            size_t count) {
+  __m128d a = _mm_setzero_pd(), b = a, c = a, d = a;
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    a = _mm_add_pd(a, _mm_mul_pd(_mm_loadu_pd(&left[i]), _mm_loadu_pd(&right[i])));
+    b = _mm_add_pd(b, _mm_mul_pd(_mm_loadu_pd(&left[i + 2]), _mm_loadu_pd(&right[i + 2])));
+    c = _mm_add_pd(c, _mm_mul_pd(_mm_loadu_pd(&left[i + 4]), _mm_loadu_pd(&right[i + 4])));
+    d = _mm_add_pd(d, _mm_mul_pd(_mm_loadu_pd(&left[i + 6]), _mm_loadu_pd(&right[i + 6])));
+  }
+  for (; i + 2 <= count; i += 2) {
+    a = _mm_add_pd(a, _mm_mul_pd(_mm_loadu_pd(&left[i]), _mm_loadu_pd(&right[i])));
+  }
+
+  double sum = hsum_sse2(_mm_add_pd(_mm_add_pd(a, b), _mm_add_pd(c, d)));
+  for (; i < count; i++) {
+    sum += left[i] * right[i];
+  }
+  return sum;
+}
+
+// minpd and maxpd drop NaNs in their first operand, so NaNs are collected
+// separately
+SSE2 static inline double extreme_sse2(const double *values, size_t count,
+                                       int maximum) {
+  __m128d result = _mm_set1_pd(values[0]);
+  __m128d nans = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m128d lanes = _mm_loadu_pd(&values[i]);
+    nans = _mm_or_pd(nans, _mm_cmpunord_pd(lanes, lanes));
+    result = maximum ? _mm_max_pd(result, lanes) : _mm_min_pd(result, lanes);
+  }
+  if (_mm_movemask_pd(nans) != 0)
+    return NAN;
+
+  double low = _mm_cvtsd_f64(result);
+  double high = _mm_cvtsd_f64(_mm_unpackhi_pd(result, result));
+  double lanes = (maximum ? low > high : low < high) ? low : high;
+  return extreme_scalar(values, i, count, lanes, maximum);
+}
+
+SSE2 static double min_sse2(const double *values, size_t count) {
+  return extreme_sse2(values, count, 0);
+}
+
+SSE2 static double max_sse2(const double *values, size_t count) {
+  return extreme_sse2(values, count, 1);
+}
+
+SSE2 static void scale_sse2(double *values, size_t count, double factor) {
+  __m128d factors = _mm_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    _mm_storeu_pd(&values[i], _mm_mul_pd(_mm_loadu_pd(&values[i]), factors));
+  }
+  scale_scalar(&values[i], count - i, factor);
+}
+
+SSE2 static void add_sse2(double *values, const double *addend, size_t count) {
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    _mm_storeu_pd(&values[i], _mm_add_pd(_mm_loadu_pd(&values[i]),
+                                         _mm_loadu_pd(&addend[i])));
+  }
+  add_scalar(&values[i], &addend[i], count - i);
+}
+
+// Scans each pair in the register, then adds the total of the pairs before it
+SSE2 static void prefix_sum_sse2(double *values, size_t count) {
+  __m128d carry = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m128d lanes = _mm_loadu_pd(&values[i]);
+    // [a, b] + [0, a]
+    lanes = _mm_add_pd(lanes, _mm_unpacklo_pd(_mm_setzero_pd(), lanes));
+    lanes = _mm_add_pd(lanes, carry);
+    _mm_storeu_pd(&values[i], lanes);
+    carry = _mm_unpackhi_pd(lanes, lanes);
+  }
+  prefix_sum_scalar(values, i, count, _mm_cvtsd_f64(carry));
+}
+
+AVX2 static inline double hsum_avx2(__m256d lanes) {
+  __m128d pairs = _mm_add_pd(_mm256_castpd256_pd128(lanes),
+                             _mm256_extractf128_pd(lanes, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(pairs, _mm_unpackhi_pd(pairs, pairs)));
+}
+
+AVX2 static double sum_avx2(const double *values, size_t count) {
+  __m256d a = _mm256_setzero_pd(), b = a, c = a, d = a;
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    a = _mm256_add_pd(a, _mm256_loadu_pd(&values[i]));
+    b = _mm256_add_pd(b, _mm256_loadu_pd(&values[i + 4]));
+    c = _mm256_add_pd(c, _mm256_loadu_pd(&values[i + 8]));
+    d = _mm256_add_pd(d, _mm256_loadu_pd(&values[i + 12]));
+  }
+  for (; i + 4 <= count; i += 4) {
+    a = _mm256_add_pd(a, _mm256_loadu_pd(&values[i]));
+  }
+
+  double sum = hsum_avx2(_mm256_add_pd(_mm256_add_pd(a, b), _mm256_add_pd(c, d)));
+  for (; i < count; i++) {
+    sum += values[i];
+  }
+  return sum;
+}
+
+AVX2 static double dot_avx2(const double *left, const double *right,
+                            size_t count) {
+  __m256d a = _mm256_setzero_pd(), b = a, c = a, d = a;
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    a = _mm256_add_pd(a, _mm256_mul_pd(_mm256_loadu_pd(&left[i]), _mm256_loadu_pd(&right[i])));
+    b = _mm256_add_pd(b, _mm256_mul_pd(_mm256_loadu_pd(&left[i + 4]), _mm256_loadu_pd(&right[i + 4])));
+    c = _mm256_add_pd(c, _mm256_mul_pd(_mm256_loadu_pd(&left[i + 8]), _mm256_loadu_pd(&right[i + 8])));
+    d = _mm256_add_pd(d, _mm256_mul_pd(_mm256_loadu_pd(&left[i + 12]), _mm256_loadu_pd(&right[i + 12])));
+  }
+  for (; i + 4 <= count; i += 4) {
+    a = _mm256_add_pd(a, _mm256_mul_pd(_mm256_loadu_pd(&left[i]), _mm256_loadu_pd(&right[i])));
+  }
+
+  double sum = hsum_avx2(_mm256_add_pd(_mm256_add_pd(a, b), _mm256_add_pd(c, d)));
+  for (; i < count; i++) {
+    sum += left[i] * right[i];
+  }
+  return sum;
+}
+
+AVX2 static inline double extreme_avx2(const double *values, size_t count,
+                                       int maximum) {
+  __m256d result = _mm256_set1_pd(values[0]);
+  __m256d nans = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256d lanes = _mm256_loadu_pd(&values[i]);
+    nans = _mm256_or_pd(nans, _mm256_cmp_pd(lanes, lanes, _CMP_UNORD_Q));
+    result = maximum ? _mm256_max_pd(result, lanes) : _mm256_min_pd(result, lanes);
+  }
+  if (_mm256_movemask_pd(nans) != 0)
+    return NAN;
+
+  __m128d low = _mm256_castpd256_pd128(result);
+  __m128d high = _mm256_extractf128_pd(result, 1);
+  __m128d pairs = maximum ? _mm_max_pd(low, high) : _mm_min_pd(low, high);
+  double first = _mm_cvtsd_f64(pairs);
+  double second = _mm_cvtsd_f64(_mm_unpackhi_pd(pairs, pairs));
+  double lanes = (maximum ? first > second : first < second) ? first : second;
+  return extreme_scalar(values, i, count, lanes, maximum);
+}
+
+AVX2 static double min_avx2(const double *values, size_t count) {
+  return extreme_avx2(values, count, 0);
+}
+
+AVX2 static double max_avx2(const double *values, size_t count) {
+  return extreme_avx2(values, count, 1);
+}
+
+AVX2 static void scale_avx2(double *values, size_t count, double factor) {
+  __m256d factors = _mm256_set1_pd(factor);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm256_storeu_pd(&values[i], _mm256_mul_pd(_mm256_loadu_pd(&values[i]), factors));
+  }
+  scale_scalar(&values[i], count - i, factor);
+}
+
+AVX2 static void add_avx2(double *values, const double *addend, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    _mm256_storeu_pd(&values[i], _mm256_add_pd(_mm256_loadu_pd(&values[i]),
+                                               _mm256_loadu_pd(&addend[i])));
+  }
+  add_scalar(&values[i], &addend[i], count - i);
+}
+
+// Scans each group of four in two shifted additions, then adds the total of
+// the groups before it
+AVX2 static void prefix_sum_avx2(double *values, size_t count) {
+  __m256d zero = _mm256_setzero_pd();
+  __m256d carry = zero;
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256d lanes = _mm256_loadu_pd(&values[i]);
+    // [a, b, c, d] + [0, a, b, c]
+    __m256d shifted = _mm256_permute4x64_pd(lanes, _MM_SHUFFLE(2, 1, 0, 3));
+    lanes = _mm256_add_pd(lanes, _mm256_blend_pd(shifted, zero, 0x1));
+    // + [0, 0, a, a + b]
+    shifted = _mm256_permute4x64_pd(lanes, _MM_SHUFFLE(1, 0, 3, 2));
+    lanes = _mm256_add_pd(lanes, _mm256_blend_pd(shifted, zero, 0x3));
+    lanes = _mm256_add_pd(lanes, carry);
+    _mm256_storeu_pd(&values[i], lanes);
+    carry = _mm256_permute4x64_pd(lanes, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  prefix_sum_scalar(values, i, count, _mm_cvtsd_f64(_mm256_castpd256_pd128(carry)));
+}
+#endif
+
+double ch_vector_sum(const double *values, size_t count) {
+  switch (level()) {
+#ifdef CH_VECTOR_X86
+  case CH_VECTOR_AVX2:
+    return sum_avx2(values, count);
+  case CH_VECTOR_SSE2:
+    return sum_sse2(values, count);
+#endif
+  default:
+    return sum_scalar(values, count);
+  }
+}
+
+double ch_vector_min(const double *values, size_t count) {
+  switch (level()) {
+#ifdef CH_VECTOR_X86
+  case CH_VECTOR_AVX2:
+    return min_avx2(values, count);
+  case CH_VECTOR_SSE2:
+    return min_sse2(values, count);
+#endif
+  default:
+    return extreme_scalar(values, 0, count, values[0], 0);
+  }
+}
+
+double ch_vector_max(const double *values, size_t count) {
+  switch (level()) {
+#ifdef CH_VECTOR_X86
+  case CH_VECTOR_AVX2:
+    return max_avx2(values, count);
+  case CH_VECTOR_SSE2:
+    return max_sse2(values, count);
+#endif
+  default:
+    return extreme_scalar(values, 0, count, values[0], 1);
+  }
+}
+
+double ch_vector_dot(const double *left, const double *right, size_t count) {
+  switch (level()) {
+#ifdef CH_VECTOR_X86
+  case CH_VECTOR_AVX2:
+    return dot_avx2(left, right, count);
+  case CH_VECTOR_SSE2:
+    return dot_sse2(left, right, count);
+#endif
+  default:
+    return dot_scalar(left, right, count);
+  }
+}
+
+void ch_vector_scale(double *values, size_t count, double factor) {
+  switch (level()) {
+#ifdef CH_VECTOR_X86
+  case CH_VECTOR_AVX2:
+    scale_avx2(values, count, factor);
+    break;
+  case CH_VECTOR_SSE2:
+    scale_sse2(values, count, factor);
+    break;
+#endif
+  default:
+    scale_scalar(values, count, factor);
+    break;
+  }
+}
+
+void ch_vector_add(double *values, const double *addend, size_t count) {
+  switch (level()) {
+#ifdef CH_VECTOR_X86
+  case CH_VECTOR_AVX2:
+    add_avx2(values, addend, count);
+    break;
+  case CH_VECTOR_SSE2:
+    add_sse2(values, addend, count);
+    break;
+#endif
+  default:
+    add_scalar(values, addend, count);
+    break;
+  }
+}
+
+void ch_vector_prefix_sum(double *values, size_t count) {
+  switch (level()) {
+#ifdef CH_VECTOR_X86
+  case CH_VECTOR_AVX2:
+    prefix_sum_avx2(values, count);
+    break;
+  case CH_VECTOR_SSE2:
+    prefix_sum_sse2(values, count);
+    break;
+#endif
+  default:
+    prefix_sum_scalar(values, 0, count, 0);
+    break;
+  }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stddef.h>
+
+// Instruction sets the kernels can run with, from the least capable
+typedef enum {
+  CH_VECTOR_SCALAR,
+  CH_VECTOR_SSE2,
+  CH_VECTOR_AVX2,
+} ch_vector_level;
+
+// Highest level both the build and the running CPU support
+ch_vector_level ch_vector_supported(void);
+
+// Caps the level the kernels run with, to test or compare the narrower ones.
+// Returns the level they run with from now on.
+ch_vector_level ch_vector_limit(ch_vector_level level);
+
+/*
+  Kernels over arrays of doubles. Reductions add up several lanes side by
+  side, so their rounding can differ from a left to right loop in the last
+  bits. min and max are NaN if any value is, and need count > 0.
+*/
+double ch_vector_sum(const double *values, size_t count);
+
+double ch_vector_min(const double *values, size_t count);
+
+double ch_vector_max(const double *values, size_t count);
+
+double ch_vector_dot(const double *left, const double *right, size_t count);
+
+// values[i] *= factor
+void ch_vector_scale(double *values, size_t count, double factor);
+
+// values[i] += addend[i]
+void ch_vector_add(double *values, const double *addend, size_t count);
+
+// values[i] becomes the sum of values[0] to values[i]
+void ch_vector_prefix_sum(double *values, size_t count);
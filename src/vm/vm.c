@@ -1,7 +1,7 @@
 #include "vm.h"
-#include "bytecode.h"
 #include "ops.h"
 #include "defs.h"
+#include "loader.h"
 #include "type_check.h"
 #include <inttypes.h>
 #include <stdarg.h>
@@ -9,28 +9,21 @@
 #include <stdio.h>
 #include <string.h>
 
-#define VM_READ_PTR(context)                                                   \
-  ((context)->pcurrent += sizeof(ch_dataptr),                                  \
-   READ_U32((context)->pcurrent - sizeof(ch_dataptr)))
-
-#define VM_READ_CHAR(context)                                                   \
-  ((context)->pcurrent += sizeof(char),                                  \
-    *((char*)(context)->pcurrent - sizeof(char)))
-
-#define VM_READ_JMPPTR(context)                                                   \
-  ((context)->pcurrent += sizeof(ch_jmpptr),                                  \
-   U32_TO_JMPPTR(READ_U32((context)->pcurrent - sizeof(ch_jmpptr))))
-
-#define VM_READ_HASH(context)                                                  \
-  ((context)->pcurrent += sizeof(uint32_t),                                    \
-   READ_U32((context)->pcurrent - sizeof(uint32_t)))
-
-#define VM_READ_ARGCOUNT(context)                                              \
-  ((context)->pcurrent += sizeof(ch_argcount),                                 \
-   READ_ARGCOUNT((context)->pcurrent - sizeof(ch_argcount)))
-
-// TODO do memory bounds check?
-#define LOAD_NUMBER(context, ptr) (*((double *)(&(context)->pstart[ptr])))
+#ifndef CH_THREADED_DISPATCH
+#if defined(__GNUC__) || defined(__clang__)
+#define CH_THREADED_DISPATCH 1
+#else
+#define CH_THREADED_DISPATCH 0
+#endif
+#endif
+
+// Operands were decoded by the loader, each one takes a single word
+#define VM_READ(context) ((context)->pcurrent++)
+#define VM_READ_GLOBAL_SITE(context)                                           \
+  ((context)->pcurrent += CH_GLOBAL_SITE_SIZE,                                 \
+   (context)->pcurrent - CH_GLOBAL_SITE_SIZE)
+#define VM_READ_MAP_SITE(context)                                              \
+  ((context)->pcurrent += CH_MAP_SITE_SIZE, (context)->pcurrent - CH_MAP_SITE_SIZE)
 
 #define CURRENT_CALL(context_ptr)                                              \
   ((context_ptr)->call_stack.calls[(context_ptr)->call_stack.size - 1])
@@ -39,15 +32,9 @@ static void halt(ch_context *context, ch_exit reason) {
   context->exit = reason;
 }
 
-static void jump(ch_context *context, ch_jmpptr offset) {
-  uint8_t *jump_ptr = context->pcurrent + offset;
-  if (!IS_PROGRAM_PTR_SAFE(context, jump_ptr)) {
-    ch_runtime_error(context, EXIT_INVALID_INSTRUCTION_POINTER,
-                     "Jump pointer exceeds bounds of program.");
-    return;
-  }
-
-  context->pcurrent = jump_ptr;
+// Jump targets are resolved and bounds checked by the loader
+static void jump(ch_context *context, ch_code *target) {
+  context->pcurrent = target;
 }
 
 static ch_upvalue* capture_upvalue(ch_context* context, ch_primitive* value) {
@@ -63,7 +50,7 @@ static ch_upvalue* capture_upvalue(ch_context* context, ch_primitive* value) {
     return upvalue;
   }
 
-  ch_upvalue* created_upvalue = ch_loadupvalue(value);
+  ch_upvalue* created_upvalue = ch_loadupvalue(context, value);
   created_upvalue->next = upvalue;
 
   if (previous == NULL) {
@@ -78,6 +65,7 @@ static ch_upvalue* capture_upvalue(ch_context* context, ch_primitive* value) {
 static void close_upvalues(ch_context* context, ch_primitive* last) {
   while(context->open_upvalues != NULL && context->open_upvalues->value >= last) {
     ch_upvalue* upvalue = context->open_upvalues;
+    CH_GC_UPVALUE_BARRIER(context, upvalue, *upvalue->value);
     upvalue->closed = *upvalue->value;
     upvalue->value = &upvalue->closed;
     context->open_upvalues = upvalue->next;
@@ -100,19 +88,13 @@ static void call(ch_context *context, ch_function *function,
     return;
   }
 
-  uint8_t *function_ptr = context->pstart + function->ptr + context->data_size;
-  if (!IS_PROGRAM_PTR_SAFE(context, function_ptr)) {
-    ch_runtime_error(context, EXIT_INVALID_INSTRUCTION_POINTER,
-                     "Function pointer exceeds bounds of program.");
-    return;
-  }
-
   ch_call *call = &context->call_stack.calls[context->call_stack.size++];
   call->return_addr = context->pcurrent;
   call->stack_addr = CH_STACK_ADDR(&context->stack) - function->argcount;
   call->closure = NULL;
 
-  context->pcurrent = function_ptr;
+  // The loader turned the function pointer into an index in the decoded stream
+  context->pcurrent = &context->code[function->ptr];
 }
 
 static void try_call(ch_context *context, ch_primitive primitive,
@@ -120,7 +102,7 @@ static void try_call(ch_context *context, ch_primitive primitive,
   if (!IS_OBJECT(primitive)) {
     ch_runtime_error(context, EXIT_INCORRECT_TYPE,
                      "Attempted to invoke type %d as a function.",
-                     primitive.type);
+                     PRIMITIVE_TYPE(primitive));
     return;
   }
 
@@ -160,14 +142,15 @@ static void call_return(ch_context *context) {
   ch_stack_seekto(&context->stack, call->stack_addr);
 }
 
-ch_context ch_vm_newcontext(ch_program program) {
+ch_context ch_vm_newcontext(ch_program program, ch_allocator allocator) {
+  ch_memory *memory = ch_memory_create(allocator);
   ch_context context = {
-      .pstart = program.start,
-      .pend = program.start + program.total_size,
-      // Seek after the data section
-      .pcurrent = program.start + program.data_size + program.program_start_ptr,
-      .data_size = program.data_size,
-      .stack = ch_stack_create(),
+      .memory = memory,
+      .code = NULL,
+      .code_size = 0,
+      .pcurrent = NULL,
+      .pbegin = NULL,
+      .stack = ch_stack_create(memory),
       .call_stack =
           (ch_call_stack){
               .size = 0,
@@ -178,63 +161,142 @@ ch_context ch_vm_newcontext(ch_program program) {
       .open_upvalues=NULL
   };
 
-  ch_table_create(&context.globals);
-  ch_table_create(&context.strings);
+  ch_gc_create(&context.gc, memory);
+  ch_globals_create(&context.globals, program.globals_count, memory);
+  ch_table_create(&context.strings, memory);
+  context.constants = program.constants != NULL
+                          ? ch_constants_retain(program.constants)
+                          : ch_constants_create(memory);
+
+  ch_loader_load(&context);
 
   return context;
 }
 
 void ch_vm_free(ch_context *context) {
-  ch_table_free(&context->globals);
+  ch_gc_free(context);
+  ch_stack_free(&context->stack);
+  ch_loader_free(context);
+  ch_globals_free(&context->globals);
   ch_table_free(&context->strings);
+  ch_constants_release(context->constants);
+  ch_memory_free(context->memory);
+  context->memory = NULL;
 }
 
 #define STACK_PUSH(context_ptr, entry)                                         \
   if (!ch_stack_push(&(context_ptr)->stack, entry)) {                          \
     halt(context_ptr, EXIT_STACK_SIZE_EXCEEDED);                               \
-    break;                                                                     \
+    goto exit_loop;                                                            \
   }
 
 #define STACK_POP(context_ptr, value)                                          \
   if (!ch_stack_pop(&(context_ptr)->stack, value)) {                           \
     halt(context_ptr, EXIT_STACK_EMPTY);                                       \
-    break;                                                                     \
+    goto exit_loop;                                                            \
   }
 
+// Placed at the start of the ops that allocate, before they pop anything, so
+// that every live value is still reachable from the stack
+#define GC_SAFEPOINT(context_ptr)                                              \
+  if (CH_GC_SHOULD_STEP(context_ptr)) {                                        \
+    ch_gc_step(context_ptr);                                                   \
+  }                                                                            \
+  if (CH_MEMORY_EXCEEDED((context_ptr)->memory) &&                             \
+      !reclaim_memory(context_ptr)) {                                          \
+    goto exit_loop;                                                            \
+  }
+
+// Collects once the memory limit is exceeded, it is an error if that is not
+// enough
+static bool reclaim_memory(ch_context *context) {
+  ch_gc_collect(context);
+  if (!CH_MEMORY_EXCEEDED(context->memory))
+    return true;
+
+  ch_runtime_error(context, EXIT_OUT_OF_MEMORY,
+                   "Memory limit of %zu bytes exceeded.",
+                   context->memory->limit);
+  return false;
+}
+
+// Natives only take a name until the script defines it
+static bool is_defined_by_script(ch_context *context, uint32_t slot) {
+  return context->globals.defined[slot] && !context->globals.builtin[slot];
+}
+
 static void add_global(ch_context *context, ch_string *name,
-                       ch_primitive value) {
-  if (!ch_table_set(&context->globals, name, value))
+                       ch_primitive value, bool builtin) {
+  uint32_t slot = ch_globals_declare(&context->globals, name);
+  if (is_defined_by_script(context, slot)) {
     ch_runtime_error(context, EXIT_GLOBAL_ALREADY_EXISTS,
                      "Global variable has already been defined: %s.",
                      name->value);
+    return;
+  }
+
+  CH_GC_BARRIER(context, value);
+  context->globals.values[slot] = value;
+  context->globals.defined[slot] = true;
+  context->globals.builtin[slot] = builtin;
+}
+
+// Finds the global named at an access site, going through the site's inline cache
+static ch_primitive *lookup_global(ch_context *context, ch_code *site) {
+  ch_primitive *global = site[1].global;
+  if (global != NULL && site[2].index == context->globals.generation) {
+    return global;
+  }
+
+  uint32_t slot;
+  if (!ch_globals_find(&context->globals, site[0].string, &slot) ||
+      !context->globals.defined[slot]) {
+    return NULL;
+  }
+
+  global = &context->globals.values[slot];
+  site[1].global = global;
+  site[2].index = context->globals.generation;
+
+  return global;
 }
 
 #define CREATE_GLOBAL true
 #define REDEFINE_GLOBAL false
-static void set_global(ch_context *context, ch_string* name, ch_primitive value, bool create) {
-  ch_primitive* entry_found = ch_table_get(&context->globals, name);
+static void set_global(ch_context *context, ch_code *site, ch_primitive value, bool create) {
+  ch_string *name = site[0].string;
+  ch_primitive* entry_found = lookup_global(context, site);
   if (create) {
-    if (entry_found != NULL) {
+    uint32_t slot;
+    if (entry_found != NULL && ch_globals_find(&context->globals, name, &slot) &&
+        is_defined_by_script(context, slot)) {
       ch_runtime_error(context, EXIT_GLOBAL_NOT_FOUND, "Cannot redefine global variable: %s.", name->value);
       return;
     }
 
-    ch_table_set(&context->globals, name, value);
+    add_global(context, name, value, false);
   } else {
     if (entry_found == NULL) {
       ch_runtime_error(context, EXIT_GLOBAL_NOT_FOUND, "Cannot assign to non existing global variable: %s.", name->value);
       return;
     }
 
+    CH_GC_BARRIER(context, value);
     *entry_found = value;
   }
 }
 
-static bool get_global(ch_context* context, ch_string* name) {
-  ch_primitive *global = ch_table_get(&context->globals, name);
+static void undefined_global(ch_context *context, uint32_t slot) {
+  ch_runtime_error(context, EXIT_GLOBAL_NOT_FOUND,
+                   "Global variable does not exist: %s.",
+                   context->globals.names[slot]->value);
+}
+
+static bool load_global(ch_context *context, ch_code *site) {
+  ch_primitive *global = lookup_global(context, site);
   if (global == NULL) {
     ch_runtime_error(context, EXIT_GLOBAL_NOT_FOUND,
-                      "Global variable does not exist: %s.", name->value);
+                      "Global variable does not exist: %s.", site[0].string->value);
     return false;
   }
 
@@ -242,17 +304,10 @@ static bool get_global(ch_context* context, ch_string* name) {
   return true;
 }
 
-static ch_string *read_string(ch_context *context) {
-  ch_dataptr string_ptr = VM_READ_PTR(context);
-  ch_bytecode_string string =
-      ch_bytecode_load_string(&context->program, string_ptr);
-
-  return ch_loadstring(context, string.value, string.size, false);
-}
-
+// The right operand is on top, args end up in source order
 static void binary_op_args(ch_context *context, ch_primitive args[2]) {
-  ch_stack_pop(&context->stack, &args[0]);
   ch_stack_pop(&context->stack, &args[1]);
+  ch_stack_pop(&context->stack, &args[0]);
 }
 
 static ch_primitive binary_op_number(ch_context* context, ch_primitive args[2], ch_op opcode) {
@@ -287,91 +342,494 @@ static ch_primitive binary_op_string(ch_context* context, ch_object* args[2], ch
     return MAKE_NULL();
   }
 
-  // Args are popped in reverse order
-  ch_string* result = ch_concatstring(context, AS_STRING(args[1]), AS_STRING(args[0]));
+  ch_object* result = ch_concat(context, args[0], args[1]);
+
+  return result == NULL ? MAKE_NULL() : MAKE_OBJECT(result);
+}
+
+// Adds count values left to right, either all numbers or all texts. Fails
+// without allocating anything when the types do not match.
+static bool nary_op_add(ch_context* context, ch_primitive* args, ch_argcount count, ch_primitive* result) {
+  if (IS_NUMBER(args[0])) {
+    double sum = AS_NUMBER(args[0]);
+    for (ch_argcount i = 1; i < count; i++) {
+      if (!IS_NUMBER(args[i])) return false;
+      sum += AS_NUMBER(args[i]);
+    }
+
+    *result = MAKE_NUMBER(sum);
+    return true;
+  }
+
+  ch_object* texts[UINT8_MAX];
+  for (ch_argcount i = 0; i < count; i++) {
+    if (!IS_OBJECT(args[i]) || !IS_TEXT(AS_OBJECT(args[i]))) return false;
+    texts[i] = AS_OBJECT(args[i]);
+  }
+
+  // Too long a text is an error of its own, raised by ch_concatn
+  ch_object* text = ch_concatn(context, texts, count);
+  *result = text == NULL ? MAKE_NULL() : MAKE_OBJECT(text);
+  return true;
+}
+
+// The array a value refers to, or NULL once an error is reported
+static ch_array *check_array(ch_context *context, ch_primitive value) {
+  if (IS_OBJECT(value) && IS_ARRAY(AS_OBJECT(value)))
+    return AS_ARRAY(AS_OBJECT(value));
+
+  ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Can only index arrays and maps.");
+  return NULL;
+}
+
+// The map a value refers to, or NULL once an error is reported
+static ch_map *check_map(ch_context *context, ch_primitive value) {
+  if (IS_OBJECT(value) && IS_MAP(AS_OBJECT(value)))
+    return AS_MAP(AS_OBJECT(value));
 
-  return MAKE_OBJECT(result);
+  ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Can only access members of maps.");
+  return NULL;
 }
 
-ch_primitive ch_vm_call(ch_context *context, ch_string *function_name) {
+// Maps are indexed by text
+static bool check_key(ch_context *context, ch_primitive key) {
+  if (IS_OBJECT(key) && IS_TEXT(AS_OBJECT(key)))
+    return true;
+
+  ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Map key must be a string.");
+  return false;
+}
+
+// Finds the value under the key of an access site, going through the site's
+// inline cache. Only slots of the current storage are cached, keys still to
+// be migrated by a resize are looked up every time.
+static ch_primitive *lookup_member(ch_map *map, ch_code *site) {
+  ch_table_slots *slots = &map->table.slots;
+  uint32_t slot = site[1].index;
+  if (slot < slots->capacity && CH_TABLE_IN_USE(slots, slot) &&
+      slots->keys[slot] == site[0].string) {
+    return &slots->values[slot];
+  }
+
+  ch_primitive *value = ch_table_get(&map->table, site[0].string);
+  if (value != NULL && value >= slots->values &&
+      value < slots->values + slots->capacity) {
+    site[1].index = (uint32_t)(value - slots->values);
+  }
+
+  return value;
+}
+
+// Numeric arrays only hold numbers
+static bool check_element(ch_context *context, ch_primitive value) {
+  if (IS_NUMBER(value))
+    return true;
+
+  ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Numeric arrays can only hold numbers.");
+  return false;
+}
+
+// Indices are whole numbers below the size of the array
+static bool check_index(ch_context *context, uint32_t count, ch_primitive index, uint32_t *position) {
+  if (!IS_NUMBER(index)) {
+    ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Array index must be a number.");
+    return false;
+  }
+
+  double number = AS_NUMBER(index);
+  if (!(number >= 0 && number < count) || number != (uint32_t)number) {
+    ch_runtime_error(context, EXIT_USER_ERROR, "Array index %g is out of range for size %" PRIu32 ".", number, count);
+    return false;
+  }
+
+  *position = (uint32_t)number;
+  return true;
+}
+
+/*
+  The interpreter loop can be built in two flavours. With threaded dispatch
+  (GCC/Clang labels-as-values), every handler ends with its own indirect jump
+  to the next handler and only ops that can fail re-check the exit flag. The
+  plain switch is kept as a portable fallback, and is selected by defining
+  CH_THREADED_DISPATCH to 0.
+*/
+#if CH_THREADED_DISPATCH
+#define VM_TARGET(op) TARGET_##op:
+#define VM_DEFAULT() TARGET_UNKNOWN:
+#define VM_DISPATCH()                                                          \
+  do {                                                                         \
+    opcode = (context->pcurrent++)->op;                                        \
+    goto *dispatch_table[opcode];                                              \
+  } while (0)
+#define VM_NEXT() VM_DISPATCH()
+#define VM_CHECKED_NEXT()                                                      \
+  do {                                                                         \
+    if (context->exit != RUNNING)                                              \
+      goto exit_loop;                                                          \
+    VM_DISPATCH();                                                             \
+  } while (0)
+#else
+#define VM_TARGET(op) case op:
+#define VM_DEFAULT() default:
+// The while loop already checks the exit flag after every instruction
+#define VM_NEXT() break
+#define VM_CHECKED_NEXT() break
+#endif
+
+ch_primitive ch_vm_call(ch_context *context, uint32_t function_slot) {
   size_t initial_stack_size = context->stack.size;
+  uint32_t opcode;
+
+  // Globals are already defined, skip straight to the call
+  if (context->exit == EXIT_OK && context->pbegin != NULL) {
+    context->exit = RUNNING;
+    context->pcurrent = context->pbegin;
+    context->program_return_value = MAKE_NULL();
+  }
+
+  if (context->exit != RUNNING)
+    goto exit_loop;
+
+#if CH_THREADED_DISPATCH
+  // The loader rejects unknown opcodes, the default target is only a safeguard
+  static const void *dispatch_table[NUMBER_OF_OPCODES] = {
+      [0 ... NUMBER_OF_OPCODES - 1] = &&TARGET_UNKNOWN,
+      [OP_HALT] = &&TARGET_OP_HALT,
+      [OP_POP] = &&TARGET_OP_POP,
+      [OP_POPN] = &&TARGET_OP_POPN,
+      [OP_TOP] = &&TARGET_OP_TOP,
+      [OP_NUMBER] = &&TARGET_OP_NUMBER,
+      [OP_NEGATE] = &&TARGET_OP_NEGATE,
+      [OP_ADD] = &&TARGET_OP_ADD,
+      [OP_ADDONE] = &&TARGET_OP_ADDONE,
+      [OP_SUB] = &&TARGET_OP_SUB,
+      [OP_SUBONE] = &&TARGET_OP_SUBONE,
+      [OP_MUL] = &&TARGET_OP_MUL,
+      [OP_DIV] = &&TARGET_OP_DIV,
+      [OP_CONCATN] = &&TARGET_OP_CONCATN,
+      [OP_ADD_NUM] = &&TARGET_OP_ADD_NUM,
+      [OP_SUB_NUM] = &&TARGET_OP_SUB_NUM,
+      [OP_MUL_NUM] = &&TARGET_OP_MUL_NUM,
+      [OP_DIV_NUM] = &&TARGET_OP_DIV_NUM,
+      [OP_CONCAT_STR] = &&TARGET_OP_CONCAT_STR,
+      [OP_STRING] = &&TARGET_OP_STRING,
+      [OP_FALSE] = &&TARGET_OP_FALSE,
+      [OP_TRUE] = &&TARGET_OP_TRUE,
+      [OP_CHAR] = &&TARGET_OP_CHAR,
+      [OP_NULL] = &&TARGET_OP_NULL,
+      [OP_ARRAY] = &&TARGET_OP_ARRAY,
+      [OP_ARRAY_PUSH] = &&TARGET_OP_ARRAY_PUSH,
+      [OP_INDEX_GET] = &&TARGET_OP_INDEX_GET,
+      [OP_INDEX_SET] = &&TARGET_OP_INDEX_SET,
+      [OP_MAP] = &&TARGET_OP_MAP,
+      [OP_MAP_GET] = &&TARGET_OP_MAP_GET,
+      [OP_MAP_SET] = &&TARGET_OP_MAP_SET,
+      [OP_LOAD_LOCAL] = &&TARGET_OP_LOAD_LOCAL,
+      [OP_SET_LOCAL] = &&TARGET_OP_SET_LOCAL,
+      [OP_LOAD_UPVALUE] = &&TARGET_OP_LOAD_UPVALUE,
+      [OP_SET_UPVALUE] = &&TARGET_OP_SET_UPVALUE,
+      [OP_CLOSE_UPVALUE] = &&TARGET_OP_CLOSE_UPVALUE,
+      [OP_SET_GLOBAL] = &&TARGET_OP_SET_GLOBAL,
+      [OP_DEFINE_GLOBAL] = &&TARGET_OP_DEFINE_GLOBAL,
+      [OP_LOAD_GLOBAL] = &&TARGET_OP_LOAD_GLOBAL,
+      [OP_SET_GLOBAL_SLOT] = &&TARGET_OP_SET_GLOBAL_SLOT,
+      [OP_DEFINE_GLOBAL_SLOT] = &&TARGET_OP_DEFINE_GLOBAL_SLOT,
+      [OP_LOAD_GLOBAL_SLOT] = &&TARGET_OP_LOAD_GLOBAL_SLOT,
+      [OP_BEGIN] = &&TARGET_OP_BEGIN,
+      [OP_CALL] = &&TARGET_OP_CALL,
+      [OP_RETURN_VOID] = &&TARGET_OP_RETURN_VOID,
+      [OP_RETURN_VALUE] = &&TARGET_OP_RETURN_VALUE,
+      [OP_JMP_FALSE] = &&TARGET_OP_JMP_FALSE,
+      [OP_JMP] = &&TARGET_OP_JMP,
+      [OP_FUNCTION] = &&TARGET_OP_FUNCTION,
+      [OP_CLOSURE] = &&TARGET_OP_CLOSURE,
+  };
 
+  VM_DISPATCH();
+#else
   while (context->exit == RUNNING) {
-    uint8_t opcode = *(context->pcurrent);
+    opcode = context->pcurrent->op;
     context->pcurrent++;
 
     switch (opcode) {
-    case OP_NUMBER: {
-      double value = LOAD_NUMBER(context, VM_READ_PTR(context));
+#endif
+    VM_TARGET(OP_NUMBER) {
+      double value = VM_READ(context)->number;
       STACK_PUSH(context, MAKE_NUMBER(value));
-      break;
+      VM_NEXT();
     }
-    case OP_STRING: {
-      ch_string* string = read_string(context);
+    VM_TARGET(OP_STRING) {
+      ch_string* string = VM_READ(context)->string;
       STACK_PUSH(context, MAKE_OBJECT(string));
-      break;
+      VM_NEXT();
     }
-    case OP_FALSE: { 
+    VM_TARGET(OP_FALSE) {
       STACK_PUSH(context, MAKE_BOOLEAN(false));
-      break;
+      VM_NEXT();
     }
-    case OP_TRUE: { 
+    VM_TARGET(OP_TRUE) {
       STACK_PUSH(context, MAKE_BOOLEAN(true));
-      break;
+      VM_NEXT();
     }
-    case OP_CHAR: {
-      char value = VM_READ_CHAR(context);
+    VM_TARGET(OP_CHAR) {
+      char value = VM_READ(context)->character;
       STACK_PUSH(context, MAKE_CHAR(value));
-      break;
+      VM_NEXT();
     }
-    case OP_NULL: {
+    VM_TARGET(OP_NULL) {
       STACK_PUSH(context, MAKE_NULL());
-      break;
+      VM_NEXT();
     }
-    case OP_ADD: 
-    case OP_SUB:
-    case OP_MUL:
-    case OP_DIV: {
+    VM_TARGET(OP_ARRAY) {
+      GC_SAFEPOINT(context);
+      ch_argcount count = VM_READ(context)->index;
+      if (context->stack.size < count) {
+        halt(context, EXIT_STACK_EMPTY);
+        goto exit_loop;
+      }
+
+      // Elements stay on the stack, and reachable, until the array holds them
+      ch_stack_addr first = CH_STACK_ADDR(&context->stack) - count;
+      ch_array *array = ch_loadarray(context, ch_stack_get(&context->stack, first), count);
+      ch_stack_seekto(&context->stack, first);
+      if (array == NULL)
+        VM_CHECKED_NEXT();
+
+      STACK_PUSH(context, MAKE_OBJECT(array));
+      VM_NEXT();
+    }
+    VM_TARGET(OP_ARRAY_PUSH) {
+      GC_SAFEPOINT(context);
+      ch_primitive value;
+      STACK_POP(context, &value);
+
+      ch_primitive target = ch_stack_peek(&context->stack, 0);
+      if (IS_OBJECT(target) && IS_F64ARRAY(AS_OBJECT(target))) {
+        if (check_element(context, value)) {
+          ch_f64arraypush(context, AS_F64ARRAY(AS_OBJECT(target)), AS_NUMBER(value));
+        }
+        VM_CHECKED_NEXT();
+      }
+
+      ch_array *array = check_array(context, target);
+      if (array != NULL) {
+        ch_arraypush(context, array, value);
+      }
+      VM_CHECKED_NEXT();
+    }
+    VM_TARGET(OP_INDEX_GET) {
+      GC_SAFEPOINT(context);
+      ch_primitive index, target;
+      STACK_POP(context, &index);
+      STACK_POP(context, &target);
+
+      uint32_t position;
+      if (IS_OBJECT(target) && IS_F64ARRAY(AS_OBJECT(target))) {
+        ch_f64array *numbers = AS_F64ARRAY(AS_OBJECT(target));
+        if (!check_index(context, numbers->count, index, &position))
+          VM_CHECKED_NEXT();
+
+        STACK_PUSH(context, MAKE_NUMBER(numbers->values[position]));
+        VM_NEXT();
+      }
+
+      if (IS_OBJECT(target) && IS_MAP(AS_OBJECT(target))) {
+        if (!check_key(context, index))
+          VM_CHECKED_NEXT();
+
+        // Flattening the index can run out of memory
+        ch_primitive *member = ch_mapfind(context, AS_MAP(AS_OBJECT(target)), AS_OBJECT(index));
+        STACK_PUSH(context, member == NULL ? MAKE_NULL() : *member);
+        VM_CHECKED_NEXT();
+      }
+
+      ch_array *array = check_array(context, target);
+      if (array == NULL || !check_index(context, array->count, index, &position))
+        VM_CHECKED_NEXT();
+
+      STACK_PUSH(context, array->values[position]);
+      VM_NEXT();
+    }
+    VM_TARGET(OP_INDEX_SET) {
+      GC_SAFEPOINT(context);
+      ch_primitive value, index, target;
+      STACK_POP(context, &value);
+      STACK_POP(context, &index);
+      STACK_POP(context, &target);
+
+      uint32_t position;
+      if (IS_OBJECT(target) && IS_F64ARRAY(AS_OBJECT(target))) {
+        ch_f64array *numbers = AS_F64ARRAY(AS_OBJECT(target));
+        if (!check_index(context, numbers->count, index, &position) ||
+            !check_element(context, value))
+          VM_CHECKED_NEXT();
+
+        numbers->values[position] = AS_NUMBER(value);
+        VM_NEXT();
+      }
+
+      if (IS_OBJECT(target) && IS_MAP(AS_OBJECT(target))) {
+        if (!check_key(context, index))
+          VM_CHECKED_NEXT();
+
+        ch_string *key = ch_mapkey(context, AS_OBJECT(index));
+        if (key != NULL) {
+          ch_mapset(context, AS_MAP(AS_OBJECT(target)), key, value);
+        }
+        VM_CHECKED_NEXT();
+      }
+
+      ch_array *array = check_array(context, target);
+      if (array == NULL || !check_index(context, array->count, index, &position))
+        VM_CHECKED_NEXT();
+
+      CH_GC_CONTAINER_BARRIER(context, array, value);
+      array->values[position] = value;
+      VM_NEXT();
+    }
+    VM_TARGET(OP_MAP) {
+      GC_SAFEPOINT(context);
+      STACK_PUSH(context, MAKE_OBJECT(ch_loadmap(context)));
+      VM_NEXT();
+    }
+    VM_TARGET(OP_MAP_GET) {
+      ch_code *site = VM_READ_MAP_SITE(context);
+      ch_primitive target;
+      STACK_POP(context, &target);
+
+      ch_map *map = check_map(context, target);
+      if (map == NULL)
+        VM_CHECKED_NEXT();
+
+      // Missing members read as null
+      ch_primitive *member = lookup_member(map, site);
+      STACK_PUSH(context, member == NULL ? MAKE_NULL() : *member);
+      VM_NEXT();
+    }
+    VM_TARGET(OP_MAP_SET) {
+      GC_SAFEPOINT(context);
+      ch_code *site = VM_READ_MAP_SITE(context);
+      ch_primitive value;
+      STACK_POP(context, &value);
+
+      ch_map *map = check_map(context, ch_stack_peek(&context->stack, 0));
+      if (map == NULL)
+        VM_CHECKED_NEXT();
+
+      ch_primitive *member = lookup_member(map, site);
+      if (member != NULL) {
+        CH_GC_CONTAINER_BARRIER(context, map, value);
+        *member = value;
+        VM_NEXT();
+      }
+
+      if (!ch_mapset(context, map, site[0].string, value))
+        VM_CHECKED_NEXT();
+
+      lookup_member(map, site);
+      VM_NEXT();
+    }
+    VM_TARGET(OP_ADD)
+    VM_TARGET(OP_SUB)
+    VM_TARGET(OP_MUL)
+    VM_TARGET(OP_DIV) {
+      GC_SAFEPOINT(context);
       ch_primitive args[2];
       binary_op_args(context, args);
 
-      if (args[0].type != args[1].type) {
+      if (PRIMITIVE_TYPE(args[0]) != PRIMITIVE_TYPE(args[1])) {
         ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Can only apply binary operator on matching types.");
-        break;
+        VM_CHECKED_NEXT();
       }
 
-      ch_primitive result;
       if (IS_NUMBER(args[0])) {
         STACK_PUSH(context, binary_op_number(context, args, opcode));
-        break;
+        VM_CHECKED_NEXT();
       }
 
       if (IS_OBJECT(args[0])) {
         ch_object* object_args[2] = {AS_OBJECT(args[0]), AS_OBJECT(args[1])};
-        if (object_args[0]->type != object_args[1]->type) {
-          ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Can only apply binary operator on matching object types.");
-          break;
+        // Strings and ropes mix freely
+        if (IS_TEXT(object_args[0]) && IS_TEXT(object_args[1])) {
+          STACK_PUSH(context, binary_op_string(context, object_args, opcode));
+          VM_CHECKED_NEXT();
         }
 
-        if (IS_STRING(object_args[0])) {
-          STACK_PUSH(context, binary_op_string(context, object_args, opcode));
-          break;
+        if (object_args[0]->type != object_args[1]->type) {
+          ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Can only apply binary operator on matching object types.");
+          VM_CHECKED_NEXT();
         }
 
         ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Cannot apply binary operation to object type: %d", object_args[0]->type);
-        break;
+        VM_CHECKED_NEXT();
       }
 
-      ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Cannot apply binary operation to primitive type: %d", args[0].type);
-      break;
+      ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Cannot apply binary operation to primitive type: %d", PRIMITIVE_TYPE(args[0]));
+      VM_CHECKED_NEXT();
+    }
+    VM_TARGET(OP_CONCATN) {
+      GC_SAFEPOINT(context);
+      ch_argcount count = VM_READ(context)->index;
+      if (context->stack.size < count) {
+        halt(context, EXIT_STACK_EMPTY);
+        goto exit_loop;
+      }
+
+      // Operands stay on the stack until the result is built, which keeps them
+      // reachable and in source order
+      ch_stack_addr first = CH_STACK_ADDR(&context->stack) - count;
+      ch_primitive result;
+      if (!nary_op_add(context, ch_stack_get(&context->stack, first), count, &result)) {
+        ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Can only apply binary operator on matching types.");
+        VM_CHECKED_NEXT();
+      }
+
+      ch_stack_seekto(&context->stack, first);
+      STACK_PUSH(context, result);
+      VM_CHECKED_NEXT();
+    }
+    // The compiler only emits these when it knows the operand types
+    VM_TARGET(OP_ADD_NUM) {
+      ch_primitive args[2];
+      binary_op_args(context, args);
+      STACK_PUSH(context, MAKE_NUMBER(AS_NUMBER(args[0]) + AS_NUMBER(args[1])));
+      VM_NEXT();
+    }
+    VM_TARGET(OP_SUB_NUM) {
+      ch_primitive args[2];
+      binary_op_args(context, args);
+      STACK_PUSH(context, MAKE_NUMBER(AS_NUMBER(args[0]) - AS_NUMBER(args[1])));
+      VM_NEXT();
+    }
+    VM_TARGET(OP_MUL_NUM) {
+      ch_primitive args[2];
+      binary_op_args(context, args);
+      STACK_PUSH(context, MAKE_NUMBER(AS_NUMBER(args[0]) * AS_NUMBER(args[1])));
+      VM_NEXT();
+    }
+    VM_TARGET(OP_DIV_NUM) {
+      ch_primitive args[2];
+      binary_op_args(context, args);
+      STACK_PUSH(context, MAKE_NUMBER(AS_NUMBER(args[0]) / AS_NUMBER(args[1])));
+      VM_NEXT();
+    }
+    VM_TARGET(OP_CONCAT_STR) {
+      GC_SAFEPOINT(context);
+      ch_primitive args[2];
+      binary_op_args(context, args);
+      ch_object *result = ch_concat(context, AS_OBJECT(args[0]), AS_OBJECT(args[1]));
+      if (result != NULL) {
+        STACK_PUSH(context, MAKE_OBJECT(result));
+      }
+      VM_CHECKED_NEXT();
     }
-    case OP_ADDONE:
-    case OP_SUBONE: {
+    VM_TARGET(OP_ADDONE)
+    VM_TARGET(OP_SUBONE) {
       ch_primitive entry;
       STACK_POP(context, &entry);
       if (!IS_NUMBER(entry)) {
         ch_runtime_error(context, EXIT_INCORRECT_TYPE, "Expected number for addone, subone op");
-        break;
+        VM_CHECKED_NEXT();
       }
 
       double value;
@@ -382,9 +840,9 @@ ch_primitive ch_vm_call(ch_context *context, ch_string *function_name) {
       }
 
       STACK_PUSH(context, MAKE_NUMBER(value));
-      break;
+      VM_NEXT();
     }
-    case OP_NEGATE: {
+    VM_TARGET(OP_NEGATE) {
       ch_primitive entry;
       STACK_POP(context, &entry);
 
@@ -392,101 +850,146 @@ ch_primitive ch_vm_call(ch_context *context, ch_string *function_name) {
       if(ch_checknumber(context, entry, &value)) {
         STACK_PUSH(context, MAKE_NUMBER(-value));
       }
-      break;
+      VM_CHECKED_NEXT();
     }
-    case OP_HALT: {
-      context->exit = EXIT_OK;
-      break;
+    VM_TARGET(OP_HALT) {
+      halt(context, EXIT_OK);
+      goto exit_loop;
     }
-    case OP_POP: {
+    VM_TARGET(OP_POP) {
       ch_primitive entry;
       STACK_POP(context, &entry);
-      break;
+      VM_NEXT();
     }
-    case OP_POPN: {
-      ch_dataptr num_popped = VM_READ_PTR(context);
+    VM_TARGET(OP_POPN) {
+      uint32_t num_popped = VM_READ(context)->index;
 
       // TODO add runtime check?
       ch_stack_popn(&context->stack, num_popped);
-      break;
+      VM_NEXT();
     }
-    case OP_TOP: {
+    VM_TARGET(OP_TOP) {
       ch_stack_copy(&context->stack, CH_STACK_ADDR(&context->stack) - 1);
-      break;
+      VM_NEXT();
     }
-    case OP_LOAD_LOCAL: {
-      uint8_t offset = (uint8_t)VM_READ_PTR(context);
+    VM_TARGET(OP_LOAD_LOCAL) {
+      uint8_t offset = (uint8_t)VM_READ(context)->index;
       ch_stack_addr index = CURRENT_CALL(context).stack_addr + offset;
       ch_stack_copy(&context->stack, index);
-      break;
+      VM_NEXT();
     }
-    case OP_SET_LOCAL: {
+    VM_TARGET(OP_SET_LOCAL) {
       ch_primitive entry;
       STACK_POP(context, &entry);
 
-      uint8_t offset = (uint8_t)VM_READ_PTR(context);
+      uint8_t offset = (uint8_t)VM_READ(context)->index;
       ch_stack_addr index = CURRENT_CALL(context).stack_addr + offset;
 
       ch_stack_set(&context->stack, index, entry);
-      break;
+      VM_NEXT();
     }
-    case OP_LOAD_UPVALUE: {
-      uint8_t index = VM_READ_ARGCOUNT(context);
+    VM_TARGET(OP_LOAD_UPVALUE) {
+      uint8_t index = VM_READ(context)->index;
       ch_primitive* value = CURRENT_CALL(context).closure->upvalues[index]->value;
       STACK_PUSH(context, *value);
-      break;
+      VM_NEXT();
     }
-    case OP_SET_UPVALUE: {
-      uint8_t index = VM_READ_ARGCOUNT(context);
+    VM_TARGET(OP_SET_UPVALUE) {
+      uint8_t index = VM_READ(context)->index;
       ch_primitive value;
       STACK_POP(context, &value);
 
-      *CURRENT_CALL(context).closure->upvalues[index]->value = value;
-      break;
+      ch_upvalue* upvalue = CURRENT_CALL(context).closure->upvalues[index];
+      CH_GC_UPVALUE_BARRIER(context, upvalue, value);
+      *upvalue->value = value;
+      VM_NEXT();
     }
-    case OP_CLOSE_UPVALUE: {
+    VM_TARGET(OP_CLOSE_UPVALUE) {
       ch_primitive* closed = ch_stack_get(&context->stack, context->stack.size - 1);
       close_upvalues(context, closed);
       ch_stack_popn(&context->stack, 1);
-      break;
+      VM_NEXT();
     }
-    case OP_DEFINE_GLOBAL:
-    case OP_SET_GLOBAL: {
-      ch_string *name = read_string(context);
+    VM_TARGET(OP_DEFINE_GLOBAL)
+    VM_TARGET(OP_SET_GLOBAL) {
+      ch_code *site = VM_READ_GLOBAL_SITE(context);
 
       ch_primitive entry;
       STACK_POP(context, &entry);
 
-      set_global(context, name, entry, opcode == OP_SET_GLOBAL ? REDEFINE_GLOBAL : CREATE_GLOBAL);
+      set_global(context, site, entry, opcode == OP_SET_GLOBAL ? REDEFINE_GLOBAL : CREATE_GLOBAL);
 
-      break;
+      VM_CHECKED_NEXT();
     }
-    case OP_LOAD_GLOBAL: {
-      ch_string *name = read_string(context);
-      get_global(context, name);
-      break;
+    VM_TARGET(OP_LOAD_GLOBAL) {
+      ch_code *site = VM_READ_GLOBAL_SITE(context);
+      load_global(context, site);
+      VM_CHECKED_NEXT();
+    }
+    VM_TARGET(OP_LOAD_GLOBAL_SLOT) {
+      uint32_t slot = VM_READ(context)->index;
+      if (!context->globals.defined[slot]) {
+        undefined_global(context, slot);
+        VM_CHECKED_NEXT();
+      }
+
+      STACK_PUSH(context, context->globals.values[slot]);
+      VM_NEXT();
+    }
+    VM_TARGET(OP_SET_GLOBAL_SLOT) {
+      uint32_t slot = VM_READ(context)->index;
+      ch_primitive entry;
+      STACK_POP(context, &entry);
+
+      if (!context->globals.defined[slot]) {
+        ch_runtime_error(context, EXIT_GLOBAL_NOT_FOUND, "Cannot assign to non existing global variable: %s.", context->globals.names[slot]->value);
+        VM_CHECKED_NEXT();
+      }
+
+      CH_GC_BARRIER(context, entry);
+      context->globals.values[slot] = entry;
+      VM_NEXT();
     }
-    case OP_FUNCTION: {
-      ch_dataptr function_ptr = VM_READ_PTR(context);
-      ch_argcount argcount = VM_READ_ARGCOUNT(context);
+    VM_TARGET(OP_DEFINE_GLOBAL_SLOT) {
+      uint32_t slot = VM_READ(context)->index;
+      ch_primitive entry;
+      STACK_POP(context, &entry);
+
+      if (is_defined_by_script(context, slot)) {
+        ch_runtime_error(context, EXIT_GLOBAL_NOT_FOUND, "Cannot redefine global variable: %s.", context->globals.names[slot]->value);
+        VM_CHECKED_NEXT();
+      }
+
+      CH_GC_BARRIER(context, entry);
+      context->globals.values[slot] = entry;
+      context->globals.defined[slot] = true;
+      context->globals.builtin[slot] = false;
+      VM_NEXT();
+    }
+    VM_TARGET(OP_FUNCTION) {
+      GC_SAFEPOINT(context);
+      ch_dataptr function_ptr = VM_READ(context)->index;
+      ch_argcount argcount = VM_READ(context)->index;
       ch_primitive function =
-          MAKE_OBJECT(ch_loadfunction(function_ptr, argcount));
+          MAKE_OBJECT(ch_loadfunction(context, function_ptr, argcount));
       STACK_PUSH(context, function);
-      break;
+      VM_NEXT();
     }
-    case OP_CLOSURE: {
-      uint8_t upvalue_count = VM_READ_ARGCOUNT(context);
+    VM_TARGET(OP_CLOSURE) {
+      GC_SAFEPOINT(context);
+      uint8_t upvalue_count = VM_READ(context)->index;
       ch_primitive value;
       STACK_POP(context, &value);
       ch_function* function = NULL;
-      if(!ch_checkfunction(context, value, &function)) break;
+      if(!ch_checkfunction(context, value, &function)) VM_CHECKED_NEXT();
 
-      ch_closure* closure = ch_loadclosure(function, upvalue_count);
+      ch_closure* closure = ch_loadclosure(context, function, upvalue_count);
       STACK_PUSH(context, MAKE_OBJECT(closure));
 
       for(uint8_t i = 0; i < upvalue_count; i++) {
-        uint8_t is_local = VM_READ_ARGCOUNT(context);
-        uint8_t index = VM_READ_ARGCOUNT(context);
+        ch_code *upvalue = VM_READ(context);
+        uint8_t is_local = upvalue->upvalue.is_local;
+        uint8_t index = upvalue->upvalue.index;
 
         if (is_local) {
           ch_stack_addr addr = CURRENT_CALL(context).stack_addr + index;
@@ -494,27 +997,39 @@ ch_primitive ch_vm_call(ch_context *context, ch_string *function_name) {
         } else {
           closure->upvalues[i] = CURRENT_CALL(context).closure->upvalues[index];
         }
+        CH_GC_BARRIER(context, MAKE_OBJECT(closure->upvalues[i]));
       }
-      break;
+      VM_NEXT();
     }
-    case OP_BEGIN: {
-      get_global(context, function_name);
-      ch_primitive function;
-      STACK_POP(context, &function);
+    VM_TARGET(OP_BEGIN) {
+      context->pbegin = context->pcurrent - 1;
+      if (!context->globals.defined[function_slot]) {
+        undefined_global(context, function_slot);
+        VM_CHECKED_NEXT();
+      }
+      ch_primitive function = context->globals.values[function_slot];
 
       try_call(context, function, initial_stack_size);
-      break;
+
+      // Natives return immediately, there is no frame to come back from
+      if (context->exit == RUNNING && context->call_stack.size == 0) {
+        context->program_return_value = ch_pop(context);
+        halt(context, EXIT_OK);
+      }
+      VM_CHECKED_NEXT();
     }
-    case OP_CALL: {
-      ch_argcount argcount = VM_READ_ARGCOUNT(context);
+    VM_TARGET(OP_CALL) {
+      // Natives may allocate, they never trigger a collection themselves
+      GC_SAFEPOINT(context);
+      ch_argcount argcount = VM_READ(context)->index;
 
       ch_primitive function;
       STACK_POP(context, &function);
 
       try_call(context, function, argcount);
-      break;
+      VM_CHECKED_NEXT();
     }
-    case OP_RETURN_VALUE: {
+    VM_TARGET(OP_RETURN_VALUE) {
       ch_primitive returned_value;
       STACK_POP(context, &returned_value);
 
@@ -524,38 +1039,54 @@ ch_primitive ch_vm_call(ch_context *context, ch_string *function_name) {
       if (context->call_stack.size != 0) {
         STACK_PUSH(context, returned_value);
       } else {
+        // The host only ever sees flat, interned strings
+        if (IS_OBJECT(returned_value) && IS_TEXT(AS_OBJECT(returned_value))) {
+          ch_string *string = ch_flatten(context, AS_OBJECT(returned_value));
+          if (string == NULL)
+            VM_CHECKED_NEXT();
+
+          returned_value = MAKE_OBJECT(ch_internstring(context, string));
+        }
         context->program_return_value = returned_value;
+        halt(context, EXIT_OK);
       }
 
-      break;
+      VM_CHECKED_NEXT();
     }
-    case OP_RETURN_VOID: {
+    VM_TARGET(OP_RETURN_VOID) {
       call_return(context);
-      break;
+
+      if (context->call_stack.size == 0) {
+        halt(context, EXIT_OK);
+      }
+      VM_CHECKED_NEXT();
     }
-    case OP_JMP: {
-      ch_jmpptr ptr = VM_READ_JMPPTR(context);
-      jump(context, ptr);
-      break;
+    VM_TARGET(OP_JMP) {
+      ch_code *target = VM_READ(context)->target;
+      jump(context, target);
+      VM_NEXT();
     }
-    case OP_JMP_FALSE: {
-      ch_jmpptr ptr = VM_READ_JMPPTR(context);
+    VM_TARGET(OP_JMP_FALSE) {
+      ch_code *target = VM_READ(context)->target;
 
       ch_primitive peek = ch_stack_peek(&context->stack, 0);
 
       if (ch_primitive_isfalsy(peek)) {
-        jump(context, ptr);
+        jump(context, target);
       }
-      break;
+      VM_NEXT();
     }
-    default: {
+    VM_DEFAULT() {
       ch_runtime_error(context, EXIT_UNKNOWN_INSTRUCTION,
                        "Unknown instruction.");
-      break;
+      goto exit_loop;
     }
+#if !CH_THREADED_DISPATCH
     }
   }
+#endif
 
+exit_loop:
   if (context->exit != EXIT_OK) {
     printf("Runtime error: %d.\n", context->exit);
   } else {
@@ -568,9 +1099,9 @@ ch_primitive ch_vm_call(ch_context *context, ch_string *function_name) {
 void ch_addnative(ch_context *context, ch_native_function function,
                   const char *name) {
   ch_string *s = ch_loadstring(context, name, strlen(name), true);
-  ch_native *native = ch_loadnative(function);
+  ch_native *native = ch_loadnative(context, function);
 
-  add_global(context, s, MAKE_OBJECT(native));
+  add_global(context, s, MAKE_OBJECT(native), true);
 }
 
 void ch_runtime_error(ch_context *context, ch_exit exit, const char *error,
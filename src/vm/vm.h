@@ -1,8 +1,9 @@
 #pragma once
 #include "chapman.h"
 
-ch_context ch_vm_newcontext(ch_program program);
+ch_context ch_vm_newcontext(ch_program program, ch_allocator allocator);
 
 void ch_vm_free(ch_context *context);
 
-ch_primitive ch_vm_call(ch_context *context, ch_string *function_name);
+// Runs the program's setup code, then calls the global stored at function_slot
+ch_primitive ch_vm_call(ch_context *context, uint32_t function_slot);
@@ -0,0 +1,148 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <string.h>
+#include <vm/chapman.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_literals_and_indexing() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val a = [1, 2, 3 + 4]; val b = []; return a[2] * 10 + a[0] + size(b); }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(71, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_nested_arrays() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val a = [[1, 2], [3, [4, 5]]]; a[1][1][0] = 40; return a[1][1][0] + a[0][1]; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(42, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_index_assignment() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val a = [\"x\", 2]; val i = 1; a[i] = a[i] + 5; a[0] = 10; return a[0] + a[1]; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(17, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_appends_grow_the_array() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val a = []; val n = 0; val i = 1000; while (i) { a[] = n; n++; i--; } return a; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    ch_array* array = AS_ARRAY(AS_OBJECT(result));
+    TEST_ASSERT_TRUE(IS_ARRAY(AS_OBJECT(result)));
+    TEST_ASSERT_EQUAL(1000, array->count);
+    TEST_ASSERT_TRUE(array->capacity >= 1000 && array->capacity < 2000);
+    TEST_ASSERT_EQUAL(999, AS_NUMBER(array->values[999]));
+    ch_freevm(&vm);
+}
+
+void test_long_literals() {
+    char program[2048] = "#main() { val a = [";
+    for (int i = 0; i < 300; i++) {
+        strcat(program, i ? ",1" : "1");
+    }
+    strcat(program, "]; return size(a) + a[299]; }");
+
+    ch_context vm;
+    ch_primitive result = run_program(program, &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(301, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_index_out_of_range() {
+    ch_context vm;
+    run_program("#main() { val a = [1, 2]; return a[2]; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_USER_ERROR, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { val a = [1, 2]; a[0.5] = 1; return 0; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_USER_ERROR, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { val a = 1; return a[0]; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_INCORRECT_TYPE, vm.exit);
+    ch_freevm(&vm);
+}
+
+void test_arrays_survive_collections() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val a = []; val s = \"s\"; val three = \"three\"; val i = 500; while (i) { a[] = s + \"t\"; i--; } a[3] = three + \"!\"; return a;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setgrowth(&vm, 0);
+    ch_gc_setincremental(&vm, 1);
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    ch_array* array = AS_ARRAY(AS_OBJECT(result));
+    TEST_ASSERT_EQUAL(500, array->count);
+    TEST_ASSERT_EQUAL_STRING("three!", AS_STRING(AS_OBJECT(array->values[3]))->value);
+    TEST_ASSERT_TRUE(IS_STRING(AS_OBJECT(array->values[499])));
+    ch_freevm(&vm);
+}
+
+void test_escaping_arrays_are_promoted() {
+    ch_program compiled_program;
+    char program[] = "val saved = null; #save() { val ab = \"ab\"; val a = [ab + \"cd\"]; a[] = [1, 2]; saved = a; return 0; }"
+                     "#main() { return size(saved) + saved[1][1]; }";
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setarena(&vm, true);
+    ch_runfunction(&vm, "save");
+    ch_array* saved = AS_ARRAY(AS_OBJECT(vm.globals.values[0]));
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_FALSE(saved->object.in_arena);
+    TEST_ASSERT_FALSE(AS_OBJECT(saved->values[0])->in_arena);
+    TEST_ASSERT_FALSE(AS_OBJECT(saved->values[1])->in_arena);
+    TEST_ASSERT_EQUAL(4, AS_NUMBER(ch_runfunction(&vm, "main")));
+    ch_freevm(&vm);
+}
+
+void test_heap_arrays_keep_arena_values() {
+    ch_program compiled_program;
+    char program[] = "val saved = []; #save() { val ab = \"ab\"; val ef = \"ef\"; saved[] = ab + \"cd\"; saved[0] = [ef + \"gh\"]; saved[] = 1; return 0; }"
+                     "#main() { return saved[0][0]; }";
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setarena(&vm, true);
+    ch_runfunction(&vm, "save");
+    ch_array* saved = AS_ARRAY(AS_OBJECT(vm.globals.values[0]));
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(2, saved->count);
+    TEST_ASSERT_FALSE(AS_OBJECT(saved->values[0])->in_arena);
+    TEST_ASSERT_FALSE(saved->remembered);
+    ch_primitive result = ch_runfunction(&vm, "main");
+    TEST_ASSERT_EQUAL_STRING("efgh", AS_STRING(AS_OBJECT(result))->value);
+    ch_freevm(&vm);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_literals_and_indexing);
+    RUN_TEST(test_nested_arrays);
+    RUN_TEST(test_index_assignment);
+    RUN_TEST(test_appends_grow_the_array);
+    RUN_TEST(test_long_literals);
+    RUN_TEST(test_index_out_of_range);
+    RUN_TEST(test_arrays_survive_collections);
+    RUN_TEST(test_escaping_arrays_are_promoted);
+    RUN_TEST(test_heap_arrays_keep_arena_values);
+    return UNITY_END();
+}
@@ -12,8 +12,8 @@ void test_closure_captures_parent_variables() {
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, result.type);
-    TEST_ASSERT_EQUAL(10, result.number_value);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(10, AS_NUMBER(result));
 }
 
 void test_closure_modifies_parent_variables() {
@@ -21,8 +21,8 @@ void test_closure_modifies_parent_variables() {
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, result.type);
-    TEST_ASSERT_EQUAL(20, result.number_value);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(20, AS_NUMBER(result));
 }
 
 void test_closure_promotes_captured_variable_to_heap_when_parent_function_returns() {
@@ -30,8 +30,8 @@ void test_closure_promotes_captured_variable_to_heap_when_parent_function_return
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, result.type);
-    TEST_ASSERT_EQUAL(10, result.number_value);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(10, AS_NUMBER(result));
 }
 
 int main(void) {
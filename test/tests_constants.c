@@ -0,0 +1,121 @@
+#include <unity.h>
+#include <math.h>
+#include <stdbool.h>
+#include <vm/chapman.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_string_constant_is_materialized_once() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val a = \"word\"; val b = \"word\"; return a;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_TRUE(IS_STRING(AS_OBJECT(result)));
+    TEST_ASSERT_EQUAL_PTR(AS_OBJECT(result), ch_loadstring(&vm, "word", 4, COPY_STRING));
+}
+
+void test_contexts_share_constants_of_a_program() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val s = \"shared\"; return s;", &compiled_program));
+    ch_loadconstants(&compiled_program);
+
+    ch_context first = ch_newvm(compiled_program);
+    ch_context second = ch_newvm(compiled_program);
+    ch_primitive first_result = ch_runfunction(&first, "main");
+    ch_primitive second_result = ch_runfunction(&second, "main");
+
+    TEST_ASSERT_EQUAL_PTR(AS_OBJECT(first_result), AS_OBJECT(second_result));
+
+    // The remaining context keeps the pool alive
+    ch_freeconstants(&compiled_program);
+    ch_freevm(&first);
+    second_result = ch_runfunction(&second, "main");
+    TEST_ASSERT_EQUAL_STRING("shared", AS_STRING(AS_OBJECT(second_result))->value);
+    ch_freevm(&second);
+}
+
+void test_runtime_string_resolves_to_constant() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val a = \"ab\"; val first = \"a\"; val b = first + \"b\"; return b;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL_PTR(AS_OBJECT(result), ch_loadstring(&vm, "ab", 2, COPY_STRING));
+}
+
+static size_t code_size(char* program) {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile(program, &compiled_program));
+    return compiled_program.total_size - compiled_program.data_size;
+}
+
+void test_constant_expressions_are_folded() {
+    TEST_ASSERT_EQUAL(code_size("return 5;"), code_size("return 2 * 3 + -4 / (1 + 3);"));
+    TEST_ASSERT_EQUAL(code_size("return \"abc\";"), code_size("return \"a\" + \"b\" + \"c\";"));
+    TEST_ASSERT_EQUAL(code_size("val x = 1; return x + 2;"), code_size("val x = 1; return x + 1 * 2;"));
+
+    TEST_ASSERT_EQUAL(5, AS_NUMBER(run("return 2 * 3 + -4 / (1 + 3);")));
+    TEST_ASSERT_EQUAL(-7, AS_NUMBER(run("return 3 - 10;")));
+}
+
+void test_folded_strings_are_constants() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val a = \"ab\" + \"cd\"; return 0;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_runfunction(&vm, "main");
+    ch_gc_collect(&vm);
+
+    // Constants are never collected
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_NOT_NULL(ch_table_find_string(&vm.strings, "abcd", 4));
+    ch_freevm(&vm);
+}
+
+void test_mixed_constants_are_not_folded() {
+    ch_context vm;
+    run_program("#main() { return 1 + \"a\"; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_INCORRECT_TYPE, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { return \"a\" - \"b\"; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_UNSUPPORTED_OPERATION, vm.exit);
+    ch_freevm(&vm);
+}
+
+void test_constants_after_jump_targets_are_not_folded() {
+    // Short circuits jump right past the constant on the right
+    TEST_ASSERT_EQUAL(7, AS_NUMBER(run("val a = 5; return (a || 1) + 2;")));
+    TEST_ASSERT_EQUAL(7, AS_NUMBER(run("val a = 0; return (a && 1) * 2 + 7;")));
+}
+
+void test_numbers_are_deduplicated() {
+    ch_program same, different;
+    TEST_ASSERT_TRUE(compile("val a = 1.5; val b = 1.5; return a + b;", &same));
+    TEST_ASSERT_TRUE(compile("val a = 1.5; val b = 2.5; return a + b;", &different));
+    TEST_ASSERT_EQUAL(different.data_size - sizeof(double), same.data_size);
+
+    // Zero and negative zero are different constants
+    double result = AS_NUMBER(run("val a = 0; val b = -0; return 1 / b;"));
+    TEST_ASSERT_TRUE(isinf(result) && result < 0);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_string_constant_is_materialized_once);
+    RUN_TEST(test_contexts_share_constants_of_a_program);
+    RUN_TEST(test_runtime_string_resolves_to_constant);
+    RUN_TEST(test_constant_expressions_are_folded);
+    RUN_TEST(test_folded_strings_are_constants);
+    RUN_TEST(test_mixed_constants_are_not_folded);
+    RUN_TEST(test_constants_after_jump_targets_are_not_folded);
+    RUN_TEST(test_numbers_are_deduplicated);
+
+    return UNITY_END();
+}
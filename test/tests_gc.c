@@ -0,0 +1,210 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <string.h>
+#include <vm/chapman.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static size_t count_objects(ch_context* vm) {
+    size_t count = 0;
+    for (ch_object* object = vm->gc.objects; object != NULL; object = object->next) {
+        count++;
+    }
+
+    return count;
+}
+
+static ch_context stressed_vm(char* program) {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setgrowth(&vm, 0);
+    return vm;
+}
+
+void test_garbage_strings_are_collected() {
+    ch_context vm = stressed_vm("#main() { val s = \"\"; val ab = \"ab\"; val i = 500; while (i) { s = ab + \"cd\" + \"ef\"; i--; } return s; }");
+    size_t natives = count_objects(&vm);
+
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL_STRING("abcdef", AS_STRING(AS_OBJECT(result))->value);
+    // Natives, the main function and the live strings
+    TEST_ASSERT_TRUE(count_objects(&vm) < natives + 10);
+    ch_freevm(&vm);
+}
+
+void test_captured_variables_survive_collections() {
+    ch_context vm = stressed_vm("#counter() { val c = 0; #inc() { c = c + 1; return c; } return inc; }"
+                                "#main() { val inc = counter(); val i = 100; val last = 0; while (i) { last = inc(); i--; } return last; }");
+
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(100, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_globals_survive_explicit_collection() {
+    ch_context vm = stressed_vm("val saved = null;"
+                                "#save() { val con = \"con\"; saved = con + \"cat\"; }"
+                                "#load() { val suffix = saved + \"!\"; return suffix; }");
+
+    ch_runfunction(&vm, "save");
+    ch_gc_collect(&vm);
+    ch_primitive result = ch_runfunction(&vm, "load");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL_STRING("concat!", AS_STRING(AS_OBJECT(result))->value);
+    ch_freevm(&vm);
+}
+
+void test_collected_strings_leave_intern_table() {
+    ch_context vm = stressed_vm("#main() { val tem = \"tem\"; val s = tem + \"porary\"; return 0; }");
+
+    ch_runfunction(&vm, "main");
+    TEST_ASSERT_NOT_NULL(ch_table_find_string(&vm.strings, "temporary", 9));
+
+    ch_gc_collect(&vm);
+    TEST_ASSERT_NULL(ch_table_find_string(&vm.strings, "temporary", 9));
+    // Constants are never collected
+    TEST_ASSERT_NOT_NULL(ch_table_find_string(&vm.strings, "porary", 6));
+    ch_freevm(&vm);
+}
+
+static ch_context incremental_vm(char* program) {
+    ch_context vm = stressed_vm(program);
+    ch_gc_setincremental(&vm, 1);
+    return vm;
+}
+
+void test_incremental_collection_keeps_reachable_objects() {
+    ch_context vm = incremental_vm("val latest = null;"
+                                   "#counter() { val c = 0; #inc() { c = c + 1; return c; } return inc; }"
+                                   "#main() { val inc = counter(); val a = \"a\"; val i = 300; while (i) { latest = a + \"b\" + \"c\"; inc(); i--; } return latest + \"!\"; }");
+
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL_STRING("abc!", AS_STRING(AS_OBJECT(result))->value);
+    TEST_ASSERT_TRUE(ch_gc_getstats(&vm).cycles > 0);
+    ch_freevm(&vm);
+}
+
+void test_incremental_collection_frees_garbage() {
+    ch_context vm = incremental_vm("#main() { val ab = \"ab\"; val i = 500; while (i) { val s = ab + \"cd\"; i--; } return 0; }");
+    size_t natives = count_objects(&vm);
+
+    ch_runfunction(&vm, "main");
+    ch_gc_collect(&vm);
+
+    TEST_ASSERT_EQUAL(CH_GC_IDLE, vm.gc.phase);
+    TEST_ASSERT_TRUE(count_objects(&vm) < natives + 10);
+    ch_freevm(&vm);
+}
+
+void test_pause_stats_are_reported() {
+    ch_context vm = incremental_vm("#main() { val ab = \"ab\"; val i = 100; while (i) { val s = ab + \"cd\"; i--; } return 0; }");
+
+    ch_runfunction(&vm, "main");
+    ch_gc_stats stats = ch_gc_getstats(&vm);
+
+    TEST_ASSERT_TRUE(stats.pauses > 0);
+    TEST_ASSERT_TRUE(stats.p99_pause <= stats.max_pause);
+    TEST_ASSERT_TRUE(stats.max_pause <= stats.total_pause);
+
+    ch_gc_resetstats(&vm);
+    TEST_ASSERT_EQUAL(0, ch_gc_getstats(&vm).pauses);
+    ch_freevm(&vm);
+}
+
+static ch_context arena_vm(char* program) {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setarena(&vm, true);
+    return vm;
+}
+
+void test_arena_reuses_chunks_after_reset() {
+    ch_arena arena;
+    ch_arena_create(&arena, 64, NULL);
+
+    void* first = ch_arena_allocate(&arena, 24);
+    void* oversized = ch_arena_allocate(&arena, 1000);
+    TEST_ASSERT_NOT_NULL(oversized);
+    TEST_ASSERT_EQUAL(0, (uintptr_t)oversized % 16);
+
+    ch_arena_reset(&arena);
+    TEST_ASSERT_EQUAL(0, arena.bytes_allocated);
+    TEST_ASSERT_EQUAL_PTR(first, ch_arena_allocate(&arena, 24));
+    ch_arena_free(&arena);
+}
+
+void test_arena_is_reset_after_each_call() {
+    ch_context vm = arena_vm("#main() { val ab = \"ab\"; val i = 500; while (i) { val s = ab + \"cd\"; i--; } return 0; }");
+
+    ch_runfunction(&vm, "main");
+    size_t objects = count_objects(&vm);
+    ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(0, vm.gc.arena.bytes_allocated);
+    // Temporaries never reach the heap
+    TEST_ASSERT_EQUAL(objects, count_objects(&vm));
+    TEST_ASSERT_NULL(ch_table_find_string(&vm.strings, "abcd", 4));
+    ch_freevm(&vm);
+}
+
+void test_escaping_values_are_promoted() {
+    ch_context vm = arena_vm("val saved = null;"
+                             "#counter() { val c = 0; #inc() { c = c + 1; return c; } return inc; }"
+                             "#save() { saved = counter(); val con = \"con\"; val s = con + \"cat\"; return s; }"
+                             "#main() { saved(); return saved(); }");
+
+    ch_primitive result = ch_runfunction(&vm, "save");
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_FALSE(AS_OBJECT(result)->in_arena);
+    TEST_ASSERT_EQUAL_STRING("concat", AS_STRING(AS_OBJECT(result))->value);
+    TEST_ASSERT_EQUAL_PTR(AS_OBJECT(result), ch_table_find_string(&vm.strings, "concat", 6));
+
+    result = ch_runfunction(&vm, "main");
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(2, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_heap_upvalues_keep_arena_values() {
+    ch_context vm = arena_vm("val setter = null; val getter = null;"
+                             "#make() { val v = null; val x = \"x\"; #set() { v = x + \"y\"; return 0; } #get() { val t = x + \"zzz\"; return v; } setter = set; getter = get; return 0; }");
+
+    ch_runfunction(&vm, "make");
+    ch_runfunction(&vm, "setter");
+    ch_primitive result = ch_runfunction(&vm, "getter");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL_STRING("xy", AS_STRING(AS_OBJECT(result))->value);
+    ch_freevm(&vm);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_garbage_strings_are_collected);
+    RUN_TEST(test_captured_variables_survive_collections);
+    RUN_TEST(test_globals_survive_explicit_collection);
+    RUN_TEST(test_collected_strings_leave_intern_table);
+    RUN_TEST(test_incremental_collection_keeps_reachable_objects);
+    RUN_TEST(test_incremental_collection_frees_garbage);
+    RUN_TEST(test_pause_stats_are_reported);
+    RUN_TEST(test_arena_reuses_chunks_after_reset);
+    RUN_TEST(test_arena_is_reset_after_each_call);
+    RUN_TEST(test_escaping_values_are_promoted);
+    RUN_TEST(test_heap_upvalues_keep_arena_values);
+
+    return UNITY_END();
+}
@@ -0,0 +1,89 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <vm/chapman.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void noop(ch_context* vm, ch_argcount argcount) {}
+
+// Registers enough natives to force the globals table to grow
+void grow(ch_context* vm, ch_argcount argcount) {
+    char name[16];
+    for (int i = 0; i < 64; i++) {
+        snprintf(name, sizeof(name), "native%d", i);
+        ch_addnative(vm, noop, name);
+    }
+}
+
+void test_global_function_is_called_repeatedly() {
+    char program[] = "#twice(x) { return x * 2; } #main() { val i = 3; val total = 0; while (i) { total = total + twice(i); i--; } return total; }";
+    ch_context vm;
+
+    ch_primitive result = run_program(program, &vm);
+
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(12, AS_NUMBER(result));
+}
+
+void test_global_assignment_is_visible_in_other_functions() {
+    char program[] = "val counter = 1; #bump() { counter = counter + 1; } #main() { bump(); bump(); return counter; }";
+    ch_context vm;
+
+    ch_primitive result = run_program(program, &vm);
+
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(3, AS_NUMBER(result));
+}
+
+void test_global_is_found_after_globals_table_grows() {
+    char program[] = "val counter = 1; #main() { counter = counter + 1; grow(); counter = counter + 1; return counter; }";
+
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_addnative(&vm, grow, "grow");
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(3, AS_NUMBER(result));
+}
+
+void test_undefined_global_is_a_runtime_error() {
+    char program[] = "#main() { return missing; }";
+    ch_context vm;
+
+    run_program(program, &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_GLOBAL_NOT_FOUND, vm.exit);
+}
+
+void test_script_definitions_replace_natives() {
+    ch_context vm;
+    ch_primitive result = run_program("#max(a, b) { return a; } #main() { return max(1, 2); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(1, AS_NUMBER(result));
+
+    result = run_program("val sum = 3; #main() { return sum; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(3, AS_NUMBER(result));
+
+    // Only once, like any other global
+    run_program("val min = 1; val min = 2; #main() { return min; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_GLOBAL_NOT_FOUND, vm.exit);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_global_function_is_called_repeatedly);
+    RUN_TEST(test_global_assignment_is_visible_in_other_functions);
+    RUN_TEST(test_global_is_found_after_globals_table_grows);
+    RUN_TEST(test_undefined_global_is_a_runtime_error);
+    RUN_TEST(test_script_definitions_replace_natives);
+
+    return UNITY_END();
+}
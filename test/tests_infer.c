@@ -0,0 +1,73 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <vm/chapman.h>
+#include <infer.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void assert_inferred(const uint8_t* code, size_t size, ch_argcount argcount, const uint8_t* expected) {
+    ch_memory* memory = ch_memory_create(ch_default_allocator());
+    ch_blob blob = {.start = NULL, .current = NULL, .size = 0, .memory = memory};
+    ch_emit_write(&blob, code, size);
+    ch_ir ir;
+    TEST_ASSERT_TRUE(ch_ir_build(&ir, &blob));
+    ch_infer_types(&ir, argcount);
+    ch_ir_lower(&ir, &blob);
+
+    TEST_ASSERT_EQUAL(size, CH_BLOB_CONTENT_SIZE(&blob));
+    TEST_ASSERT_EQUAL(0, memcmp(expected, blob.start, size));
+
+    ch_memory_release(memory, blob.start, blob.size);
+    TEST_ASSERT_EQUAL(0, memory->live_bytes);
+    ch_memory_free(memory);
+}
+
+void test_known_operands_use_typed_ops() {
+    // return (1 + 2) * a;
+    const uint8_t numbers[] = {OP_NUMBER, 0, 0, 0, 0, OP_NUMBER, 8, 0, 0, 0, OP_ADD, OP_LOAD_LOCAL, 0, 0, 0, 0, OP_MUL, OP_RETURN_VALUE};
+    uint8_t numbers_expected[sizeof(numbers)];
+    memcpy(numbers_expected, numbers, sizeof(numbers));
+    numbers_expected[10] = OP_ADD_NUM;
+    assert_inferred(numbers, sizeof(numbers), 1, numbers_expected);
+
+    // return ("a" + "b") + a;
+    const uint8_t texts[] = {OP_STRING, 0, 0, 0, 0, OP_STRING, 8, 0, 0, 0, OP_ADD, OP_LOAD_LOCAL, 0, 0, 0, 0, OP_ADD, OP_RETURN_VALUE};
+    uint8_t texts_expected[sizeof(texts)];
+    memcpy(texts_expected, texts, sizeof(texts));
+    texts_expected[10] = OP_CONCAT_STR;
+    assert_inferred(texts, sizeof(texts), 1, texts_expected);
+}
+
+void test_types_flow_through_loops() {
+    // val x = 0; while (a) { x = x - 1; } return x / 2;
+    const uint8_t code[] = {OP_NUMBER, 0, 0, 0, 0, OP_LOAD_LOCAL, 0, 0, 0, 0, OP_JMP_FALSE, 22, 0, 0, 0, OP_POP,
+                            OP_LOAD_LOCAL, 1, 0, 0, 0, OP_NUMBER, 8, 0, 0, 0, OP_SUB, OP_SET_LOCAL, 1, 0, 0, 0,
+                            OP_JMP, 0xE0, 0xFF, 0xFF, 0xFF, OP_LOAD_LOCAL, 1, 0, 0, 0, OP_NUMBER, 16, 0, 0, 0, OP_DIV,
+                            OP_RETURN_VALUE};
+    uint8_t expected[sizeof(code)];
+    memcpy(expected, code, sizeof(code));
+    expected[26] = OP_SUB_NUM;
+    expected[47] = OP_DIV_NUM;
+    assert_inferred(code, sizeof(code), 1, expected);
+
+    TEST_ASSERT_EQUAL(110, AS_NUMBER(run("val total = 0; val i = 10; while (i) { total = total + i * 2; i--; } return total;")));
+}
+
+void test_unknown_types_keep_generic_ops() {
+    // A local is only known when every path agrees on its type
+    TEST_ASSERT_EQUAL_STRING("ab", AS_STRING(AS_OBJECT(run("val x = 1; val c = 0; c = 1; if (c) { x = \"a\"; } return x + \"b\";")))->value);
+    TEST_ASSERT_EQUAL_STRING("aa", AS_STRING(AS_OBJECT(run("val x = 1; val c = 0; c = 1; if (c) { x = \"a\"; } return x + x;")))->value);
+
+    // Calls can change captured locals
+    TEST_ASSERT_EQUAL_STRING("aa", AS_STRING(AS_OBJECT(run("val x = 1; #set() { x = \"a\"; } set(); return x + x;")))->value);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_known_operands_use_typed_ops);
+    RUN_TEST(test_types_flow_through_loops);
+    RUN_TEST(test_unknown_types_keep_generic_ops);
+    return UNITY_END();
+}
@@ -0,0 +1,75 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <vm/chapman.h>
+#include <ir.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static size_t code_size(char* program) {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile(program, &compiled_program));
+    return compiled_program.total_size - compiled_program.data_size;
+}
+
+void test_lowering_keeps_bytecode() {
+    // while (x) { x--; } return x;
+    const uint8_t code[] = {OP_LOAD_LOCAL, 0, 0, 0, 0, OP_JMP_FALSE, 12, 0, 0, 0, OP_POP, OP_LOAD_LOCAL, 0, 0, 0, 0, OP_SUBONE,
+                            OP_JMP, 0xEA, 0xFF, 0xFF, 0xFF, OP_RETURN_VALUE};
+    ch_memory* memory = ch_memory_create(ch_default_allocator());
+    ch_blob blob = {.start = NULL, .current = NULL, .size = 0, .memory = memory};
+    ch_emit_write(&blob, code, sizeof(code));
+
+    ch_ir ir;
+    TEST_ASSERT_TRUE(ch_ir_build(&ir, &blob));
+    TEST_ASSERT_EQUAL(7, ir.count);
+    TEST_ASSERT_EQUAL(6, ir.instructions[1].target);
+    TEST_ASSERT_EQUAL(0, ir.instructions[5].target);
+
+    ch_ir_split_blocks(&ir);
+    TEST_ASSERT_EQUAL(3, ir.block_count);
+    TEST_ASSERT_EQUAL(2, ir.blocks[1].start);
+    TEST_ASSERT_EQUAL(6, ir.blocks[1].end);
+
+    ch_ir_lower(&ir, &blob);
+    TEST_ASSERT_EQUAL(sizeof(code), CH_BLOB_CONTENT_SIZE(&blob));
+    TEST_ASSERT_EQUAL(0, memcmp(code, blob.start, sizeof(code)));
+
+    // A jump out of the bytecode doesn't build
+    blob.start[6] = 14;
+    TEST_ASSERT_FALSE(ch_ir_build(&ir, &blob));
+
+    ch_memory_release(memory, blob.start, blob.size);
+    TEST_ASSERT_EQUAL(0, memory->live_bytes);
+    ch_memory_free(memory);
+}
+
+void test_constants_propagate_and_fold() {
+    TEST_ASSERT_EQUAL(code_size("val x = 0; x = 1; val y = 0; y = 8; return y;"),
+                      code_size("val x = 0; x = 1; val y = 0; y = x * 2 + 6; return y * 1;"));
+    TEST_ASSERT_EQUAL(11, AS_NUMBER(run("val x = 1; val y = 0; y = x * 2 + 6; x = y; x++; return x + 2;")));
+    TEST_ASSERT_EQUAL_STRING("ab", AS_STRING(AS_OBJECT(run("val s = \"\"; s = \"a\"; val t = \"\"; t = s; return t + \"b\";")))->value);
+}
+
+void test_overwritten_stores_are_dropped() {
+    TEST_ASSERT_EQUAL(code_size("val x = 1; x = 3; return x;"), code_size("val x = 1; x = 2; x = 3; return x;"));
+    TEST_ASSERT_EQUAL(3, AS_NUMBER(run("val x = 1; x = 2; x = 3; return x;")));
+}
+
+void test_propagation_stays_in_blocks() {
+    // Loops, branches and calls all hide what a local holds
+    TEST_ASSERT_EQUAL(10, AS_NUMBER(run("val total = 0; val i = 0; i = 4; while (i) { total = total + i; i--; } return total;")));
+    TEST_ASSERT_EQUAL(2, AS_NUMBER(run("val x = 1; val c = 0; c = 1; if (c) { x = 2; } return x;")));
+
+    TEST_ASSERT_EQUAL(6, AS_NUMBER(run("val x = 0; x = 1; #closure() { x = 5; } closure(); x = x + 1; return x;")));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lowering_keeps_bytecode);
+    RUN_TEST(test_constants_propagate_and_fold);
+    RUN_TEST(test_overwritten_stores_are_dropped);
+    RUN_TEST(test_propagation_stays_in_blocks);
+    return UNITY_END();
+}
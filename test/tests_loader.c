@@ -0,0 +1,64 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <vm/chapman.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_loader_resolves_backward_jumps() {
+    char program[] = "val i = 5; val total = 0; while (i) { total = total + i; i--; } return total;";
+
+    ch_primitive result = run(program);
+
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(15, AS_NUMBER(result));
+}
+
+void test_loader_resolves_forward_jumps() {
+    char program[] = "val x = 0; for (val i = 3; i; i--) { x = x + 2; } return x;";
+
+    ch_primitive result = run(program);
+
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(6, AS_NUMBER(result));
+}
+
+void test_loader_rejects_truncated_instruction() {
+    // OP_NUMBER expects a 4 byte data pointer
+    uint8_t bytecode[] = {OP_NUMBER, 0, 0};
+    ch_program program = {
+        .start = bytecode,
+        .data_size = 0,
+        .total_size = sizeof(bytecode),
+        .program_start_ptr = 0,
+    };
+
+    ch_context vm = ch_newvm(program);
+
+    TEST_ASSERT_EQUAL(EXIT_UNKNOWN_INSTRUCTION, vm.exit);
+}
+
+void test_loader_rejects_jump_outside_of_program() {
+    uint8_t bytecode[] = {OP_JMP, 0x10, 0, 0, 0, OP_HALT};
+    ch_program program = {
+        .start = bytecode,
+        .data_size = 0,
+        .total_size = sizeof(bytecode),
+        .program_start_ptr = 0,
+    };
+
+    ch_context vm = ch_newvm(program);
+
+    TEST_ASSERT_EQUAL(EXIT_INVALID_INSTRUCTION_POINTER, vm.exit);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_loader_resolves_backward_jumps);
+    RUN_TEST(test_loader_resolves_forward_jumps);
+    RUN_TEST(test_loader_rejects_truncated_instruction);
+    RUN_TEST(test_loader_rejects_jump_outside_of_program);
+
+    return UNITY_END();
+}
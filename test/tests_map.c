@@ -0,0 +1,159 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <string.h>
+#include <vm/chapman.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_literals_and_members() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val m = {a: 1, \"b c\": 2, nested: {v: 30}}; m.x = 3; m.a = m.a + 10;"
+                                      "return m.a + m[\"b c\"] * 100 + m.x * 1000 + m.nested.v * 10000 + size(m) * 1000000; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(4303211, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_missing_keys_are_null() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val m = {a: 1}; if (m.b) { return 1; } if (m[\"c\"]) { return 2; } return m.a; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(1, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_dynamic_keys() {
+    // Keys grow into ropes and the table into incremental resizes, slices
+    // and ropes find the same entries as flat strings
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val m = {}; val k = \"\"; val i = 1500; while (i) { k = k + \"a\"; m[k] = i; i--; }"
+                                      "return size(m) + m[substring(k, 0, 3)] * 10000 + m[\"aa\"]; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(1500 + 1498 * 10000 + 1499, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_member_cache_is_shared_across_maps() {
+    ch_context vm;
+    ch_primitive result = run_program("#get(m) { return m.v; }"
+                                      "#main() { val a = {v: 1}; val b = {x: 0, y: 0, z: 0, v: 20}; val c = {v: 300};"
+                                      "val total = get(a) + get(b) + get(c) + get(a); remove(a, \"v\");"
+                                      "if (get(a)) { return 0; } c.v = 4000; return total + get(c); }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(4322, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_map_natives() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val m = {a: 1, b: 2, c: 3}; val removed = remove(m, \"b\"); val again = remove(m, \"b\");"
+                                      "val k = keys(m); if (again) { return 0; } if (has(m, \"b\")) { return 0; }"
+                                      "if (has(m, \"a\") && removed) { return size(k) + size(m) * 10; } return 0; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(22, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_scripts_may_define_map_native_names() {
+    ch_context vm;
+    ch_primitive result = run_program("#keys(a, b) { return a + b; } #has(m) { return 1; } #main() { return keys(1, 2) + has(null); }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(4, AS_NUMBER(result));
+    ch_freevm(&vm);
+
+    // Other natives are still there
+    result = run_program("val remove = 1; #main() { val m = {a: 1}; return size(keys(m)) + remove; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(2, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_map_errors() {
+    ch_context vm;
+    run_program("#main() { val a = 1; return a.x; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_INCORRECT_TYPE, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { val m = {}; m[1] = 2; return 0; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_INCORRECT_TYPE, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { return keys([1]); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_USER_ERROR, vm.exit);
+    ch_freevm(&vm);
+
+    TEST_ASSERT_FALSE(doescompile("val m = {1: 2};"));
+    TEST_ASSERT_FALSE(doescompile("val m = {a 2};"));
+}
+
+void test_maps_survive_collections() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val m = {}; val k = \"\"; val x = \"x\"; val i = 500; while (i) { k = k + \"k\"; m[k] = x + \"t\"; m.last = [x + \"y\"]; i--; } return m;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setgrowth(&vm, 0);
+    ch_gc_setincremental(&vm, 1);
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_TRUE(ch_gc_getstats(&vm).cycles > 0);
+    ch_map* map = AS_MAP(AS_OBJECT(result));
+    TEST_ASSERT_EQUAL(501, map->table.size);
+
+    ch_string* last = ch_table_find_string(&vm.strings, "last", 4);
+    TEST_ASSERT_NOT_NULL(last);
+    ch_array* array = AS_ARRAY(AS_OBJECT(*ch_table_get(&map->table, last)));
+    TEST_ASSERT_EQUAL_STRING("xy", AS_STRING(AS_OBJECT(array->values[0]))->value);
+
+    ch_string* key = ch_table_find_string(&vm.strings, "kkk", 3);
+    TEST_ASSERT_NOT_NULL(key);
+    TEST_ASSERT_EQUAL_STRING("xt", AS_STRING(AS_OBJECT(*ch_table_get(&map->table, key)))->value);
+    ch_freevm(&vm);
+}
+
+void test_heap_maps_keep_arena_values() {
+    ch_program compiled_program;
+    char program[] = "val saved = {}; #save() { val e = \"e\"; saved.a = e + \"bcd\"; saved[e + \"f\"] = [e + \"hij\"]; return 0; }"
+                     "#main() { return saved.a + saved.ef[0]; }";
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setarena(&vm, true);
+    ch_runfunction(&vm, "save");
+    ch_map* saved = AS_MAP(AS_OBJECT(vm.globals.values[0]));
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_FALSE(saved->object.in_arena);
+    TEST_ASSERT_FALSE(saved->remembered);
+
+    ch_string* key = ch_table_find_string(&vm.strings, "ef", 2);
+    TEST_ASSERT_NOT_NULL(key);
+    TEST_ASSERT_FALSE(key->object.in_arena);
+    TEST_ASSERT_NOT_NULL(ch_table_get(&saved->table, key));
+
+    ch_primitive result = ch_runfunction(&vm, "main");
+    TEST_ASSERT_EQUAL_STRING("ebcdehij", AS_STRING(ch_flatten(&vm, AS_OBJECT(result)))->value);
+    ch_freevm(&vm);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_literals_and_members);
+    RUN_TEST(test_missing_keys_are_null);
+    RUN_TEST(test_dynamic_keys);
+    RUN_TEST(test_member_cache_is_shared_across_maps);
+    RUN_TEST(test_map_natives);
+    RUN_TEST(test_scripts_may_define_map_native_names);
+    RUN_TEST(test_map_errors);
+    RUN_TEST(test_maps_survive_collections);
+    RUN_TEST(test_heap_maps_keep_arena_values);
+    return UNITY_END();
+}
@@ -11,8 +11,8 @@ void test_can_add_positive_numbers() {
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, result.type);
-    TEST_ASSERT_EQUAL(30, result.number_value);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(30, AS_NUMBER(result));
 }
 
 void test_can_add_negative_numbers() {
@@ -20,8 +20,8 @@ void test_can_add_negative_numbers() {
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, result.type);
-    TEST_ASSERT_EQUAL(-70, result.number_value);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(-70, AS_NUMBER(result));
 }
 
 void test_can_add_numbers_with_different_signs() {
@@ -29,8 +29,17 @@ void test_can_add_numbers_with_different_signs() {
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, result.type);
-    TEST_ASSERT_EQUAL(0, result.number_value);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(0, AS_NUMBER(result));
+}
+
+void test_operands_keep_their_order() {
+    char program[] =  "val x = 10; val y = 4; return (x - y) * 100 + x / y;";
+
+    ch_primitive result = run(program);
+
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_TRUE(602.5 == AS_NUMBER(result));
 }
 
 int main(void) {
@@ -38,6 +47,7 @@ int main(void) {
     RUN_TEST(test_can_add_positive_numbers);
     RUN_TEST(test_can_add_negative_numbers);
     RUN_TEST(test_can_add_numbers_with_different_signs);
+    RUN_TEST(test_operands_keep_their_order);
 
     return UNITY_END();
 }
\ No newline at end of file
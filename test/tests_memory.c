@@ -0,0 +1,155 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vm/chapman.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Checks that every size given back on realloc and free matches the allocation
+typedef struct {
+    size_t outstanding;
+    size_t allocations;
+} counting_state;
+
+static void* counting_alloc(void* user, size_t size) {
+    counting_state* state = user;
+    state->outstanding += size;
+    state->allocations++;
+    return malloc(size);
+}
+
+static void* counting_realloc(void* user, void* pointer, size_t old_size, size_t new_size) {
+    counting_state* state = user;
+    state->outstanding = state->outstanding - old_size + new_size;
+    return realloc(pointer, new_size);
+}
+
+static void counting_free(void* user, void* pointer, size_t size) {
+    counting_state* state = user;
+    state->outstanding -= size;
+    free(pointer);
+}
+
+static ch_allocator counting_allocator(counting_state* state) {
+    return (ch_allocator){
+        .alloc = counting_alloc,
+        .realloc = counting_realloc,
+        .free = counting_free,
+        .user = state,
+    };
+}
+
+// Refuses anything larger than a megabyte
+static void* refusing_alloc(void* user, size_t size) {
+    return size > 1024 * 1024 ? NULL : counting_alloc(user, size);
+}
+
+static void* refusing_realloc(void* user, void* pointer, size_t old_size, size_t new_size) {
+    return new_size > 1024 * 1024 ? NULL : counting_realloc(user, pointer, old_size, new_size);
+}
+
+void test_context_allocates_through_allocator() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val s = \"\"; val i = 200; while (i) { s = s + \"x\"; i--; } return s;", &compiled_program));
+
+    counting_state state = {0};
+    ch_context vm = ch_newvm_with_allocator(compiled_program, counting_allocator(&state));
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(200, AS_STRING(AS_OBJECT(result))->size);
+
+    ch_memory_stats stats = ch_memory_getstats(&vm);
+    TEST_ASSERT_TRUE(state.allocations > 0);
+    // The account itself is not counted
+    TEST_ASSERT_EQUAL(state.outstanding - sizeof(ch_memory), stats.live_bytes);
+    TEST_ASSERT_TRUE(stats.peak_bytes >= stats.live_bytes);
+
+    ch_freevm(&vm);
+    TEST_ASSERT_EQUAL(0, state.outstanding);
+}
+
+void test_compiler_allocates_through_allocator() {
+    const char* program = "val g = 1; #main() { val a = \"a\"; val s = a + \"b\"; return g; }";
+    counting_state state = {0};
+    ch_program compiled_program;
+
+    TEST_ASSERT_TRUE(ch_compile_with_allocator((const uint8_t*)program, strlen(program), &compiled_program, counting_allocator(&state)));
+    TEST_ASSERT_EQUAL(compiled_program.total_size, state.outstanding);
+
+    counting_free(&state, compiled_program.start, compiled_program.total_size);
+    TEST_ASSERT_EQUAL(0, state.outstanding);
+}
+
+void test_memory_limit_stops_the_program() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val s = \"ab\"; val i = 25; while (i) { s = s + s; val n = size(s); i--; } return 0;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_memory_setlimit(&vm, 1024 * 1024);
+    ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OUT_OF_MEMORY, vm.exit);
+    TEST_ASSERT_TRUE(ch_memory_getstats(&vm).peak_bytes < 8 * 1024 * 1024);
+    ch_freevm(&vm);
+}
+
+void test_memory_limit_refuses_large_numeric_arrays() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val a = numbers(1000000000); return 0;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_memory_setlimit(&vm, 1024 * 1024);
+    ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OUT_OF_MEMORY, vm.exit);
+    TEST_ASSERT_TRUE(ch_memory_getstats(&vm).peak_bytes < 1024 * 1024);
+    ch_freevm(&vm);
+}
+
+void test_refused_allocation_stops_the_program() {
+    ch_program compiled_program;
+    // Returning the text flattens all 4MB of it at once
+    TEST_ASSERT_TRUE(compile("val s = \"ab\"; val i = 21; while (i) { s = s + s; i--; } return s;", &compiled_program));
+
+    counting_state state = {0};
+    ch_allocator allocator = counting_allocator(&state);
+    allocator.alloc = refusing_alloc;
+    allocator.realloc = refusing_realloc;
+    ch_context vm = ch_newvm_with_allocator(compiled_program, allocator);
+    ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OUT_OF_MEMORY, vm.exit);
+    // Nothing is counted for what was refused
+    TEST_ASSERT_EQUAL(state.outstanding - sizeof(ch_memory), ch_memory_getstats(&vm).live_bytes);
+
+    ch_freevm(&vm);
+    TEST_ASSERT_EQUAL(0, state.outstanding);
+}
+
+void test_garbage_does_not_count_against_limit() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val some = \"some\"; val i = 2000; while (i) { val s = some + \"garbage\" + \"string\"; i--; } return 0;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_memory_setlimit(&vm, ch_memory_getstats(&vm).live_bytes + 64 * 1024);
+    ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    ch_freevm(&vm);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_context_allocates_through_allocator);
+    RUN_TEST(test_compiler_allocates_through_allocator);
+    RUN_TEST(test_memory_limit_stops_the_program);
+    RUN_TEST(test_memory_limit_refuses_large_numeric_arrays);
+    RUN_TEST(test_refused_allocation_stops_the_program);
+    RUN_TEST(test_garbage_does_not_count_against_limit);
+
+    return UNITY_END();
+}
@@ -12,8 +12,8 @@ void test_can_parse_number_without_decimals() {
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, result.type);
-    TEST_ASSERT_EQUAL(122, result.number_value);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(122, AS_NUMBER(result));
 }
 
 void test_can_parse_number_with_decimals() {
@@ -21,8 +21,8 @@ void test_can_parse_number_with_decimals() {
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, result.type);
-    TEST_ASSERT_EQUAL(10.1234, result.number_value);
+    TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(result));
+    TEST_ASSERT_EQUAL(10.1234, AS_NUMBER(result));
 }
 
 void test_cannot_parse_number_with_missing_decimals() {
@@ -38,9 +38,9 @@ void test_can_parse_string() {
 
     ch_primitive result = run(program);
 
-    TEST_ASSERT_EQUAL(PRIMITIVE_OBJECT, result.type);
+    TEST_ASSERT_EQUAL(PRIMITIVE_OBJECT, PRIMITIVE_TYPE(result));
     char parsed_string[] = "Hello, world!";
-    TEST_ASSERT_EQUAL_CHAR_ARRAY(AS_STRING(result.object_value)->value, parsed_string, sizeof(parsed_string) - 1);
+    TEST_ASSERT_EQUAL_CHAR_ARRAY(AS_STRING(AS_OBJECT(result))->value, parsed_string, sizeof(parsed_string) - 1);
 }
 
 int main(void) {
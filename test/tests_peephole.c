@@ -0,0 +1,84 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <vm/chapman.h>
+#include <peephole.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void assert_optimized(const uint8_t* code, size_t size, const uint8_t* expected, size_t expected_size) {
+    ch_memory* memory = ch_memory_create(ch_default_allocator());
+    ch_blob blob = {.start = NULL, .current = NULL, .size = 0, .memory = memory};
+    ch_emit_write(&blob, code, size);
+    ch_ir ir;
+    TEST_ASSERT_TRUE(ch_ir_build(&ir, &blob));
+    ch_peephole(&ir);
+    ch_ir_lower(&ir, &blob);
+
+    TEST_ASSERT_EQUAL(expected_size, CH_BLOB_CONTENT_SIZE(&blob));
+    TEST_ASSERT_EQUAL(0, memcmp(expected, blob.start, expected_size));
+
+    ch_memory_release(memory, blob.start, blob.size);
+    TEST_ASSERT_EQUAL(0, memory->live_bytes);
+    ch_memory_free(memory);
+}
+
+void test_statement_postfix_drops_copy() {
+    const uint8_t code[] = {OP_LOAD_LOCAL, 0, 0, 0, 0, OP_TOP, OP_ADDONE, OP_SET_LOCAL, 0, 0, 0, 0, OP_POP, OP_RETURN_VOID};
+    const uint8_t expected[] = {OP_LOAD_LOCAL, 0, 0, 0, 0, OP_ADDONE, OP_SET_LOCAL, 0, 0, 0, 0, OP_RETURN_VOID};
+    assert_optimized(code, sizeof(code), expected, sizeof(expected));
+}
+
+void test_pops_merge_and_dead_code_is_dropped() {
+    const uint8_t code[] = {OP_POP, OP_POP, OP_POP, OP_RETURN_VOID, OP_POP, OP_POP, OP_RETURN_VOID};
+    const uint8_t expected[] = {OP_POPN, 3, 0, 0, 0, OP_RETURN_VOID};
+    assert_optimized(code, sizeof(code), expected, sizeof(expected));
+}
+
+void test_jump_chains_are_threaded() {
+    // if (a || b) { return x; } return y;
+    // The jump taken when a is truthy skips the test of the whole condition
+    const uint8_t or_code[] = {OP_LOAD_LOCAL, 0, 0, 0, 0, OP_JMP_FALSE, 5, 0, 0, 0, OP_JMP, 6, 0, 0, 0, OP_POP,
+                               OP_LOAD_LOCAL, 1, 0, 0, 0, OP_JMP_FALSE, 6, 0, 0, 0,
+                               OP_NUMBER, 0, 0, 0, 0, OP_RETURN_VALUE, OP_NUMBER, 8, 0, 0, 0, OP_RETURN_VALUE};
+    uint8_t or_expected[sizeof(or_code)];
+    memcpy(or_expected, or_code, sizeof(or_code));
+    or_expected[11] = 11;
+    assert_optimized(or_code, sizeof(or_code), or_expected, sizeof(or_expected));
+
+    // if (a && b) { return x; } return y;
+    // A falsy a is still falsy when the condition is tested
+    const uint8_t and_code[] = {OP_LOAD_LOCAL, 0, 0, 0, 0, OP_JMP_FALSE, 6, 0, 0, 0, OP_POP,
+                                OP_LOAD_LOCAL, 1, 0, 0, 0, OP_JMP_FALSE, 6, 0, 0, 0,
+                                OP_NUMBER, 0, 0, 0, 0, OP_RETURN_VALUE, OP_NUMBER, 8, 0, 0, 0, OP_RETURN_VALUE};
+    uint8_t and_expected[sizeof(and_code)];
+    memcpy(and_expected, and_code, sizeof(and_code));
+    and_expected[6] = 17;
+    assert_optimized(and_code, sizeof(and_code), and_expected, sizeof(and_expected));
+}
+
+void test_jumps_are_fixed_up() {
+    // Back edges cross the merged pops of the loop body
+    TEST_ASSERT_EQUAL(55, AS_NUMBER(run("val total = 0; val i = 10; while (i) { val a = i; val b = a; val c = b; total = total + c; i--; } return total;")));
+
+    TEST_ASSERT_EQUAL(2, AS_NUMBER(run("val a = 0; val b = 0; val c = 2; return a || b || c;")));
+    TEST_ASSERT_EQUAL(0, AS_NUMBER(run("val a = 1; val b = 0; val c = 2; return a && b && c;")));
+    TEST_ASSERT_EQUAL(3, AS_NUMBER(run("val a = 0; val b = 1; if (a || b) { if (a && b) { return 1; } else { return 3; } } return 2;")));
+
+    ch_context vm;
+    ch_primitive result = run_program("#first(x) { if (x) { return 1; } else { return 2; } return 3; }"
+                                      "#main() { val n = 0; n++; n++; return first(n) * 10 + first(0) + n * 100; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(212, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_statement_postfix_drops_copy);
+    RUN_TEST(test_pops_merge_and_dead_code_is_dropped);
+    RUN_TEST(test_jump_chains_are_threaded);
+    RUN_TEST(test_jumps_are_fixed_up);
+    return UNITY_END();
+}
@@ -0,0 +1,63 @@
+#include <unity.h>
+#include <math.h>
+#include <stdbool.h>
+#include <vm/chapman.h>
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_number_round_trips() {
+    double values[] = {0, -0.0, 1.5, -1e300, INFINITY, -INFINITY};
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        ch_primitive primitive = MAKE_NUMBER(values[i]);
+
+        TEST_ASSERT_TRUE(IS_NUMBER(primitive));
+        TEST_ASSERT_EQUAL(PRIMITIVE_NUMBER, PRIMITIVE_TYPE(primitive));
+        TEST_ASSERT_TRUE(values[i] == AS_NUMBER(primitive));
+    }
+
+    ch_primitive nan = MAKE_NUMBER(NAN);
+    TEST_ASSERT_TRUE(IS_NUMBER(nan));
+    TEST_ASSERT_TRUE(isnan(AS_NUMBER(nan)));
+}
+
+void test_singletons_are_distinct() {
+    ch_primitive null = MAKE_NULL();
+    ch_primitive yes = MAKE_BOOLEAN(true);
+    ch_primitive no = MAKE_BOOLEAN(false);
+
+    TEST_ASSERT_TRUE(IS_NULL(null));
+    TEST_ASSERT_FALSE(IS_BOOLEAN(null));
+    TEST_ASSERT_TRUE(IS_BOOLEAN(yes));
+    TEST_ASSERT_TRUE(IS_BOOLEAN(no));
+    TEST_ASSERT_FALSE(IS_NULL(no));
+    TEST_ASSERT_TRUE(AS_BOOLEAN(yes));
+    TEST_ASSERT_FALSE(AS_BOOLEAN(no));
+    TEST_ASSERT_EQUAL(PRIMITIVE_NULL, PRIMITIVE_TYPE(null));
+    TEST_ASSERT_EQUAL(PRIMITIVE_BOOLEAN, PRIMITIVE_TYPE(no));
+}
+
+void test_char_and_object_round_trip() {
+    ch_primitive character = MAKE_CHAR('z');
+    TEST_ASSERT_TRUE(IS_CHAR(character));
+    TEST_ASSERT_FALSE(IS_NUMBER(character));
+    TEST_ASSERT_EQUAL('z', AS_CHAR(character));
+    TEST_ASSERT_EQUAL(PRIMITIVE_CHAR, PRIMITIVE_TYPE(character));
+
+    ch_string string;
+    ch_initstring(&string, "value", 5);
+    ch_primitive object = MAKE_OBJECT(&string);
+    TEST_ASSERT_TRUE(IS_OBJECT(object));
+    TEST_ASSERT_FALSE(IS_NUMBER(object));
+    TEST_ASSERT_EQUAL_PTR(&string, AS_OBJECT(object));
+    TEST_ASSERT_EQUAL(PRIMITIVE_OBJECT, PRIMITIVE_TYPE(object));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_number_round_trips);
+    RUN_TEST(test_singletons_are_distinct);
+    RUN_TEST(test_char_and_object_round_trip);
+
+    return UNITY_END();
+}
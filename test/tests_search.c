@@ -0,0 +1,120 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <string.h>
+#include <vm/chapman.h>
+#include <vm/search.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static size_t naive_first(const char* haystack, size_t haystack_size, const char* needle, size_t needle_size) {
+    for (size_t i = 0; i + needle_size <= haystack_size; i++) {
+        if (memcmp(&haystack[i], needle, needle_size) == 0) return i;
+    }
+    return CH_SEARCH_NOT_FOUND;
+}
+
+static size_t naive_last(const char* haystack, size_t haystack_size, const char* needle, size_t needle_size) {
+    for (size_t i = haystack_size + 1; i-- > 0;) {
+        if (i + needle_size <= haystack_size && memcmp(&haystack[i], needle, needle_size) == 0) return i;
+    }
+    return CH_SEARCH_NOT_FOUND;
+}
+
+void test_search_matches_naive_search() {
+    // A small alphabet makes partial matches common, sizes cross the block boundaries
+    char haystack[200];
+    char needle[40];
+    uint32_t seed = 12345;
+    for (int round = 0; round < 3000; round++) {
+        size_t haystack_size = round % 150;
+        size_t needle_size = (round / 7) % 12;
+        for (size_t i = 0; i < haystack_size; i++) {
+            seed = seed * 1103515245 + 12345;
+            haystack[i] = 'a' + (seed >> 16) % 3;
+        }
+        for (size_t i = 0; i < needle_size; i++) {
+            seed = seed * 1103515245 + 12345;
+            needle[i] = 'a' + (seed >> 16) % 3;
+        }
+
+        TEST_ASSERT_EQUAL(naive_first(haystack, haystack_size, needle, needle_size), ch_search_first(haystack, haystack_size, needle, needle_size));
+        TEST_ASSERT_EQUAL(naive_last(haystack, haystack_size, needle, needle_size), ch_search_last(haystack, haystack_size, needle, needle_size));
+    }
+}
+
+void test_search_stays_within_size() {
+    // Matches past the size, or past a NUL byte, must not be found
+    const char text[] = "0123456789abcdef0123456789ab\0cdef0123456789abcdefXY";
+    TEST_ASSERT_EQUAL(CH_SEARCH_NOT_FOUND, ch_search_first(text, 48, "XY", 2));
+    TEST_ASSERT_EQUAL(48, ch_search_first(text, 51, "fX", 2));
+    TEST_ASSERT_EQUAL(27, ch_search_first(text, 51, "b\0c", 3));
+    TEST_ASSERT_EQUAL(45, ch_search_last(text, 48, "cd", 2));
+    TEST_ASSERT_EQUAL(CH_SEARCH_NOT_FOUND, ch_search_last(text, 10, "cd", 2));
+}
+
+void test_index_natives() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val s = \"one, two, three, two\"; val i = indexOf(s, \"two\"); val j = indexOf(s, \"two\", i + 1);"
+                                      "val k = lastIndexOf(s, \"two\"); val m = indexOf(s, \"four\"); return i * 1000000 + j * 10000 + k * 100 + m; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(5 * 1000000 + 17 * 10000 + 17 * 100 - 1, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_count_native() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val s = \"aaaa,b,,c\"; return count(s, \"aa\") * 100 + count(s, \",\"); }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(203, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_split_native() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val f = split(\"key=value==end\", \"=\"); return f[0] + \":\" + f[1] + \":\" + f[2] + \":\" + f[3]; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL_STRING("key:value::end", AS_STRING(AS_OBJECT(result))->value);
+    ch_freevm(&vm);
+
+    // Separators at either end leave empty fields, a missing one a single field
+    result = run_program("#main() { return split(\"=a=\", \"=\"); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(3, AS_ARRAY(AS_OBJECT(result))->count);
+    ch_freevm(&vm);
+
+    result = run_program("#main() { return split(\"abc\", \"=\"); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(1, AS_ARRAY(AS_OBJECT(result))->count);
+    ch_freevm(&vm);
+
+    run_program("#main() { return split(\"a=b\", \"\"); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_USER_ERROR, vm.exit);
+    ch_freevm(&vm);
+}
+
+void test_scripts_may_define_search_native_names() {
+    ch_context vm;
+    ch_primitive result = run_program("#count(a, b) { return a * b; } #split(a, b) { return a - b; } val indexOf = 1;"
+                                      "#main() { return count(2, 3) + split(5, 1) + indexOf + lastIndexOf(\"abab\", \"b\"); }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(14, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_search_matches_naive_search);
+    RUN_TEST(test_search_stays_within_size);
+    RUN_TEST(test_index_natives);
+    RUN_TEST(test_count_native);
+    RUN_TEST(test_split_native);
+    RUN_TEST(test_scripts_may_define_search_native_names);
+
+    return UNITY_END();
+}
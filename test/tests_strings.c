@@ -0,0 +1,240 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <string.h>
+#include <vm/chapman.h>
+#include <vm/hash.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_appending_builds_a_rope() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val s = \"\"; val i = 1000; while (i) { s = s + \"0123456789\"; i--; } return s; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    ch_string* string = AS_STRING(AS_OBJECT(result));
+    TEST_ASSERT_TRUE(IS_STRING(AS_OBJECT(result)));
+    TEST_ASSERT_EQUAL(10000, string->size);
+    TEST_ASSERT_EQUAL(0, memcmp(string->value, "0123456789012", 13));
+    TEST_ASSERT_EQUAL_STRING("0123456789", &string->value[9990]);
+    // Only the short intermediates were interned, next to the constants and
+    // the names of the natives
+    TEST_ASSERT_TRUE(vm.strings.size < 30);
+    ch_freevm(&vm);
+}
+
+void test_natives_see_flat_strings() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val s = \"\"; val i = 20; while (i) { s = s + \"abcd\"; i--; } s = s + \"needle\";"
+                                      "if (contains(s, \"dneed\")) { return size(s); } return 0; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(86, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+static bool host_saw_terminated;
+
+void host_native(ch_context* vm, ch_argcount argcount) {
+    ch_string* string;
+    if (!ch_popstring(vm, &string)) return;
+
+    host_saw_terminated = strlen(string->value) == string->size;
+    ch_push(vm, MAKE_NUMBER(string->size));
+}
+
+void test_host_natives_see_terminated_strings() {
+    char program[] = "#main() { val s = \"abcdefgh\"; return host(substring(s, 2, 5)); }";
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_addnative(&vm, host_native, "host");
+    host_saw_terminated = false;
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(3, AS_NUMBER(result));
+    TEST_ASSERT_TRUE(host_saw_terminated);
+    ch_freevm(&vm);
+}
+
+void test_flattened_ropes_are_interned() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val s = \"\"; val i = 10; while (i) { s = s + \"0123456789\"; i--; } return s; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    ch_string* same = ch_table_find_string(&vm.strings, AS_STRING(AS_OBJECT(result))->value, 100);
+    TEST_ASSERT_EQUAL_PTR(AS_OBJECT(result), same);
+    ch_freevm(&vm);
+}
+
+void test_ropes_survive_collections() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val s = \"\"; val i = 300; while (i) { s = s + \"abcdefghij\"; i--; } return s;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setgrowth(&vm, 0);
+    ch_gc_setincremental(&vm, 1);
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(3000, AS_STRING(AS_OBJECT(result))->size);
+    TEST_ASSERT_EQUAL_STRING("abcdefghij", &AS_STRING(AS_OBJECT(result))->value[2990]);
+    ch_freevm(&vm);
+}
+
+void test_concatenation_chains_skip_intermediates() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val a = \"ab\"; val b = \"cd\"; val s = a + b + \"ef\" + b; return s; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL_STRING("abcdefcd", AS_STRING(AS_OBJECT(result))->value);
+    TEST_ASSERT_NULL(ch_table_find_string(&vm.strings, "abcd", 4));
+    TEST_ASSERT_NULL(ch_table_find_string(&vm.strings, "abcdef", 6));
+    ch_freevm(&vm);
+}
+
+void test_concatenation_chains_append_to_ropes() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val s = \"\"; val i = 100; while (i) { s = s + \"01234\" + \"56789\"; i--; } return s; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(1000, AS_STRING(AS_OBJECT(result))->size);
+    TEST_ASSERT_EQUAL_STRING("0123456789", &AS_STRING(AS_OBJECT(result))->value[990]);
+    ch_freevm(&vm);
+}
+
+void test_addition_chains_keep_numbers() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val a = 1; return a * 2 + 3 + 4.5 * 2 + a; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(15, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_addition_chains_reject_mixed_types() {
+    ch_context vm;
+    run_program("#main() { val a = \"a\"; return a + a + 1; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_INCORRECT_TYPE, vm.exit);
+    ch_freevm(&vm);
+}
+
+void test_overlong_texts_are_rejected() {
+    // Ropes make texts too long to index cheap to build
+    ch_context vm;
+    run_program("#main() { val s = \"abcdefghij\"; val i = 29; while (i) { i--; s = s + s; } return size(s); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_OUT_OF_MEMORY, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { val s = \"abcdefghij\"; val i = 20; while (i) { i--; s = s + s + s; } return size(s); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_OUT_OF_MEMORY, vm.exit);
+    ch_freevm(&vm);
+}
+
+void test_substrings_share_storage() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val s = \"hello \" + \"world\"; val t = substring(s, 3); val u = substring(t, 1, 3);"
+                                      "if (contains(u, \"l\")) { return 0; } if (contains(t, \"orl\")) { return size(u); } return 0; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(2, AS_NUMBER(result));
+    TEST_ASSERT_NULL(ch_table_find_string(&vm.strings, "lo world", 8));
+    TEST_ASSERT_NULL(ch_table_find_string(&vm.strings, "o ", 2));
+    ch_freevm(&vm);
+}
+
+void test_returned_substrings_are_interned() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val s = \"hello world\"; return substring(s, 0, 5); }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_FALSE(IS_SLICE(AS_OBJECT(result)));
+    TEST_ASSERT_EQUAL_STRING("hello", AS_STRING(AS_OBJECT(result))->value);
+    TEST_ASSERT_EQUAL_PTR(AS_OBJECT(result), ch_table_find_string(&vm.strings, "hello", 5));
+    ch_freevm(&vm);
+}
+
+void test_substrings_keep_their_parent_alive() {
+    ch_program compiled_program;
+    TEST_ASSERT_TRUE(compile("val s = \"\"; val t = s; val i = 20; while (i) { s = s + \"abcdefghij\"; i--; } t = substring(s, 195);"
+                             "s = \"\"; i = 200; while (i) { s = s + \"0123456789\"; i--; } return t;", &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setgrowth(&vm, 0);
+    ch_gc_setincremental(&vm, 1);
+    ch_primitive result = ch_runfunction(&vm, "main");
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL_STRING("fghij", AS_STRING(AS_OBJECT(result))->value);
+    ch_freevm(&vm);
+}
+
+void test_escaping_substrings_are_promoted() {
+    ch_program compiled_program;
+    char program[] = "val saved = null; #save() { val a = \"abcdefgh\"; val s = a + \"ijklmnop\"; saved = substring(s, 4, 12); return 0; }"
+                     "#main() { return size(saved); }";
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setarena(&vm, true);
+    ch_runfunction(&vm, "save");
+    ch_string* saved = AS_STRING(AS_OBJECT(vm.globals.values[0]));
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_FALSE(saved->object.in_arena);
+    TEST_ASSERT_FALSE(saved->parent->object.in_arena);
+    TEST_ASSERT_EQUAL(0, memcmp(saved->value, "efghijkl", 8));
+    TEST_ASSERT_EQUAL(8, AS_NUMBER(ch_runfunction(&vm, "main")));
+    ch_freevm(&vm);
+}
+
+void test_hash_depends_on_every_byte() {
+    // Covers the short reads, the 16 byte steps and the three lanes
+    ch_hash_seed(1);
+    char text[200];
+    memset(text, 'a', sizeof(text));
+    for (size_t size = 1; size < sizeof(text); size++) {
+        uint32_t hash = ch_hash_string(text, size);
+        TEST_ASSERT_NOT_EQUAL(hash, ch_hash_string(text, size - 1));
+        for (size_t i = 0; i < size; i++) {
+            text[i] = 'b';
+            TEST_ASSERT_NOT_EQUAL(hash, ch_hash_string(text, size));
+            text[i] = 'a';
+        }
+    }
+}
+
+void test_hash_depends_on_the_seed() {
+    ch_hash_seed(1);
+    uint32_t hash = ch_hash_string("seeded", 6);
+    ch_hash_seed(2);
+    TEST_ASSERT_NOT_EQUAL(hash, ch_hash_string("seeded", 6));
+    ch_hash_seed(1);
+    TEST_ASSERT_EQUAL(hash, ch_hash_string("seeded", 6));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_appending_builds_a_rope);
+    RUN_TEST(test_natives_see_flat_strings);
+    RUN_TEST(test_host_natives_see_terminated_strings);
+    RUN_TEST(test_flattened_ropes_are_interned);
+    RUN_TEST(test_ropes_survive_collections);
+    RUN_TEST(test_concatenation_chains_skip_intermediates);
+    RUN_TEST(test_concatenation_chains_append_to_ropes);
+    RUN_TEST(test_addition_chains_keep_numbers);
+    RUN_TEST(test_addition_chains_reject_mixed_types);
+    RUN_TEST(test_overlong_texts_are_rejected);
+    RUN_TEST(test_substrings_share_storage);
+    RUN_TEST(test_returned_substrings_are_interned);
+    RUN_TEST(test_substrings_keep_their_parent_alive);
+    RUN_TEST(test_escaping_substrings_are_promoted);
+    RUN_TEST(test_hash_depends_on_every_byte);
+    RUN_TEST(test_hash_depends_on_the_seed);
+
+    return UNITY_END();
+}
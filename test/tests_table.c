@@ -0,0 +1,175 @@
+#include <unity.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <vm/chapman.h>
+#include <vm/table.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+#define KEYS 2000
+
+static char values[KEYS][16];
+static ch_string keys[KEYS];
+
+static void create_keys(void) {
+    for (int i = 0; i < KEYS; i++) {
+        int size = snprintf(values[i], sizeof(values[i]), "key%d", i);
+        ch_initstring(&keys[i], values[i], size);
+    }
+}
+
+void test_table_finds_every_key() {
+    create_keys();
+    ch_table table;
+    ch_table_create(&table, NULL);
+
+    for (int i = 0; i < KEYS; i++) {
+        TEST_ASSERT_TRUE(ch_table_set(&table, &keys[i], MAKE_NUMBER(i)));
+    }
+    TEST_ASSERT_FALSE(ch_table_set(&table, &keys[7], MAKE_NUMBER(-7)));
+    TEST_ASSERT_EQUAL(KEYS, table.size);
+
+    for (int i = 0; i < KEYS; i++) {
+        ch_primitive* value = ch_table_get(&table, &keys[i]);
+        TEST_ASSERT_NOT_NULL(value);
+        TEST_ASSERT_EQUAL(i == 7 ? -7 : i, AS_NUMBER(*value));
+        TEST_ASSERT_EQUAL_PTR(&keys[i], ch_table_find_string(&table, values[i], keys[i].size));
+    }
+    TEST_ASSERT_NULL(ch_table_find_string(&table, "key", 3));
+    ch_table_free(&table);
+}
+
+void test_table_deletes_keys() {
+    create_keys();
+    ch_table table;
+    ch_table_create(&table, NULL);
+
+    // Deleting and inserting in turns keeps reusing the deleted slots
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < KEYS; i++) {
+            ch_table_set(&table, &keys[i], MAKE_NUMBER(round));
+        }
+        for (int i = round % 2; i < KEYS; i += 2) {
+            TEST_ASSERT_TRUE(ch_table_delete(&table, &keys[i]));
+        }
+    }
+
+    TEST_ASSERT_EQUAL(KEYS / 2, table.size);
+    TEST_ASSERT_TRUE(table.slots.capacity <= 4096);
+    for (int i = 0; i < KEYS; i++) {
+        bool deleted = i % 2 == 1;
+        TEST_ASSERT_EQUAL(deleted, ch_table_get(&table, &keys[i]) == NULL);
+        TEST_ASSERT_EQUAL(deleted, ch_table_find_string(&table, values[i], keys[i].size) == NULL);
+        TEST_ASSERT_EQUAL(deleted, !ch_table_delete(&table, &keys[i]));
+    }
+    TEST_ASSERT_EQUAL(0, table.size);
+    ch_table_free(&table);
+}
+
+void test_table_resizes_incrementally() {
+    create_keys();
+    ch_table table;
+    ch_table_create(&table, NULL);
+
+    // Filling 7/8 of 1024 slots moves the table to 2048 slots
+    for (int i = 0; i < 897; i++) {
+        ch_table_set(&table, &keys[i], MAKE_NUMBER(i));
+    }
+    TEST_ASSERT_EQUAL(2048, table.slots.capacity);
+    TEST_ASSERT_EQUAL(1024, table.old.capacity);
+
+    // Keys are found on both sides while they are migrated
+    for (int i = 897; i < 897 + 32; i++) {
+        TEST_ASSERT_TRUE(ch_table_delete(&table, &keys[i - 897]));
+        ch_table_set(&table, &keys[i], MAKE_NUMBER(i));
+        for (int j = i - 896; j <= i; j++) {
+            TEST_ASSERT_EQUAL(j, AS_NUMBER(*ch_table_get(&table, &keys[j])));
+            TEST_ASSERT_EQUAL_PTR(&keys[j], ch_table_find_string(&table, values[j], keys[j].size));
+        }
+    }
+
+    TEST_ASSERT_EQUAL(0, table.old.capacity);
+    TEST_ASSERT_EQUAL(897, table.size);
+    TEST_ASSERT_NULL(ch_table_get(&table, &keys[0]));
+    ch_table_free(&table);
+}
+
+void test_table_reclaims_deleted_slots() {
+    create_keys();
+    ch_table table;
+    ch_table_create(&table, NULL);
+
+    // Only the last 100 keys are kept, the deleted slots are reused
+    for (int i = 0; i < KEYS; i++) {
+        ch_table_set(&table, &keys[i], MAKE_NUMBER(i));
+        if (i >= 100) {
+            ch_table_delete(&table, &keys[i - 100]);
+        }
+    }
+
+    TEST_ASSERT_EQUAL(100, table.size);
+    TEST_ASSERT_TRUE(table.slots.capacity <= 256);
+    for (int i = KEYS - 100; i < KEYS; i++) {
+        TEST_ASSERT_EQUAL(i, AS_NUMBER(*ch_table_get(&table, &keys[i])));
+    }
+    ch_table_free(&table);
+}
+
+void test_table_salts_colliding_keys() {
+    create_keys();
+    ch_table table;
+    ch_table_create(&table, NULL);
+
+    // Every key starts probing from the same group with the same control byte
+    for (int i = 0; i < KEYS; i++) {
+        keys[i].hash = (uint32_t)i << 20;
+        ch_table_set(&table, &keys[i], MAKE_NUMBER(i));
+    }
+
+    TEST_ASSERT_NOT_EQUAL(0, table.salt);
+    TEST_ASSERT_TRUE(table.slots.capacity <= 4096);
+    for (int i = 0; i < KEYS; i++) {
+        TEST_ASSERT_EQUAL(i, AS_NUMBER(*ch_table_get(&table, &keys[i])));
+    }
+    ch_table_free(&table);
+}
+
+void test_table_keeps_keys_with_equal_hashes() {
+    create_keys();
+    ch_table table;
+    ch_table_create(&table, NULL);
+
+    // No salt separates them, they share one long probe sequence
+    for (int i = 0; i < 300; i++) {
+        keys[i].hash = 42;
+        TEST_ASSERT_TRUE(ch_table_set(&table, &keys[i], MAKE_NUMBER(i)));
+    }
+    for (int i = 0; i < 300; i += 2) {
+        TEST_ASSERT_TRUE(ch_table_delete(&table, &keys[i]));
+    }
+
+    TEST_ASSERT_EQUAL(150, table.size);
+    for (int i = 0; i < 300; i++) {
+        ch_primitive* value = ch_table_get(&table, &keys[i]);
+        TEST_ASSERT_EQUAL(i % 2 == 0, value == NULL);
+        if (value != NULL) {
+            TEST_ASSERT_EQUAL(i, AS_NUMBER(*value));
+        }
+    }
+    ch_table_free(&table);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_table_finds_every_key);
+    RUN_TEST(test_table_deletes_keys);
+    RUN_TEST(test_table_resizes_incrementally);
+    RUN_TEST(test_table_reclaims_deleted_slots);
+    RUN_TEST(test_table_salts_colliding_keys);
+    RUN_TEST(test_table_keeps_keys_with_equal_hashes);
+
+    return UNITY_END();
+}
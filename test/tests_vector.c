@@ -0,0 +1,158 @@
+#include <unity.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <vm/chapman.h>
+#include <vm/vector.h>
+#include "utils.h"
+
+void setUp(void) {}
+void tearDown(void) { ch_vector_limit(CH_VECTOR_AVX2); }
+
+// Sizes around every block and unroll width of the kernels
+#define MAX_SIZE 70
+
+static void fill(double* values, size_t count, double start) {
+    for (size_t i = 0; i < count; i++) {
+        values[i] = start + (double) ((i * 37) % 23);
+    }
+}
+
+static void check_level(ch_vector_level level) {
+    ch_vector_limit(level);
+    double values[MAX_SIZE];
+    double other[MAX_SIZE];
+
+    for (size_t count = 1; count <= MAX_SIZE; count++) {
+        fill(values, count, 1);
+        fill(other, count, 2);
+
+        // Whole numbers, so every order of additions gives the same result
+        double sum = 0, dot = 0, min = values[0], max = values[0];
+        double prefix[MAX_SIZE];
+        for (size_t i = 0; i < count; i++) {
+            sum += values[i];
+            prefix[i] = sum;
+            dot += values[i] * other[i];
+            min = values[i] < min ? values[i] : min;
+            max = values[i] > max ? values[i] : max;
+        }
+
+        TEST_ASSERT_TRUE(sum == ch_vector_sum(values, count));
+        TEST_ASSERT_TRUE(dot == ch_vector_dot(values, other, count));
+        TEST_ASSERT_TRUE(min == ch_vector_min(values, count));
+        TEST_ASSERT_TRUE(max == ch_vector_max(values, count));
+
+        ch_vector_prefix_sum(values, count);
+        TEST_ASSERT_EQUAL(0, memcmp(prefix, values, count * sizeof(double)));
+
+        fill(values, count, 1);
+        ch_vector_add(values, other, count);
+        ch_vector_scale(values, count, 0.5);
+        for (size_t i = 0; i < count; i++) {
+            TEST_ASSERT_TRUE(values[i] == 1.5 + (double) ((i * 37) % 23));
+        }
+
+        // A NaN anywhere wins over every other value
+        fill(values, count, 1);
+        values[count / 2] = NAN;
+        TEST_ASSERT_TRUE(isnan(ch_vector_min(values, count)));
+        TEST_ASSERT_TRUE(isnan(ch_vector_max(values, count)));
+    }
+
+    TEST_ASSERT_TRUE(ch_vector_sum(values, 0) == 0);
+}
+
+void test_scalar_kernels() {
+    TEST_ASSERT_EQUAL(CH_VECTOR_SCALAR, ch_vector_limit(CH_VECTOR_SCALAR));
+    check_level(CH_VECTOR_SCALAR);
+}
+
+void test_sse2_kernels() {
+    // Only x86 builds have vector kernels
+    if (ch_vector_supported() < CH_VECTOR_SSE2) return;
+    TEST_ASSERT_EQUAL(CH_VECTOR_SSE2, ch_vector_limit(CH_VECTOR_SSE2));
+    check_level(CH_VECTOR_SSE2);
+}
+
+void test_avx2_kernels() {
+    if (ch_vector_supported() < CH_VECTOR_AVX2) return;
+    check_level(CH_VECTOR_AVX2);
+}
+
+void test_numeric_array_natives() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val a = numbers([1, 2, 3, 4, 5, 6, 7]); a[] = 8; a[0] = 0.5; prefixSum(a);"
+                                      "return sum(a) + max(a) * 1000 + min(a) * 100000 + size(scale(accumulate(numbers(a), a), 2)); }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_EQUAL(85624, AS_NUMBER(result));
+    ch_freevm(&vm);
+}
+
+void test_numeric_arrays_store_raw_doubles() {
+    ch_context vm;
+    ch_primitive result = run_program("#main() { val a = numbers(3); a[1] = 2.5; val b = numbers(3); b[1] = 4; a[] = dot(a, b); return a; }", &vm);
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    ch_f64array* array = AS_F64ARRAY(AS_OBJECT(result));
+    TEST_ASSERT_TRUE(IS_F64ARRAY(AS_OBJECT(result)));
+    TEST_ASSERT_EQUAL(4, array->count);
+    TEST_ASSERT_EQUAL(0, array->values[0]);
+    TEST_ASSERT_TRUE(array->values[1] == 2.5);
+    TEST_ASSERT_EQUAL(10, array->values[3]);
+    ch_freevm(&vm);
+}
+
+void test_numeric_array_errors() {
+    ch_context vm;
+    run_program("#main() { val a = numbers(2); a[0] = \"text\"; return 0; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_INCORRECT_TYPE, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { val a = numbers([1, \"text\"]); return 0; }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_USER_ERROR, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { return dot(numbers(2), numbers(3)); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_USER_ERROR, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { return min(numbers(0)); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_USER_ERROR, vm.exit);
+    ch_freevm(&vm);
+
+    run_program("#main() { return sum([1, 2]); }", &vm);
+    TEST_ASSERT_EQUAL(EXIT_USER_ERROR, vm.exit);
+    ch_freevm(&vm);
+}
+
+void test_escaping_numeric_arrays_are_promoted() {
+    ch_program compiled_program;
+    char program[] = "val saved = null; #save() { val a = numbers(0); val i = 100; while (i) { a[] = i; i--; } saved = a; return 0; }"
+                     "#main() { return sum(saved); }";
+    TEST_ASSERT_TRUE(ch_compile((uint8_t*)program, strlen(program), &compiled_program));
+
+    ch_context vm = ch_newvm(compiled_program);
+    ch_gc_setarena(&vm, true);
+    ch_runfunction(&vm, "save");
+    ch_f64array* saved = AS_F64ARRAY(AS_OBJECT(vm.globals.values[0]));
+
+    TEST_ASSERT_EQUAL(EXIT_OK, vm.exit);
+    TEST_ASSERT_FALSE(saved->object.in_arena);
+    TEST_ASSERT_EQUAL(100, saved->count);
+    TEST_ASSERT_EQUAL(5050, AS_NUMBER(ch_runfunction(&vm, "main")));
+    ch_freevm(&vm);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_scalar_kernels);
+    RUN_TEST(test_sse2_kernels);
+    RUN_TEST(test_avx2_kernels);
+    RUN_TEST(test_numeric_array_natives);
+    RUN_TEST(test_numeric_arrays_store_raw_doubles);
+    RUN_TEST(test_numeric_array_errors);
+    RUN_TEST(test_escaping_numeric_arrays_are_promoted);
+    return UNITY_END();
+}
@@ -20,6 +20,18 @@ ch_primitive run(char* program) {
     return ch_runfunction(&vm, "main");
 }
 
+// Runs a complete program (globals and functions included) instead of a main body
+ch_primitive run_program(char* program, ch_context* out_vm) {
+    ch_program compiled_program;
+    if (!ch_compile((uint8_t*)program, strlen(program), &compiled_program)) {
+        printf("Failed to compile program\n");
+        return MAKE_NULL();
+    }
+
+    *out_vm = ch_newvm(compiled_program);
+    return ch_runfunction(out_vm, "main");
+}
+
 bool doescompile(char* program) {
     ch_program unused_program;
     return compile(program, &unused_program);
@@ -38,6 +50,7 @@ bool compile(char* program, ch_program* compiled_program) {
     memcpy(result, prefix, prefix_size);
     memcpy(result + prefix_size, program, size);
     memcpy(result + prefix_size + size, suffix, suffix_size);
+    result[prefix_size + size + suffix_size] = '\0';
 
     if (!ch_compile((uint8_t*)result, strlen(result), compiled_program)) {
         printf("Failed to compile program\n");